@@ -23,6 +23,22 @@
 #include <lttng/tracepoint.h>
 #include <stdarg.h>
 
+#ifndef _LTTNG_UST_TRACEF_CALLSITE
+#define _LTTNG_UST_TRACEF_CALLSITE
+
+/*
+ * Call site of tracef_binary(). The format string is parsed and
+ * registered on first use.
+ */
+#define LTTNG_UST_TRACEF_CALLSITE_PADDING	16
+struct lttng_ust_tracef_callsite {
+	const char *fmt;
+	unsigned int id;	/* Format ID, 0 if not registered yet. */
+	char padding[LTTNG_UST_TRACEF_CALLSITE_PADDING];
+};
+
+#endif /* _LTTNG_UST_TRACEF_CALLSITE */
+
 TRACEPOINT_EVENT(lttng_ust_tracef, event,
 	TP_ARGS(const char *, msg, unsigned int, len, void *, ip),
 	TP_FIELDS(
@@ -30,3 +46,28 @@ TRACEPOINT_EVENT(lttng_ust_tracef, event,
 	)
 )
 TRACEPOINT_LOGLEVEL(lttng_ust_tracef, event, TRACE_DEBUG)
+
+/*
+ * Binary mode: the arguments are recorded unformatted, as laid out by
+ * the arg_types of the format event of the same format_id.
+ */
+TRACEPOINT_EVENT(lttng_ust_tracef, binary,
+	TP_ARGS(unsigned int, id, const char *, args, unsigned int, len,
+		void *, ip),
+	TP_FIELDS(
+		ctf_integer(unsigned int, format_id, id)
+		ctf_sequence_hex(uint8_t, args, args, unsigned int, len)
+	)
+)
+TRACEPOINT_LOGLEVEL(lttng_ust_tracef, binary, TRACE_DEBUG)
+
+TRACEPOINT_EVENT(lttng_ust_tracef, format,
+	TP_ARGS(unsigned int, id, const char *, fmt, const char *, arg_types,
+		void *, ip),
+	TP_FIELDS(
+		ctf_integer(unsigned int, format_id, id)
+		ctf_string(format, fmt)
+		ctf_string(arg_types, arg_types)
+	)
+)
+TRACEPOINT_LOGLEVEL(lttng_ust_tracef, format, TRACE_DEBUG)
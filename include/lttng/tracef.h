@@ -32,13 +32,34 @@ extern "C" {
 extern
 void _lttng_ust_tracef(const char *fmt, ...);
 
-#define tracef(fmt, ...)						\
+extern
+void _lttng_ust_tracef_binary(struct lttng_ust_tracef_callsite *callsite, ...);
+
+#define tracef_text(fmt, ...)						\
 	do {								\
 		LTTNG_STAP_PROBEV(tracepoint_lttng_ust_tracef, event, ## __VA_ARGS__); \
 		if (caa_unlikely(__tracepoint_lttng_ust_tracef___event.state)) \
 			_lttng_ust_tracef(fmt, ## __VA_ARGS__);		\
 	} while (0)
 
+/* @fmt must be a string literal. */
+#define tracef_binary(fmt, ...)						\
+	do {								\
+		static struct lttng_ust_tracef_callsite __tracef_callsite = \
+			{ fmt };					\
+									\
+		LTTNG_STAP_PROBEV(tracepoint_lttng_ust_tracef, binary, ## __VA_ARGS__); \
+		if (caa_unlikely(__tracepoint_lttng_ust_tracef___binary.state)) \
+			_lttng_ust_tracef_binary(&__tracef_callsite,	\
+				## __VA_ARGS__);			\
+	} while (0)
+
+#ifdef LTTNG_UST_TRACEF_BINARY
+#define tracef	tracef_binary
+#else
+#define tracef	tracef_text
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -158,6 +158,9 @@ enum lttng_ust_context_type {
 	LTTNG_UST_CONTEXT_VGID			= 18,
 	LTTNG_UST_CONTEXT_VEGID			= 19,
 	LTTNG_UST_CONTEXT_VSGID			= 20,
+	LTTNG_UST_CONTEXT_CALLSTACK_USER	= 21,
+	LTTNG_UST_CONTEXT_CALLSTACK_USER_DEDUP	= 22,
+	LTTNG_UST_CONTEXT_PROCNAME_ID		= 23,
 };
 
 struct lttng_ust_perf_counter_ctx {
@@ -315,6 +318,8 @@ struct lttng_ust_event_exclusion {
 /* Tracepoint list commands */
 #define LTTNG_UST_TRACEPOINT_LIST_GET		_UST_CMD(0x90)
 #define LTTNG_UST_TRACEPOINT_FIELD_LIST_GET	_UST_CMD(0x91)
+#define LTTNG_UST_TRACEPOINT_LIST_GET_BULK	_UST_CMD(0x92)
+#define LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK	_UST_CMD(0x93)
 
 /* Event FD commands */
 #define LTTNG_UST_FILTER			_UST_CMD(0xA0)
@@ -336,6 +341,10 @@ union ust_args {
 	struct {
 		struct lttng_ust_field_iter entry;
 	} field_list;
+	struct {
+		const void *entries;	/* Packed list entries */
+		uint64_t len;		/* Length of entries, in bytes */
+	} list_bulk;
 	struct {
 		char *ctxname;
 	} app_context;
@@ -35,9 +35,21 @@ struct lttng_ust_context_provider {
 	void (*get_value)(struct lttng_ctx_field *field,
 			 struct lttng_ctx_value *value);
 	struct cds_hlist_node node;
+	/*
+	 * Static type of the context, only used by
+	 * lttng_ust_context_provider_register_typed(). Integer and
+	 * floating point types are recorded without the dynamic type
+	 * tag, converted from the value returned by get_value().
+	 * LTTNG_UST_DYNAMIC_TYPE_STRING is recorded as a fixed-length
+	 * array of static_string_len bytes, including the terminating
+	 * '\0'.
+	 */
+	enum lttng_ust_dynamic_type static_type;
+	size_t static_string_len;
 };
 
 int lttng_ust_context_provider_register(struct lttng_ust_context_provider *provider);
+int lttng_ust_context_provider_register_typed(struct lttng_ust_context_provider *provider);
 void lttng_ust_context_provider_unregister(struct lttng_ust_context_provider *provider);
 
 int lttng_context_is_app(const char *name);
@@ -126,6 +126,21 @@ int ustctl_tracepoint_field_list(int sock);
 int ustctl_tracepoint_field_list_get(int sock, int tp_field_list_handle,
 		struct lttng_ust_field_iter *iter);
 
+/*
+ * ustctl_tracepoint_list_get_bulk and
+ * ustctl_tracepoint_field_list_get_bulk are used to iterate on the tp
+ * and tp field list handles, receiving up to max_count entries in the
+ * iter array per call. They return the number of entries received.
+ * End of iteration is reached when -LTTNG_UST_ERR_NOENT is returned.
+ * Applications which predate these commands return
+ * -LTTNG_UST_ERR_INVAL, in which case the caller should fall back on
+ * ustctl_tracepoint_list_get and ustctl_tracepoint_field_list_get.
+ */
+int ustctl_tracepoint_list_get_bulk(int sock, int tp_list_handle,
+		struct lttng_ust_tracepoint_iter *iter, unsigned int max_count);
+int ustctl_tracepoint_field_list_get_bulk(int sock, int tp_field_list_handle,
+		struct lttng_ust_field_iter *iter, unsigned int max_count);
+
 int ustctl_tracer_version(int sock, struct lttng_ust_tracer_version *v);
 int ustctl_wait_quiescent(int sock);
 
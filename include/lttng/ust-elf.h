@@ -220,6 +220,21 @@ int is_elf_native_endian(struct lttng_ust_elf *elf)
 	return elf->endianness == NATIVE_ELF_ENDIANNESS;
 }
 
+/*
+ * ELF metadata of a file, as cached by lttng_ust_elf_get_info() and
+ * released with lttng_ust_elf_put_info().
+ */
+struct lttng_ust_elf_info {
+	uint64_t memsz;
+	uint8_t *build_id;
+	size_t build_id_len;
+	char *dbg_file;
+	uint32_t crc;
+	uint8_t is_pic;
+	uint8_t has_build_id;
+	uint8_t has_debug_link;
+};
+
 struct lttng_ust_elf *lttng_ust_elf_create(const char *path);
 void lttng_ust_elf_destroy(struct lttng_ust_elf *elf);
 uint8_t lttng_ust_elf_is_pic(struct lttng_ust_elf *elf);
@@ -228,5 +243,7 @@ int lttng_ust_elf_get_build_id(struct lttng_ust_elf *elf, uint8_t **build_id,
 			size_t *length, int *found);
 int lttng_ust_elf_get_debug_link(struct lttng_ust_elf *elf, char **filename,
 			uint32_t *crc, int *found);
+const struct lttng_ust_elf_info *lttng_ust_elf_get_info(const char *path);
+void lttng_ust_elf_put_info(const struct lttng_ust_elf_info *info);
 
 #endif	/* _LTTNG_UST_ELF_H */
@@ -286,6 +286,8 @@ struct lttng_ctx_value {
 };
 
 struct lttng_perf_counter_field;
+struct lttng_ust_context_provider;
+struct lttng_callstack_dedup;
 
 #define LTTNG_UST_CTX_FIELD_PADDING	40
 struct lttng_ctx_field {
@@ -298,6 +300,8 @@ struct lttng_ctx_field {
 			 struct lttng_ctx_value *value);
 	union {
 		struct lttng_perf_counter_field *perf_counter;
+		struct lttng_ust_context_provider *app_provider;
+		struct lttng_callstack_dedup *callstack_dedup;
 		char padding[LTTNG_UST_CTX_FIELD_PADDING];
 	} u;
 	void (*destroy)(struct lttng_ctx_field *field);
@@ -369,24 +373,17 @@ struct lttng_enabler {
 	unsigned int enabled:1;
 };
 
-struct tp_list_entry {
-	struct lttng_ust_tracepoint_iter tp;
-	struct cds_list_head head;
-};
+struct lttng_ust_tracepoint_list_cache;
+struct lttng_ust_field_list_cache;
 
 struct lttng_ust_tracepoint_list {
-	struct tp_list_entry *iter;
-	struct cds_list_head head;
-};
-
-struct tp_field_list_entry {
-	struct lttng_ust_field_iter field;
-	struct cds_list_head head;
+	struct lttng_ust_tracepoint_list_cache *cache;	/* Shared snapshot */
+	size_t pos;			/* Iteration position in snapshot */
 };
 
 struct lttng_ust_field_list {
-	struct tp_field_list_entry *iter;
-	struct cds_list_head head;
+	struct lttng_ust_field_list_cache *cache;	/* Shared snapshot */
+	size_t pos;			/* Iteration position in snapshot */
 };
 
 struct ust_pending_probe;
@@ -609,6 +606,9 @@ struct lttng_session {
 	struct lttng_ust_enum_ht enums_ht;	/* ht of enumerations */
 	struct cds_list_head enums_head;
 	struct lttng_ctx *ctx;			/* contexts for filters. */
+
+	/* New UST 2.12 */
+	int statedump_running:1;		/* Statedump in progress */
 };
 
 struct lttng_transport {
@@ -676,6 +676,7 @@ int lttng_add_vtid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_vpid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_pthread_id_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_procname_to_ctx(struct lttng_ctx **ctx);
+int lttng_add_procname_id_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_ip_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_cpu_id_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_dyntest_to_ctx(struct lttng_ctx **ctx);
@@ -692,6 +693,8 @@ int lttng_add_vsuid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_vgid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_vegid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_vsgid_to_ctx(struct lttng_ctx **ctx);
+int lttng_add_callstack_user_to_ctx(struct lttng_ctx **ctx);
+int lttng_add_callstack_user_dedup_to_ctx(struct lttng_ctx **ctx);
 void lttng_context_vtid_reset(void);
 void lttng_context_vpid_reset(void);
 void lttng_context_procname_reset(void);
@@ -746,10 +749,16 @@ int lttng_probes_get_event_list(struct lttng_ust_tracepoint_list *list);
 void lttng_probes_prune_event_list(struct lttng_ust_tracepoint_list *list);
 struct lttng_ust_tracepoint_iter *
 	lttng_ust_tracepoint_list_get_iter_next(struct lttng_ust_tracepoint_list *list);
+size_t lttng_ust_tracepoint_list_get_bulk(struct lttng_ust_tracepoint_list *list,
+		const struct lttng_ust_tracepoint_iter **entries,
+		size_t max_entries);
 int lttng_probes_get_field_list(struct lttng_ust_field_list *list);
 void lttng_probes_prune_field_list(struct lttng_ust_field_list *list);
 struct lttng_ust_field_iter *
 	lttng_ust_field_list_get_iter_next(struct lttng_ust_field_list *list);
+size_t lttng_ust_field_list_get_bulk(struct lttng_ust_field_list *list,
+		const struct lttng_ust_field_iter **entries,
+		size_t max_entries);
 
 void lttng_filter_event_link_bytecode(struct lttng_event *event);
 void lttng_enabler_event_link_bytecode(struct lttng_event *event,
@@ -102,6 +102,9 @@ struct ustcomm_ust_msg {
 		struct {
 			uint32_t count;	/* how many names follow */
 		} LTTNG_PACKED exclusion;
+		struct {
+			uint32_t max_count;	/* max. number of entries */
+		} LTTNG_PACKED list_bulk;
 		char padding[USTCOMM_MSG_PADDING2];
 	} u;
 } LTTNG_PACKED;
@@ -193,6 +196,14 @@ struct ustcomm_notify_channel_reply {
  * struct lttng_ust_field_iter field.
  */
 
+/*
+ * LTTNG_UST_TRACEPOINT_LIST_GET_BULK and
+ * LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK replies hold the number of
+ * entries in ret_val, and are followed by that many packed
+ * struct lttng_ust_tracepoint_iter or struct lttng_ust_field_iter
+ * entries. The end of the list is reported as LTTNG_UST_ERR_NOENT.
+ */
+
 extern int ustcomm_create_unix_sock(const char *pathname);
 extern int ustcomm_connect_unix_sock(const char *pathname,
 		long timeout);
@@ -27,6 +27,7 @@
 #include <stdio.h>
 
 void lttng_ust_init_fd_tracker(void);
+void lttng_ust_fd_tracker_after_fork_child(void);
 int lttng_ust_add_fd_to_tracker(int fd);
 void lttng_ust_delete_fd_from_tracker(int fd);
 void lttng_ust_lock_fd_tracker(void);
@@ -35,5 +36,7 @@ void lttng_ust_unlock_fd_tracker(void);
 int lttng_ust_safe_close_fd(int fd, int (*close_cb)(int));
 int lttng_ust_safe_fclose_stream(FILE *stream, int (*fclose_cb)(FILE *stream));
 int lttng_ust_safe_closefrom_fd(int lowfd, int (*close_cb)(int));
+int lttng_ust_safe_close_range_fd(unsigned int first, unsigned int last,
+		int flags);
 
 #endif	/* _LTTNG_UST_FD_H */
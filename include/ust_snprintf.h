@@ -22,5 +22,6 @@
 
 extern int ust_safe_vsnprintf(char *str, size_t n, const char *fmt, va_list ap);
 extern int ust_safe_snprintf(char *str, size_t n, const char *fmt, ...);
+extern int ust_safe_format_is_libc_compatible(const char *fmt);
 
 #endif /* UST_SNPRINTF */
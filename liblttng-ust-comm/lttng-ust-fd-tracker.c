@@ -30,13 +30,18 @@
 #include <sys/select.h>
 #include <sys/resource.h>
 #include <sys/time.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <urcu/arch.h>
 #include <urcu/compiler.h>
 #include <urcu/tls-compat.h>
 #include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
 
 #include <ust-fd.h>
 #include <helper.h>
@@ -45,22 +50,26 @@
 
 #include "../liblttng-ust/compat.h"
 
-/* Operations on the fd set. */
 #define IS_FD_VALID(fd)			((fd) >= 0 && (fd) < lttng_ust_max_fd)
-#define GET_FD_SET_FOR_FD(fd, fd_sets)	(&((fd_sets)[(fd) / FD_SETSIZE]))
-#define CALC_INDEX_TO_SET(fd)		((fd) % FD_SETSIZE)
 #define IS_FD_STD(fd)			(IS_FD_VALID(fd) && (fd) <= STDERR_FILENO)
 
-/* Check fd validity before calling these. */
-#define ADD_FD_TO_SET(fd, fd_sets)	\
-		FD_SET(CALC_INDEX_TO_SET(fd), GET_FD_SET_FOR_FD(fd, fd_sets))
-#define IS_FD_SET(fd, fd_sets)		\
-		FD_ISSET(CALC_INDEX_TO_SET(fd), GET_FD_SET_FOR_FD(fd, fd_sets))
-#define DEL_FD_FROM_SET(fd, fd_sets)	\
-		FD_CLR(CALC_INDEX_TO_SET(fd), GET_FD_SET_FOR_FD(fd, fd_sets))
+/* Operations on the fd bitmap. Check fd validity before calling these. */
+#define FD_BITMAP_WORD(fd)		((fd) / CAA_BITS_PER_LONG)
+#define FD_BITMAP_MASK(fd)		(1UL << ((fd) % CAA_BITS_PER_LONG))
+
+/* Initial size of the fd bitmap, doubled as needed. */
+#define FD_BITMAP_INIT_FDS		1024
+
+/*
+ * Lock-free close() checks are accounted in per-stripe counters, each
+ * on its own cache line, so that concurrent closes don't bounce a
+ * shared counter.
+ */
+#define FD_CLOSER_STRIPES		32
+#define FD_WAIT_SPINS			1000
 
 /*
- * Protect the lttng_fd_set. Nests within the ust_lock, and therefore
+ * Protect the lttng_fd_bitmap. Nests within the ust_lock, and therefore
  * within the libc dl lock. Therefore, we need to fixup the TLS before
  * nesting into this lock.
  *
@@ -83,10 +92,47 @@ static int ust_safe_guard_saved_cancelstate;
  */
 static DEFINE_URCU_TLS(int, ust_fd_mutex_nest);
 
-/* fd_set used to book keep fd being used by lttng-ust. */
-static fd_set *lttng_fd_set;
+/*
+ * Bitmap of the fds used by lttng-ust, only modified with the
+ * ust_safe_guard_fd_mutex held, and replaced by a larger one when an fd
+ * does not fit.
+ *
+ * The application close() and fclose() test it without taking the
+ * mutex: they first increment the counter of their stripe, then only
+ * proceed if fd_tracker_locked is clear, and decrement the counter
+ * once the fd is closed. Conversely, lttng_ust_lock_fd_tracker() sets
+ * fd_tracker_locked, then waits for all the counters to drop to zero.
+ * Therefore, while the tracker is locked, no lock-free check is in
+ * progress: lttng-ust can open an fd and add it to the bitmap without
+ * the application closing it in between, and free a replaced bitmap.
+ *
+ * The close itself is part of the check, and may block. After a short
+ * spin, the locker sleeps on fd_checks_futex, which the checks ending
+ * while fd_tracker_locked is set increment and wake.
+ */
+struct fd_bitmap {
+	int nr_fds;			/* Multiple of CAA_BITS_PER_LONG. */
+	unsigned long bits[];
+};
+
+struct fd_closer_stripe {
+	unsigned long count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static struct fd_bitmap *lttng_fd_bitmap;
+static int fd_tracker_locked;
+static int32_t fd_checks_futex;
+static struct fd_closer_stripe fd_closers[FD_CLOSER_STRIPES];
+static unsigned int fd_closer_next_stripe;
+
+/* Stripe of the current thread, plus one. 0 if not assigned yet. */
+static DEFINE_URCU_TLS(unsigned int, fd_closer_stripe);
+
+/*
+ * Hard fd limit: bounds the fds checked by IS_FD_VALID() and
+ * IS_FD_STD() in dup_std_fd(), and the closefrom() fallback.
+ */
 static int lttng_ust_max_fd;
-static int num_fd_sets;
 static int init_done;
 
 /*
@@ -95,17 +141,145 @@ static int init_done;
 void lttng_ust_fixup_fd_tracker_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(ust_fd_mutex_nest)));
+	asm volatile ("" : : "m" (URCU_TLS(fd_closer_stripe)));
+}
+
+static
+bool fd_is_tracked(int fd)
+{
+	struct fd_bitmap *bitmap = CMM_LOAD_SHARED(lttng_fd_bitmap);
+
+	cmm_smp_read_barrier_depends();	/* load bitmap before content */
+	if (!bitmap || fd < 0 || fd >= bitmap->nr_fds)
+		return false;
+	return bitmap->bits[FD_BITMAP_WORD(fd)] & FD_BITMAP_MASK(fd);
+}
+
+/* Return the first tracked fd greater or equal to @fd, or -1. */
+static
+int fd_bitmap_next(unsigned int fd)
+{
+	struct fd_bitmap *bitmap = lttng_fd_bitmap;
+
+	if (!bitmap)
+		return -1;
+	while (fd < (unsigned int) bitmap->nr_fds) {
+		unsigned long word;
+
+		word = bitmap->bits[FD_BITMAP_WORD(fd)] >> (fd % CAA_BITS_PER_LONG);
+		if (word)
+			return fd + __builtin_ctzl(word);
+		fd = (FD_BITMAP_WORD(fd) + 1) * CAA_BITS_PER_LONG;
+	}
+	return -1;
+}
+
+/*
+ * Make the bitmap large enough for @fd. Called with the tracker locked,
+ * so no lock-free check can be reading the old bitmap.
+ */
+static
+int fd_bitmap_grow(int fd)
+{
+	struct fd_bitmap *old = lttng_fd_bitmap, *new;
+	int nr_fds = old ? old->nr_fds : FD_BITMAP_INIT_FDS;
+
+	if (old && fd < old->nr_fds)
+		return 0;
+	while (nr_fds <= fd)
+		nr_fds *= 2;
+	new = calloc(1, sizeof(*new) + FD_BITMAP_WORD(nr_fds) * sizeof(unsigned long));
+	if (!new)
+		return -1;
+	new->nr_fds = nr_fds;
+	if (old) {
+		memcpy(new->bits, old->bits,
+			FD_BITMAP_WORD(old->nr_fds) * sizeof(unsigned long));
+	}
+	cmm_smp_wmb();	/* write content before publishing the bitmap */
+	CMM_STORE_SHARED(lttng_fd_bitmap, new);
+	free(old);
+	return 0;
+}
+
+/* End a lock-free check begun by fd_check_begin(). */
+static
+void fd_check_end(struct fd_closer_stripe *stripe)
+{
+	cmm_smp_mb();	/* close before decrementing count */
+	uatomic_dec(&stripe->count);
+	cmm_smp_mb__after_uatomic_dec();	/* decrement count before loading fd_tracker_locked */
+	if (caa_unlikely(CMM_LOAD_SHARED(fd_tracker_locked))) {
+		uatomic_inc(&fd_checks_futex);
+		(void) futex_async(&fd_checks_futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0);
+	}
+}
+
+/*
+ * Begin a lock-free check of an fd. Return the stripe to pass to
+ * fd_check_end(), or NULL if the tracker is locked, in which case the
+ * caller must lock it.
+ */
+static
+struct fd_closer_stripe *fd_check_begin(void)
+{
+	struct fd_closer_stripe *stripe;
+	unsigned int index = URCU_TLS(fd_closer_stripe);
+
+	if (caa_unlikely(!index)) {
+		index = uatomic_add_return(&fd_closer_next_stripe, 1)
+			% FD_CLOSER_STRIPES + 1;
+		URCU_TLS(fd_closer_stripe) = index;
+	}
+	stripe = &fd_closers[index - 1];
+	uatomic_inc(&stripe->count);
+	cmm_smp_mb();	/* increment count before loading fd_tracker_locked */
+	if (caa_unlikely(CMM_LOAD_SHARED(fd_tracker_locked))) {
+		/*
+		 * The locker may already wait for this count: wake it
+		 * like a completed check does.
+		 */
+		fd_check_end(stripe);
+		return NULL;
+	}
+	return stripe;
+}
+
+/* Wait for the lock-free checks in progress to complete. */
+static
+void fd_wait_checks(void)
+{
+	unsigned int i, spins = 0;
+
+	for (i = 0; i < FD_CLOSER_STRIPES; i++) {
+		while (uatomic_read(&fd_closers[i].count)) {
+			int32_t seq;
+
+			if (++spins < FD_WAIT_SPINS) {
+				caa_cpu_relax();
+				continue;
+			}
+			seq = uatomic_read(&fd_checks_futex);
+			cmm_smp_mb();	/* load futex word before loading count */
+			if (!uatomic_read(&fd_closers[i].count))
+				break;
+			(void) futex_async(&fd_checks_futex, FUTEX_WAIT, seq,
+					NULL, NULL, 0);
+		}
+	}
+	cmm_smp_mb();	/* checks complete before modifying the bitmap */
 }
 
 /*
- * Allocate the fd set array based on the hard limit set for this
- * process. This will be called during the constructor execution
- * and will also be called in the child after fork via lttng_ust_init.
+ * Get the fd limit of this process. This will be called during the
+ * constructor execution and will also be called in the child after
+ * fork via lttng_ust_init. The fd bitmap itself is allocated when the
+ * first fd is added.
  */
 void lttng_ust_init_fd_tracker(void)
 {
 	struct rlimit rlim;
-	int i;
 
 	if (CMM_LOAD_SHARED(init_done))
 		return;
@@ -115,27 +289,26 @@ void lttng_ust_init_fd_tracker(void)
 	if (getrlimit(RLIMIT_NOFILE, &rlim) < 0)
 		abort();
 	/*
-	 * FD set array size determined using the hard limit. Even if
-	 * the process wishes to increase its limit using setrlimit, it
-	 * can only do so with the softlimit which will be less than the
-	 * hard limit.
+	 * Use the hard limit. Even if the process wishes to increase
+	 * its limit using setrlimit, it can only do so with the
+	 * softlimit which will be less than the hard limit.
 	 */
 	lttng_ust_max_fd = rlim.rlim_max;
-	num_fd_sets = lttng_ust_max_fd / FD_SETSIZE;
-	if (lttng_ust_max_fd % FD_SETSIZE)
-		++num_fd_sets;
-	if (lttng_fd_set != NULL) {
-		free(lttng_fd_set);
-		lttng_fd_set = NULL;
-	}
-	lttng_fd_set = malloc(num_fd_sets * (sizeof(fd_set)));
-	if (!lttng_fd_set)
-		abort();
-	for (i = 0; i < num_fd_sets; i++)
-		FD_ZERO((&lttng_fd_set[i]));
 	CMM_STORE_SHARED(init_done, 1);
 }
 
+/*
+ * The lock-free checks which were in progress in other threads at fork
+ * time will never complete in the child.
+ */
+void lttng_ust_fd_tracker_after_fork_child(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < FD_CLOSER_STRIPES; i++)
+		uatomic_set(&fd_closers[i].count, 0);
+}
+
 void lttng_ust_lock_fd_tracker(void)
 {
 	sigset_t sig_all_blocked, orig_mask;
@@ -158,6 +331,9 @@ void lttng_ust_lock_fd_tracker(void)
 		cmm_barrier();
 		pthread_mutex_lock(&ust_safe_guard_fd_mutex);
 		ust_safe_guard_saved_cancelstate = oldstate;
+		CMM_STORE_SHARED(fd_tracker_locked, 1);
+		cmm_smp_mb();	/* store fd_tracker_locked before loading counts */
+		fd_wait_checks();
 	}
 	ret = pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
 	if (ret) {
@@ -184,6 +360,8 @@ void lttng_ust_unlock_fd_tracker(void)
 	if (!--URCU_TLS(ust_fd_mutex_nest)) {
 		newstate = ust_safe_guard_saved_cancelstate;
 		restore_cancel = true;
+		cmm_smp_mb();	/* bitmap updates before clearing fd_tracker_locked */
+		CMM_STORE_SHARED(fd_tracker_locked, 0);
 		pthread_mutex_unlock(&ust_safe_guard_fd_mutex);
 	}
 	ret = pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
@@ -279,7 +457,7 @@ error:
  */
 int lttng_ust_add_fd_to_tracker(int fd)
 {
-	int ret;
+	int ret, orig_fd = fd;
 	/*
 	 * Ensure the tracker is initialized when called from
 	 * constructors.
@@ -295,13 +473,19 @@ int lttng_ust_add_fd_to_tracker(int fd)
 		fd = ret;
 	}
 
-	/* Trying to add an fd which we can not accommodate. */
-	assert(IS_FD_VALID(fd));
+	if (fd_bitmap_grow(fd)) {
+		ret = -1;
+		goto error_grow;
+	}
 	/* Setting an fd thats already set. */
-	assert(!IS_FD_SET(fd, lttng_fd_set));
+	assert(!fd_is_tracked(fd));
 
-	ADD_FD_TO_SET(fd, lttng_fd_set);
+	lttng_fd_bitmap->bits[FD_BITMAP_WORD(fd)] |= FD_BITMAP_MASK(fd);
 	return fd;
+
+error_grow:
+	if (fd != orig_fd)
+		(void) close(fd);	/* Don't leak the duplicated std fd. */
 error:
 	return ret;
 }
@@ -319,12 +503,10 @@ void lttng_ust_delete_fd_from_tracker(int fd)
 	lttng_ust_init_fd_tracker();
 
 	assert(URCU_TLS(ust_fd_mutex_nest));
-	/* Not a valid fd. */
-	assert(IS_FD_VALID(fd));
 	/* Deleting an fd which was not set. */
-	assert(IS_FD_SET(fd, lttng_fd_set));
+	assert(fd_is_tracked(fd));
 
-	DEL_FD_FROM_SET(fd, lttng_fd_set);
+	lttng_fd_bitmap->bits[FD_BITMAP_WORD(fd)] &= ~FD_BITMAP_MASK(fd);
 }
 
 /*
@@ -334,7 +516,8 @@ void lttng_ust_delete_fd_from_tracker(int fd)
  */
 int lttng_ust_safe_close_fd(int fd, int (*close_cb)(int fd))
 {
-	int ret = 0;
+	struct fd_closer_stripe *stripe;
+	int ret = 0, oldstate;
 
 	lttng_ust_fixup_fd_tracker_tls();
 
@@ -351,8 +534,24 @@ int lttng_ust_safe_close_fd(int fd, int (*close_cb)(int fd))
 	if (URCU_TLS(ust_fd_mutex_nest))
 		return close_cb(fd);
 
+	/* Fast path: check the bitmap without locking. */
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
+	stripe = fd_check_begin();
+	if (caa_likely(stripe)) {
+		if (fd_is_tracked(fd)) {
+			ret = -1;
+			errno = EBADF;
+		} else {
+			ret = close_cb(fd);
+		}
+		fd_check_end(stripe);
+		(void) pthread_setcancelstate(oldstate, NULL);
+		return ret;
+	}
+	(void) pthread_setcancelstate(oldstate, NULL);
+
 	lttng_ust_lock_fd_tracker();
-	if (IS_FD_VALID(fd) && IS_FD_SET(fd, lttng_fd_set)) {
+	if (fd_is_tracked(fd)) {
 		ret = -1;
 		errno = EBADF;
 	} else {
@@ -370,7 +569,8 @@ int lttng_ust_safe_close_fd(int fd, int (*close_cb)(int fd))
  */
 int lttng_ust_safe_fclose_stream(FILE *stream, int (*fclose_cb)(FILE *stream))
 {
-	int ret = 0, fd;
+	struct fd_closer_stripe *stripe;
+	int ret = 0, fd, oldstate;
 
 	lttng_ust_fixup_fd_tracker_tls();
 
@@ -389,8 +589,24 @@ int lttng_ust_safe_fclose_stream(FILE *stream, int (*fclose_cb)(FILE *stream))
 
 	fd = fileno(stream);
 
+	/* Fast path: check the bitmap without locking. */
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
+	stripe = fd_check_begin();
+	if (caa_likely(stripe)) {
+		if (fd_is_tracked(fd)) {
+			ret = -1;
+			errno = EBADF;
+		} else {
+			ret = fclose_cb(stream);
+		}
+		fd_check_end(stripe);
+		(void) pthread_setcancelstate(oldstate, NULL);
+		return ret;
+	}
+	(void) pthread_setcancelstate(oldstate, NULL);
+
 	lttng_ust_lock_fd_tracker();
-	if (IS_FD_VALID(fd) && IS_FD_SET(fd, lttng_fd_set)) {
+	if (fd_is_tracked(fd)) {
 		ret = -1;
 		errno = EBADF;
 	} else {
@@ -420,8 +636,77 @@ static int test_close_success(const int *p __attribute__((unused)))
 }
 #endif
 
+#ifdef __NR_close_range
+static
+int sys_close_range(unsigned int first, unsigned int last, int flags)
+{
+	return syscall(__NR_close_range, first, last, flags);
+}
+
+/*
+ * Close the fds of [first, last] not used by lttng-ust, with one
+ * close_range() system call per range between lttng-ust fds. Called
+ * with the tracker locked.
+ */
+static
+int close_range_untracked(unsigned int first, unsigned int last, int flags)
+{
+	while (first <= last) {
+		int next = fd_bitmap_next(first);
+
+		if (next < 0 || (unsigned int) next > last)
+			return sys_close_range(first, last, flags);
+		if ((unsigned int) next > first
+				&& sys_close_range(first, next - 1, flags))
+			return -1;
+		first = next + 1;
+	}
+	return 0;
+}
+#endif /* #ifdef __NR_close_range */
+
 /*
- * Implement helper for closefrom() override.
+ * Implement helper for close_range() override. Fails with ENOSYS if
+ * the close_range() system call is not available.
+ */
+int lttng_ust_safe_close_range_fd(unsigned int first, unsigned int last,
+		int flags)
+{
+#ifdef __NR_close_range
+	int ret;
+
+	lttng_ust_fixup_fd_tracker_tls();
+
+	/*
+	 * Ensure the tracker is initialized when called from
+	 * constructors.
+	 */
+	lttng_ust_init_fd_tracker();
+
+	if (first > last) {
+		errno = EINVAL;
+		return -1;
+	}
+	/*
+	 * If called from lttng-ust, we directly close the range without
+	 * skipping the tracked set.
+	 */
+	if (URCU_TLS(ust_fd_mutex_nest))
+		return sys_close_range(first, last, flags);
+
+	lttng_ust_lock_fd_tracker();
+	ret = close_range_untracked(first, last, flags);
+	lttng_ust_unlock_fd_tracker();
+	return ret;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ * Implement helper for closefrom() override. Uses close_range() where
+ * available, and otherwise closes each fd up to the fd limit.
  */
 int lttng_ust_safe_closefrom_fd(int lowfd, int (*close_cb)(int fd))
 {
@@ -443,6 +728,10 @@ int lttng_ust_safe_closefrom_fd(int lowfd, int (*close_cb)(int fd))
 		ret = -1;
 		goto end;
 	}
+	ret = lttng_ust_safe_close_range_fd(lowfd, ~0U, 0);
+	if (!ret || errno != ENOSYS)
+		goto end;
+	ret = 0;
 	/*
 	 * If called from lttng-ust, we directly call close without
 	 * validating whether the FD is part of the tracked set.
@@ -464,7 +753,7 @@ int lttng_ust_safe_closefrom_fd(int lowfd, int (*close_cb)(int fd))
 	} else {
 		lttng_ust_lock_fd_tracker();
 		for (i = lowfd; i < lttng_ust_max_fd; i++) {
-			if (IS_FD_VALID(i) && IS_FD_SET(i, lttng_fd_set))
+			if (fd_is_tracked(i))
 				continue;
 			if (close_cb(i) < 0) {
 				switch (errno) {
@@ -18,6 +18,7 @@
 
 #define _GNU_SOURCE
 #include <string.h>
+#include <limits.h>
 #include <lttng/ust-config.h>
 #include <lttng/ust-ctl.h>
 #include <lttng/ust-abi.h>
@@ -502,6 +503,53 @@ int ustctl_tracepoint_field_list_get(int sock, int tp_field_list_handle,
 	return 0;
 }
 
+static
+int tracepoint_list_get_bulk(int sock, int list_handle, uint32_t cmd,
+		void *entries, size_t entry_len, unsigned int max_count)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+	int ret;
+	ssize_t len;
+	size_t expected_len;
+
+	if (!entries || !max_count || max_count > INT_MAX)
+		return -EINVAL;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = list_handle;
+	lum.cmd = cmd;
+	lum.u.list_bulk.max_count = max_count;
+	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	if (ret)
+		return ret;
+	if (lur.ret_val == 0 || lur.ret_val > max_count)
+		return -EINVAL;
+	expected_len = (size_t) lur.ret_val * entry_len;
+	len = ustcomm_recv_unix_sock(sock, entries, expected_len);
+	if (len != (ssize_t) expected_len) {
+		return -EINVAL;
+	}
+	DBG("received %u tracepoint list entries", lur.ret_val);
+	return lur.ret_val;
+}
+
+int ustctl_tracepoint_list_get_bulk(int sock, int tp_list_handle,
+		struct lttng_ust_tracepoint_iter *iter, unsigned int max_count)
+{
+	return tracepoint_list_get_bulk(sock, tp_list_handle,
+			LTTNG_UST_TRACEPOINT_LIST_GET_BULK,
+			iter, sizeof(*iter), max_count);
+}
+
+int ustctl_tracepoint_field_list_get_bulk(int sock, int tp_field_list_handle,
+		struct lttng_ust_field_iter *iter, unsigned int max_count)
+{
+	return tracepoint_list_get_bulk(sock, tp_field_list_handle,
+			LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK,
+			iter, sizeof(*iter), max_count);
+}
+
 int ustctl_tracer_version(int sock, struct lttng_ust_tracer_version *v)
 {
 	struct ustcomm_ust_msg lum;
@@ -21,24 +21,261 @@
 #include <dlfcn.h>
 #include <sys/types.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <urcu/compiler.h>
 
 #define TRACEPOINT_DEFINE
 #define TRACEPOINT_CREATE_PROBES
 #define TP_IP_PARAM func_addr
 #include "lttng-ust-cyg-profile-fast.h"
 
+/*
+ * Compact call log mode: instead of one event per call, each thread
+ * appends (function address, time delta) pairs to a call log, traced
+ * as one func_log event every func_log_len calls. The delta is the
+ * number of ns since the previous call of the log, or 0 for the first
+ * one, taken at base. Its top bit is set for function exits. The log
+ * is also traced when a delta does not fit, and when the thread exits.
+ *
+ * The calls made by a signal handler interrupting an update of the log
+ * of its thread are traced as individual func_entry and func_exit
+ * events instead.
+ */
+#define FUNC_LOG_MAX_LEN		4096
+#define FUNC_LOG_EXIT			(1U << 31)
+
+/* Call log of a thread which is exiting. */
+#define FUNC_LOG_EXITED			((struct func_log *) 1UL)
+
+#define FUNC_EXCLUDE_MAX		64
+
+struct func_log {
+	uint64_t base;			/* CLOCK_MONOTONIC, in ns */
+	uint64_t last;
+	unsigned int count;
+	unsigned long *addr;
+	uint32_t *delta;
+};
+
+/* Set by the constructor. */
+static unsigned int func_log_len;	/* 0 if disabled */
+static pthread_key_t func_log_key;
+static void *func_exclude[FUNC_EXCLUDE_MAX];
+static unsigned int nr_func_exclude;
+
+static __thread struct func_log *func_log;
+static __thread int func_log_nesting;
+
 void __cyg_profile_func_enter(void *this_fn, void *call_site)
 	__attribute__((no_instrument_function));
 
 void __cyg_profile_func_exit(void *this_fn, void *call_site)
 	__attribute__((no_instrument_function));
 
+static
+uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	if (caa_unlikely(clock_gettime(CLOCK_MONOTONIC, &ts)))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static
+bool func_excluded(void *this_fn)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_func_exclude; i++) {
+		if (func_exclude[i] == this_fn)
+			return true;
+	}
+	return false;
+}
+
+static
+void func_log_flush(struct func_log *log)
+{
+	if (log->count) {
+		tracepoint(lttng_ust_cyg_profile_fast, func_log,
+			log->base, log->addr, log->delta, log->count, NULL);
+	}
+	log->count = 0;
+}
+
+/* Thread exit: flush and release the call log of the thread. */
+static
+void func_log_destroy(void *arg)
+{
+	struct func_log *log = arg;
+
+	func_log_nesting++;
+	cmm_barrier();
+	func_log = FUNC_LOG_EXITED;
+	func_log_flush(log);
+	free(log);
+	cmm_barrier();
+	func_log_nesting--;
+}
+
+static
+struct func_log *func_log_get(void)
+{
+	struct func_log *log = func_log;
+
+	if (caa_likely(log))
+		return log == FUNC_LOG_EXITED ? NULL : log;
+	/* Don't log the calls made while allocating the log. */
+	func_log = FUNC_LOG_EXITED;
+	log = calloc(1, sizeof(*log) + func_log_len
+		* (sizeof(*log->addr) + sizeof(*log->delta)));
+	if (!log)
+		goto error;
+	log->addr = (unsigned long *) (log + 1);
+	log->delta = (uint32_t *) (log->addr + func_log_len);
+	if (pthread_setspecific(func_log_key, log))
+		goto error;
+	func_log = log;
+	return log;
+
+error:
+	free(log);
+	func_log = NULL;
+	return NULL;
+}
+
+/* Called with func_log_nesting incremented. */
+static
+void func_log_append(void *this_fn, uint32_t exit_flag)
+{
+	struct func_log *log;
+	uint64_t now, delta = 0;
+
+	log = func_log_get();
+	if (!log)
+		return;
+	now = clock_ns();
+	if (log->count) {
+		delta = now - log->last;
+		if (caa_unlikely(delta >= FUNC_LOG_EXIT)) {
+			func_log_flush(log);
+			delta = 0;
+		}
+	}
+	if (!log->count)
+		log->base = now;
+	log->addr[log->count] = (unsigned long) this_fn;
+	log->delta[log->count] = (uint32_t) delta | exit_flag;
+	log->last = now;
+	if (++log->count == func_log_len)
+		func_log_flush(log);
+}
+
 void __cyg_profile_func_enter(void *this_fn, void *call_site)
 {
+	if (caa_unlikely(nr_func_exclude) && func_excluded(this_fn))
+		return;
+	if (func_log_len && caa_likely(!func_log_nesting)) {
+		if (tracepoint_enabled(lttng_ust_cyg_profile_fast, func_log)) {
+			func_log_nesting++;
+			cmm_barrier();
+			func_log_append(this_fn, 0);
+			cmm_barrier();
+			func_log_nesting--;
+		}
+		return;
+	}
 	tracepoint(lttng_ust_cyg_profile_fast, func_entry, this_fn);
 }
 
 void __cyg_profile_func_exit(void *this_fn, void *call_site)
 {
+	if (caa_unlikely(nr_func_exclude) && func_excluded(this_fn))
+		return;
+	if (func_log_len && caa_likely(!func_log_nesting)) {
+		if (tracepoint_enabled(lttng_ust_cyg_profile_fast, func_log)) {
+			func_log_nesting++;
+			cmm_barrier();
+			func_log_append(this_fn, FUNC_LOG_EXIT);
+			cmm_barrier();
+			func_log_nesting--;
+		}
+		return;
+	}
 	tracepoint(lttng_ust_cyg_profile_fast, func_exit, this_fn);
 }
+
+/*
+ * Parse the comma-separated list of function names, resolved with
+ * dlsym(), or addresses.
+ */
+static
+void func_exclude_init(const char *list)
+{
+	char *str, *token, *saveptr = NULL;
+
+	str = strdup(list);
+	if (!str)
+		return;
+	for (token = strtok_r(str, ",", &saveptr); token;
+			token = strtok_r(NULL, ",", &saveptr)) {
+		void *addr;
+
+		if (nr_func_exclude == FUNC_EXCLUDE_MAX) {
+			fprintf(stderr, "lttng-ust-cyg-profile: too many excluded functions\n");
+			break;
+		}
+		if (!strncmp(token, "0x", 2))
+			addr = (void *) strtoul(token, NULL, 16);
+		else
+			addr = dlsym(RTLD_DEFAULT, token);
+		if (!addr) {
+			fprintf(stderr, "lttng-ust-cyg-profile: unknown function \"%s\"\n",
+				token);
+			continue;
+		}
+		func_exclude[nr_func_exclude++] = addr;
+	}
+	free(str);
+}
+
+static __attribute__((constructor))
+void lttng_ust_cyg_profile_fast_init(void)
+{
+	const char *str;
+	unsigned long len;
+
+	str = getenv("LTTNG_UST_CYG_PROFILE_EXCLUDE");
+	if (str)
+		func_exclude_init(str);
+	str = getenv("LTTNG_UST_CYG_PROFILE_LOG");
+	if (str && (len = strtoul(str, NULL, 10)) > 0) {
+		if (len > FUNC_LOG_MAX_LEN)
+			len = FUNC_LOG_MAX_LEN;
+		if (pthread_key_create(&func_log_key, func_log_destroy))
+			fprintf(stderr, "lttng-ust-cyg-profile: unable to create call log key\n");
+		else
+			func_log_len = len;
+	}
+}
+
+/* Flush the call log of the thread exiting the process. */
+static __attribute__((destructor))
+void lttng_ust_cyg_profile_fast_exit(void)
+{
+	struct func_log *log = func_log;
+
+	if (!log || log == FUNC_LOG_EXITED)
+		return;
+	func_log_nesting++;
+	cmm_barrier();
+	func_log_flush(log);
+	cmm_barrier();
+	func_log_nesting--;
+}
@@ -31,6 +31,7 @@ extern "C" {
  */
 
 #include <lttng/tracepoint.h>
+#include <stdint.h>
 
 TRACEPOINT_EVENT(lttng_ust_cyg_profile_fast, func_entry,
 	TP_ARGS(void *, func_addr),
@@ -51,6 +52,22 @@ TRACEPOINT_EVENT(lttng_ust_cyg_profile_fast, func_exit,
 TRACEPOINT_LOGLEVEL(lttng_ust_cyg_profile_fast, func_exit,
 	TRACE_DEBUG_FUNCTION)
 
+TRACEPOINT_EVENT(lttng_ust_cyg_profile_fast, func_log,
+	TP_ARGS(uint64_t, base, const unsigned long *, addr,
+		const uint32_t *, delta, unsigned int, count,
+		void *, func_addr),
+	TP_FIELDS(
+		ctf_integer(uint64_t, base, base)
+		ctf_sequence_hex(unsigned long, addr, addr,
+			unsigned int, count)
+		ctf_sequence(uint32_t, delta, delta,
+			unsigned int, count)
+	)
+)
+
+TRACEPOINT_LOGLEVEL(lttng_ust_cyg_profile_fast, func_log,
+	TRACE_DEBUG_FUNCTION)
+
 #endif /* _TRACEPOINT_LTTNG_UST_CYG_PROFILE_FAST_H */
 
 #undef TRACEPOINT_INCLUDE
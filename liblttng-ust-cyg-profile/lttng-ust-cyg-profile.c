@@ -21,24 +21,136 @@
 #include <dlfcn.h>
 #include <sys/types.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <urcu/compiler.h>
 
 #define TRACEPOINT_DEFINE
 #define TRACEPOINT_CREATE_PROBES
 #define TP_IP_PARAM func_addr
 #include "lttng-ust-cyg-profile.h"
 
+/*
+ * Slow function mode: each thread keeps the entry time of the functions
+ * it is running in a shadow stack, and only the returns from functions
+ * which ran for at least slow_threshold ns are traced. Frames deeper
+ * than SHADOW_STACK_DEPTH are not timed. The shadow stack is maintained
+ * even while the func_slow event is disabled, so that it matches the
+ * actual call stack when a session enables it, but the frames entered
+ * while it is disabled are not timed: their entry time is 0.
+ */
+#define SHADOW_STACK_DEPTH		256
+/*
+ * Frames skipped by longjmp() or exceptions are popped on the exit of
+ * one of their callers, if it is found within that many frames.
+ */
+#define SHADOW_STACK_UNWIND		8
+
+struct shadow_frame {
+	void *func_addr;
+	uint64_t entry;			/* CLOCK_MONOTONIC, in ns, 0 if not timed */
+};
+
+struct shadow_stack {
+	unsigned int depth;
+	unsigned int overflow;		/* Frames not timed. */
+	struct shadow_frame frames[SHADOW_STACK_DEPTH];
+};
+
+/* Set by the constructor. */
+static uint64_t slow_threshold;		/* ns, 0 if disabled */
+
+static __thread struct shadow_stack shadow_stack;
+
 void __cyg_profile_func_enter(void *this_fn, void *call_site)
 	__attribute__((no_instrument_function));
 
 void __cyg_profile_func_exit(void *this_fn, void *call_site)
 	__attribute__((no_instrument_function));
 
+static
+uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	if (caa_unlikely(clock_gettime(CLOCK_MONOTONIC, &ts)))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static
+void slow_func_enter(void *this_fn)
+{
+	struct shadow_stack *stack = &shadow_stack;
+	struct shadow_frame *frame;
+
+	if (caa_unlikely(stack->depth == SHADOW_STACK_DEPTH)) {
+		stack->overflow++;
+		return;
+	}
+	frame = &stack->frames[stack->depth++];
+	frame->func_addr = this_fn;
+	if (tracepoint_enabled(lttng_ust_cyg_profile, func_slow))
+		frame->entry = clock_ns();
+	else
+		frame->entry = 0;
+}
+
+static
+void slow_func_exit(void *this_fn, void *call_site)
+{
+	struct shadow_stack *stack = &shadow_stack;
+	unsigned int i;
+
+	if (caa_unlikely(stack->overflow)) {
+		stack->overflow--;
+		return;
+	}
+	for (i = 0; i < SHADOW_STACK_UNWIND && i < stack->depth; i++) {
+		struct shadow_frame *frame;
+		uint64_t duration;
+
+		frame = &stack->frames[stack->depth - i - 1];
+		if (frame->func_addr != this_fn)
+			continue;
+		stack->depth -= i + 1;
+		if (!frame->entry
+				|| !tracepoint_enabled(lttng_ust_cyg_profile, func_slow))
+			return;
+		duration = clock_ns() - frame->entry;
+		if (duration >= slow_threshold) {
+			tracepoint(lttng_ust_cyg_profile, func_slow,
+				this_fn, call_site, duration);
+		}
+		return;
+	}
+}
+
 void __cyg_profile_func_enter(void *this_fn, void *call_site)
 {
+	if (slow_threshold) {
+		slow_func_enter(this_fn);
+		return;
+	}
 	tracepoint(lttng_ust_cyg_profile, func_entry, this_fn, call_site);
 }
 
 void __cyg_profile_func_exit(void *this_fn, void *call_site)
 {
+	if (slow_threshold) {
+		slow_func_exit(this_fn, call_site);
+		return;
+	}
 	tracepoint(lttng_ust_cyg_profile, func_exit, this_fn, call_site);
 }
+
+static __attribute__((constructor))
+void lttng_ust_cyg_profile_init(void)
+{
+	const char *str;
+
+	str = getenv("LTTNG_UST_CYG_PROFILE_SLOW_NS");
+	if (str)
+		slow_threshold = strtoull(str, NULL, 10);
+}
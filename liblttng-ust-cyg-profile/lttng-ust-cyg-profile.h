@@ -31,6 +31,7 @@ extern "C" {
  */
 
 #include <lttng/tracepoint.h>
+#include <stdint.h>
 
 TRACEPOINT_EVENT_CLASS(lttng_ust_cyg_profile, func_class,
 	TP_ARGS(void *, func_addr, void *, call_site),
@@ -58,6 +59,20 @@ TRACEPOINT_EVENT_INSTANCE(lttng_ust_cyg_profile, func_class,
 TRACEPOINT_LOGLEVEL(lttng_ust_cyg_profile, func_exit,
 	TRACE_DEBUG_FUNCTION)
 
+TRACEPOINT_EVENT(lttng_ust_cyg_profile, func_slow,
+	TP_ARGS(void *, func_addr, void *, call_site, uint64_t, duration),
+	TP_FIELDS(
+		ctf_integer_hex(unsigned long, addr,
+			(unsigned long) func_addr)
+		ctf_integer_hex(unsigned long, call_site,
+			(unsigned long) call_site)
+		ctf_integer(uint64_t, duration, duration)
+	)
+)
+
+TRACEPOINT_LOGLEVEL(lttng_ust_cyg_profile, func_slow,
+	TRACE_DEBUG_FUNCTION)
+
 #endif /* _TRACEPOINT_LTTNG_UST_CYG_PROFILE_H */
 
 #undef TRACEPOINT_INCLUDE
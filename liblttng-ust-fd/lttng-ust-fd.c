@@ -21,6 +21,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <ust-fd.h>
 #include <dlfcn.h>
@@ -32,7 +33,7 @@ static int (*__lttng_ust_fd_plibc_close)(int fd);
 static int (*__lttng_ust_fd_plibc_fclose)(FILE *stream);
 
 static
-int _lttng_ust_fd_libc_close(int fd)
+int _lttng_ust_fd_resolve_libc_close(void)
 {
 	if (!__lttng_ust_fd_plibc_close) {
 		__lttng_ust_fd_plibc_close = dlsym(RTLD_NEXT, "close");
@@ -41,9 +42,25 @@ int _lttng_ust_fd_libc_close(int fd)
 			return -1;
 		}
 	}
+	return 0;
+}
+
+static
+int _lttng_ust_fd_libc_close(int fd)
+{
+	if (_lttng_ust_fd_resolve_libc_close())
+		return -1;
 	return lttng_ust_safe_close_fd(fd, __lttng_ust_fd_plibc_close);
 }
 
+static
+int _lttng_ust_fd_libc_closefrom(int lowfd)
+{
+	if (_lttng_ust_fd_resolve_libc_close())
+		return -1;
+	return lttng_ust_safe_closefrom_fd(lowfd, __lttng_ust_fd_plibc_close);
+}
+
 static
 int _lttng_ust_fd_libc_fclose(FILE *stream)
 {
@@ -77,13 +94,28 @@ int fclose(FILE *stream)
 /* Solaris and FreeBSD. */
 void closefrom(int lowfd)
 {
-	(void) lttng_ust_safe_closefrom(lowfd, __lttng_ust_fd_plibc_close);
+	(void) _lttng_ust_fd_libc_closefrom(lowfd);
 }
 #elif defined(__NetBSD__) || defined(__OpenBSD__)
 /* NetBSD and OpenBSD. */
 int closefrom(int lowfd)
 {
-	return lttng_ust_safe_closefrom(lowfd, __lttng_ust_fd_plibc_close);
+	return _lttng_ust_fd_libc_closefrom(lowfd);
+}
+#elif defined(__linux__) && defined(__NR_close_range)
+/*
+ * Linux. glibc implements closefrom() and close_range() with the
+ * close_range system call, bypassing close(). Ranges are split around
+ * the fds used by lttng-ust.
+ */
+void closefrom(int lowfd)
+{
+	(void) _lttng_ust_fd_libc_closefrom(lowfd);
+}
+
+int close_range(unsigned int first, unsigned int last, int flags)
+{
+	return lttng_ust_safe_close_range_fd(first, last, flags);
 }
 #else
 /* As far as we know, this OS does not implement closefrom. */
@@ -17,6 +17,8 @@
 
 package org.lttng.ust.agent.jul;
 
+import java.nio.ByteBuffer;
+
 /**
  * Virtual class containing the Java side of the LTTng-JUL JNI API methods.
  *
@@ -26,6 +28,14 @@ final class LttngJulApi {
 
 	private LttngJulApi() {}
 
+	/**
+	 * Check whether a tracing session enables the tracepoint of this agent.
+	 *
+	 * @return false if the events passed to the tracepoint would be
+	 *         discarded anyway
+	 */
+	static native boolean isEnabled();
+
 	static native void tracepoint(String msg,
 			String logger_name,
 			String class_name,
@@ -43,4 +53,15 @@ final class LttngJulApi {
 			int thread_id,
 			byte[] contextEntries,
 			byte[] contextStrings);
+
+	/**
+	 * Variant of {@link #tracepointWithContext} taking the strings and context
+	 * information encoded in a direct buffer by {@link LttngJulEventBuffer},
+	 * which the native side reads in place.
+	 */
+	static native void tracepointWithBuffer(ByteBuffer buffer,
+			int length,
+			long millis,
+			int log_level,
+			int thread_id);
 }
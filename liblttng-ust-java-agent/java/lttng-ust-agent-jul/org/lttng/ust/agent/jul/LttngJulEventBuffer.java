@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 - EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+package org.lttng.ust.agent.jul;
+
+import java.nio.BufferOverflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.CharBuffer;
+import java.nio.charset.Charset;
+import java.nio.charset.CharsetEncoder;
+import java.nio.charset.CoderResult;
+import java.nio.charset.CodingErrorAction;
+
+import org.lttng.ust.agent.context.ContextInfoSerializer.SerializedContexts;
+
+/**
+ * Per-thread direct buffer in which a JUL event is encoded before being passed
+ * through JNI, so that the native side can read the strings and context
+ * information in place, without pinning or copying Java objects.
+ *
+ * The buffer starts with a header of 8 native-endian 32-bit integers:
+ *
+ * <ul>
+ * <li>The offsets of the message, logger name, class name and method name
+ * strings, each one a UTF-8 C-string (ending with a "\0" byte)</li>
+ * <li>The offset and length of the context entries array</li>
+ * <li>The offset and length of the context strings array</li>
+ * </ul>
+ *
+ * The context arrays are the ones produced by the ContextInfoSerializer.
+ *
+ * @author EfficiOS Inc.
+ */
+final class LttngJulEventBuffer {
+
+	private static final int HEADER_LENGTH = 8 * 4;
+	private static final int INITIAL_CAPACITY = 4096;
+	private static final int CONTEXT_ENTRIES_ALIGNMENT = 8;
+	private static final Charset UTF8_CHARSET = Charset.forName("UTF-8");
+
+	private static final ThreadLocal<LttngJulEventBuffer> BUFFERS = new ThreadLocal<LttngJulEventBuffer>() {
+		@Override
+		protected LttngJulEventBuffer initialValue() {
+			return new LttngJulEventBuffer();
+		}
+	};
+
+	private final CharsetEncoder encoder = UTF8_CHARSET.newEncoder()
+			.onMalformedInput(CodingErrorAction.REPLACE)
+			.onUnmappableCharacter(CodingErrorAction.REPLACE);
+
+	private ByteBuffer buffer = allocate(INITIAL_CAPACITY);
+
+	private LttngJulEventBuffer() {}
+
+	/**
+	 * @return The event buffer of the current thread
+	 */
+	static LttngJulEventBuffer get() {
+		return BUFFERS.get();
+	}
+
+	/**
+	 * @return The direct buffer holding the last encoded event
+	 */
+	ByteBuffer getBuffer() {
+		return buffer;
+	}
+
+	/**
+	 * Encode an event in the buffer, growing it as needed.
+	 *
+	 * @return The length of the encoded event, in bytes
+	 */
+	int encode(String msg, String loggerName, String className,
+			String methodName, SerializedContexts contextInfo) {
+		while (true) {
+			try {
+				return tryEncode(msg, loggerName, className, methodName, contextInfo);
+			} catch (BufferOverflowException e) {
+				buffer = allocate(buffer.capacity() * 2);
+			}
+		}
+	}
+
+	private int tryEncode(String msg, String loggerName, String className,
+			String methodName, SerializedContexts contextInfo) {
+		byte[] entries = contextInfo.getEntriesArray();
+		byte[] strings = contextInfo.getStringsArray();
+
+		buffer.clear();
+		buffer.position(HEADER_LENGTH);
+
+		int msgOffset = putString(msg);
+		int loggerNameOffset = putString(loggerName);
+		int classNameOffset = putString(className);
+		int methodNameOffset = putString(methodName);
+
+		int padding = -buffer.position() & (CONTEXT_ENTRIES_ALIGNMENT - 1);
+		if (buffer.remaining() < padding) {
+			throw new BufferOverflowException();
+		}
+		buffer.position(buffer.position() + padding);
+		int entriesOffset = buffer.position();
+		buffer.put(entries);
+		int stringsOffset = buffer.position();
+		buffer.put(strings);
+		int length = buffer.position();
+
+		buffer.putInt(0, msgOffset);
+		buffer.putInt(4, loggerNameOffset);
+		buffer.putInt(8, classNameOffset);
+		buffer.putInt(12, methodNameOffset);
+		buffer.putInt(16, entriesOffset);
+		buffer.putInt(20, entries.length);
+		buffer.putInt(24, stringsOffset);
+		buffer.putInt(28, strings.length);
+		return length;
+	}
+
+	/**
+	 * Write a string as a UTF-8 C-string at the current position. A null
+	 * string is written as an empty string.
+	 *
+	 * @return The offset of the string in the buffer
+	 */
+	private int putString(String str) {
+		int offset = buffer.position();
+
+		if (str != null) {
+			encoder.reset();
+			CoderResult result = encoder.encode(CharBuffer.wrap(str), buffer, true);
+			if (!result.isUnderflow()) {
+				throw new BufferOverflowException();
+			}
+			result = encoder.flush(buffer);
+			if (!result.isUnderflow()) {
+				throw new BufferOverflowException();
+			}
+		}
+		buffer.put((byte) 0);
+		return offset;
+	}
+
+	private static ByteBuffer allocate(int capacity) {
+		ByteBuffer newBuffer = ByteBuffer.allocateDirect(capacity);
+		newBuffer.order(ByteOrder.nativeOrder());
+		return newBuffer;
+	}
+}
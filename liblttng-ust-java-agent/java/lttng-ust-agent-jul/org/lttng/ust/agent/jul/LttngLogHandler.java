@@ -119,6 +119,14 @@ public class LttngLogHandler extends Handler implements ILttngHandler {
 			return;
 		}
 
+		/*
+		 * Skip the formatting and the JNI call if no tracing session enables
+		 * the JUL tracepoint.
+		 */
+		if (!LttngJulApi.isEnabled()) {
+			return;
+		}
+
 		String formattedMessage = FORMATTER.formatMessage(record);
 
 		/* Retrieve all the requested context information we can find */
@@ -131,16 +139,21 @@ public class LttngLogHandler extends Handler implements ILttngHandler {
 		 * Specific tracepoint designed for JUL events. The source class of the
 		 * caller is used for the event name, the raw message is taken, the
 		 * loglevel of the record and the thread ID.
+		 *
+		 * The strings and context information are encoded in a per-thread
+		 * direct buffer, which the native side reads without copies.
 		 */
-		LttngJulApi.tracepointWithContext(formattedMessage,
+		LttngJulEventBuffer eventBuffer = LttngJulEventBuffer.get();
+		int length = eventBuffer.encode(formattedMessage,
 				record.getLoggerName(),
 				record.getSourceClassName(),
 				record.getSourceMethodName(),
+				contextInfo);
+		LttngJulApi.tracepointWithBuffer(eventBuffer.getBuffer(),
+				length,
 				record.getMillis(),
 				record.getLevel().intValue(),
-				record.getThreadID(),
-				contextInfo.getEntriesArray(),
-				contextInfo.getStringsArray());
+				record.getThreadID());
 	}
 
 }
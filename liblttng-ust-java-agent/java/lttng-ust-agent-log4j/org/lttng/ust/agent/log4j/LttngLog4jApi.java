@@ -26,6 +26,14 @@ final class LttngLog4jApi {
 
 	private LttngLog4jApi() {}
 
+	/**
+	 * Check whether a tracing session enables the tracepoint of this agent.
+	 *
+	 * @return false if the events passed to the tracepoint would be
+	 *         discarded anyway
+	 */
+	static native boolean isEnabled();
+
 	static native void tracepoint(String msg,
 			String logger_name,
 			String class_name,
@@ -108,6 +108,14 @@ public class LttngLogAppender extends AppenderSkeleton implements ILttngHandler
 			return;
 		}
 
+		/*
+		 * Skip the formatting and the JNI call if no tracing session enables
+		 * the log4j tracepoint.
+		 */
+		if (!LttngLog4jApi.isEnabled()) {
+			return;
+		}
+
 		/*
 		 * The line number returned from LocationInformation is a string. At
 		 * least try to convert to a proper int.
@@ -68,22 +68,205 @@ static const char *get_ctx_string_at_offset(int32_t offset)
 	return (const char *) (ctx_strings_array + offset);
 }
 
-static struct lttng_ust_jni_ctx_entry *lookup_ctx_by_name(const char *ctx_name)
+/* FNV-1a hash of the context name. */
+static uint32_t hash_ctx_name(const char *ctx_name)
 {
-	struct lttng_ust_jni_ctx_entry *ctx_entries_array = lttng_ust_context_info_tls.ctx_entries;
-	int i, len = lttng_ust_context_info_tls.ctx_entries_len / sizeof(struct lttng_ust_jni_ctx_entry);
+	uint32_t hash = 2166136261U;
 
+	for (; *ctx_name; ctx_name++) {
+		hash ^= (unsigned char) *ctx_name;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*
+ * Return whether the context names of the current context info are the
+ * ones of the ctx_gen generation, in the same order. The values usually
+ * change from one event to the next, but the names seldom do, and the
+ * hash table only depends on them.
+ */
+static int ctx_names_match(void)
+{
+	struct lttng_ust_jni_tls *tls = &lttng_ust_context_info_tls;
+	struct lttng_ust_jni_ctx_entry *ctx_entries_array = tls->ctx_entries;
+	int i, len = tls->ctx_entries_len / sizeof(struct lttng_ust_jni_ctx_entry);
+	uint32_t pos = 0;
+
+	if (len != tls->names_count) {
+		return 0;
+	}
 	for (i = 0; i < len; i++) {
 		int32_t offset = ctx_entries_array[i].context_name_offset;
 		const char *string = get_ctx_string_at_offset(offset);
+		size_t string_len;
 
-		if (string && strcmp(string, ctx_name) == 0) {
-			return &ctx_entries_array[i];
+		if (!string) {
+			return 0;
+		}
+		string_len = strlen(string) + 1;
+		if (string_len > tls->names_len - pos
+				|| memcmp(tls->names + pos, string, string_len)) {
+			return 0;
+		}
+		pos += string_len;
+	}
+	return pos == tls->names_len;
+}
+
+static void save_ctx_names(void)
+{
+	struct lttng_ust_jni_tls *tls = &lttng_ust_context_info_tls;
+	struct lttng_ust_jni_ctx_entry *ctx_entries_array = tls->ctx_entries;
+	int i, len = tls->ctx_entries_len / sizeof(struct lttng_ust_jni_ctx_entry);
+	uint32_t pos = 0;
+
+	tls->names_count = -1;
+	for (i = 0; i < len; i++) {
+		int32_t offset = ctx_entries_array[i].context_name_offset;
+		const char *string = get_ctx_string_at_offset(offset);
+		size_t string_len;
+
+		if (!string) {
+			return;
+		}
+		string_len = strlen(string) + 1;
+		if (string_len > sizeof(tls->names) - pos) {
+			return;
+		}
+		memcpy(tls->names + pos, string, string_len);
+		pos += string_len;
+	}
+	tls->names_len = pos;
+	tls->names_count = len;
+}
+
+void lttng_ust_context_info_tls_set(struct lttng_ust_jni_ctx_entry *ctx_entries,
+		int32_t ctx_entries_len,
+		signed char *ctx_strings,
+		int32_t ctx_strings_len)
+{
+	struct lttng_ust_jni_tls *tls = &lttng_ust_context_info_tls;
+
+	tls->ctx_entries = ctx_entries;
+	tls->ctx_entries_len = ctx_entries_len;
+	tls->ctx_strings = ctx_strings;
+	tls->ctx_strings_len = ctx_strings_len;
+	/* Keep the names of the last context info across the reset. */
+	if (!ctx_entries) {
+		return;
+	}
+	if (!ctx_names_match()) {
+		tls->ctx_gen++;
+		save_ctx_names();
+	}
+}
+
+/*
+ * Index the context entries by name in an open addressing hash table,
+ * once per set of context names passed from Java.
+ */
+static void build_ctx_ht(void)
+{
+	struct lttng_ust_jni_tls *tls = &lttng_ust_context_info_tls;
+	struct lttng_ust_jni_ctx_entry *ctx_entries_array = tls->ctx_entries;
+	int i, len = tls->ctx_entries_len / sizeof(struct lttng_ust_jni_ctx_entry);
+
+	tls->ht_gen = tls->ctx_gen;
+	tls->ht_overflow = len > LTTNG_UST_JNI_CTX_HT_SIZE / 2;
+	if (tls->ht_overflow) {
+		return;
+	}
+	memset(tls->ht, 0, sizeof(tls->ht));
+	for (i = 0; i < len; i++) {
+		int32_t offset = ctx_entries_array[i].context_name_offset;
+		const char *string = get_ctx_string_at_offset(offset);
+		uint32_t slot;
+
+		if (!string) {
+			continue;
+		}
+		slot = hash_ctx_name(string);
+		while (tls->ht[slot & (LTTNG_UST_JNI_CTX_HT_SIZE - 1)]) {
+			slot++;
+		}
+		tls->ht[slot & (LTTNG_UST_JNI_CTX_HT_SIZE - 1)] = i + 1;
+	}
+}
+
+static struct lttng_ust_jni_ctx_entry *lookup_ctx_in_ht(const char *ctx_name)
+{
+	struct lttng_ust_jni_tls *tls = &lttng_ust_context_info_tls;
+	struct lttng_ust_jni_ctx_entry *ctx_entries_array = tls->ctx_entries;
+	int i, len = tls->ctx_entries_len / sizeof(struct lttng_ust_jni_ctx_entry);
+	uint32_t slot;
+
+	if (!ctx_entries_array) {
+		return NULL;
+	}
+	if (tls->ht_gen != tls->ctx_gen) {
+		build_ctx_ht();
+	}
+	if (tls->ht_overflow) {
+		for (i = 0; i < len; i++) {
+			int32_t offset = ctx_entries_array[i].context_name_offset;
+			const char *string = get_ctx_string_at_offset(offset);
+
+			if (string && strcmp(string, ctx_name) == 0) {
+				return &ctx_entries_array[i];
+			}
+		}
+		return NULL;
+	}
+	for (slot = hash_ctx_name(ctx_name);
+			(i = tls->ht[slot & (LTTNG_UST_JNI_CTX_HT_SIZE - 1)]);
+			slot++) {
+		int32_t offset = ctx_entries_array[i - 1].context_name_offset;
+
+		if (strcmp(get_ctx_string_at_offset(offset), ctx_name) == 0) {
+			return &ctx_entries_array[i - 1];
 		}
 	}
 	return NULL;
 }
 
+/*
+ * The callbacks of a context field are invoked several times for each
+ * event (size computation, then record), always with the same field
+ * name address. Remember the index found for the current context
+ * names, keyed by that address. Since a field name may be freed and
+ * another one allocated at the same address, a hit is only used if
+ * the name of the entry still matches. The entries array itself is
+ * passed anew for each event.
+ */
+static struct lttng_ust_jni_ctx_entry *lookup_ctx_by_name(const char *ctx_name)
+{
+	struct lttng_ust_jni_tls *tls = &lttng_ust_context_info_tls;
+	struct lttng_ust_jni_ctx_cache_entry *cache;
+	struct lttng_ust_jni_ctx_entry *jctx;
+
+	if (!tls->ctx_entries) {
+		return NULL;
+	}
+	cache = &tls->cache[((uintptr_t) ctx_name / sizeof(void *))
+			& (LTTNG_UST_JNI_CTX_CACHE_SIZE - 1)];
+	if (cache->gen == tls->ctx_gen && cache->ctx_name == ctx_name
+			&& cache->index >= 0) {
+		const char *string;
+
+		jctx = &tls->ctx_entries[cache->index];
+		string = get_ctx_string_at_offset(jctx->context_name_offset);
+		if (string && strcmp(string, ctx_name) == 0) {
+			return jctx;
+		}
+	}
+	jctx = lookup_ctx_in_ht(ctx_name);
+	cache->index = jctx ? jctx - tls->ctx_entries : -1;
+	cache->ctx_name = ctx_name;
+	cache->gen = tls->ctx_gen;
+	return jctx;
+}
+
 static size_t get_size_cb(struct lttng_ctx_field *field, size_t offset)
 {
 	struct lttng_ust_jni_ctx_entry *jctx;
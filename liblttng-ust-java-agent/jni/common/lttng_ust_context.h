@@ -19,15 +19,53 @@
 #ifndef LIBLTTNG_UST_JAVA_AGENT_JNI_COMMON_LTTNG_UST_CONTEXT_H_
 #define LIBLTTNG_UST_JAVA_AGENT_JNI_COMMON_LTTNG_UST_CONTEXT_H_
 
+#include <stdint.h>
+
+#define LTTNG_UST_JNI_CTX_HT_BITS	6
+#define LTTNG_UST_JNI_CTX_HT_SIZE	(1U << LTTNG_UST_JNI_CTX_HT_BITS)
+#define LTTNG_UST_JNI_CTX_CACHE_SIZE	16
+#define LTTNG_UST_JNI_CTX_NAMES_SIZE	512
+
 struct lttng_ust_jni_ctx_entry;
 
+struct lttng_ust_jni_ctx_cache_entry {
+	const char *ctx_name;
+	int32_t index;		/* In ctx_entries, -1 if not found (not cached). */
+	uint32_t gen;
+};
+
 struct lttng_ust_jni_tls {
 	struct lttng_ust_jni_ctx_entry *ctx_entries;
 	int32_t ctx_entries_len;
 	signed char *ctx_strings;
 	int32_t ctx_strings_len;
+
+	uint32_t ctx_gen;	/* Incremented when the context names change */
+	uint32_t ht_gen;	/* Context info generation indexed in ht */
+	int ht_overflow;	/* Too many entries, ht is unused */
+	/* Index + 1 in ctx_entries, hashed by context name. 0 if empty. */
+	int32_t ht[LTTNG_UST_JNI_CTX_HT_SIZE];
+	/* Lookups of the current context info, by context name address. */
+	struct lttng_ust_jni_ctx_cache_entry cache[LTTNG_UST_JNI_CTX_CACHE_SIZE];
+	/*
+	 * Context names of the ctx_gen generation, each terminated by
+	 * \0. names_count is -1 if they did not fit.
+	 */
+	int32_t names_count;
+	uint32_t names_len;
+	char names[LTTNG_UST_JNI_CTX_NAMES_SIZE];
 };
 
 extern __thread struct lttng_ust_jni_tls lttng_ust_context_info_tls;
 
+/*
+ * Set the context info passed to the callbacks. The lookups done on the
+ * previous context info are invalidated only if the context names
+ * differ.
+ */
+void lttng_ust_context_info_tls_set(struct lttng_ust_jni_ctx_entry *ctx_entries,
+		int32_t ctx_entries_len,
+		signed char *ctx_strings,
+		int32_t ctx_strings_len);
+
 #endif /* LIBLTTNG_UST_JAVA_AGENT_JNI_COMMON_LTTNG_UST_CONTEXT_H_ */
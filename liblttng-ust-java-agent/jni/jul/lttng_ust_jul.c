@@ -18,6 +18,9 @@
  */
 
 #define _LGPL_SOURCE
+#include <string.h>
+#include <stdint.h>
+
 #include "org_lttng_ust_agent_jul_LttngJulApi.h"
 
 #define TRACEPOINT_DEFINE
@@ -25,6 +28,16 @@
 #include "lttng_ust_jul.h"
 #include "../common/lttng_ust_context.h"
 
+/*
+ * Checked by the handler before formatting a record and querying its
+ * context information.
+ */
+JNIEXPORT jboolean JNICALL Java_org_lttng_ust_agent_jul_LttngJulApi_isEnabled(JNIEnv *env,
+						jclass jcls)
+{
+	return tracepoint_enabled(lttng_jul, event) ? JNI_TRUE : JNI_FALSE;
+}
+
 /*
  * Deprecated function from before the context information was passed.
  */
@@ -81,19 +94,17 @@ JNIEXPORT void JNICALL Java_org_lttng_ust_agent_jul_LttngJulApi_tracepointWithCo
 	 * lttng_ust_context.c can access them.
 	 */
 	context_info_entries_array = (*env)->GetByteArrayElements(env, context_info_entries, &iscopy);
-	lttng_ust_context_info_tls.ctx_entries = (struct lttng_ust_jni_ctx_entry *) context_info_entries_array;
-	lttng_ust_context_info_tls.ctx_entries_len = (*env)->GetArrayLength(env, context_info_entries);
 	context_info_strings_array = (*env)->GetByteArrayElements(env, context_info_strings, &iscopy);
-	lttng_ust_context_info_tls.ctx_strings = context_info_strings_array;
-	lttng_ust_context_info_tls.ctx_strings_len = (*env)->GetArrayLength(env, context_info_strings);
+	lttng_ust_context_info_tls_set(
+		(struct lttng_ust_jni_ctx_entry *) context_info_entries_array,
+		(*env)->GetArrayLength(env, context_info_entries),
+		context_info_strings_array,
+		(*env)->GetArrayLength(env, context_info_strings));
 
 	tracepoint(lttng_jul, event, msg_cstr, logger_name_cstr,
 			class_name_cstr, method_name_cstr, millis, log_level, thread_id);
 
-	lttng_ust_context_info_tls.ctx_entries = NULL;
-	lttng_ust_context_info_tls.ctx_entries_len = 0;
-	lttng_ust_context_info_tls.ctx_strings = NULL;
-	lttng_ust_context_info_tls.ctx_strings_len = 0;
+	lttng_ust_context_info_tls_set(NULL, 0, NULL, 0);
 	(*env)->ReleaseStringUTFChars(env, msg, msg_cstr);
 	(*env)->ReleaseStringUTFChars(env, logger_name, logger_name_cstr);
 	(*env)->ReleaseStringUTFChars(env, class_name, class_name_cstr);
@@ -101,3 +112,95 @@ JNIEXPORT void JNICALL Java_org_lttng_ust_agent_jul_LttngJulApi_tracepointWithCo
 	(*env)->ReleaseByteArrayElements(env, context_info_entries, context_info_entries_array, 0);
 	(*env)->ReleaseByteArrayElements(env, context_info_strings, context_info_strings_array, 0);
 }
+
+/*
+ * Header of the event buffer encoded by the Java side in
+ * LttngJulEventBuffer. Offsets are relative to the start of the buffer.
+ */
+struct lttng_ust_jul_event_header {
+	int32_t msg_offset;
+	int32_t logger_name_offset;
+	int32_t class_name_offset;
+	int32_t method_name_offset;
+	int32_t ctx_entries_offset;
+	int32_t ctx_entries_len;
+	int32_t ctx_strings_offset;
+	int32_t ctx_strings_len;
+};
+
+/*
+ * Return the NULL-terminated string at offset in the buffer, or NULL if
+ * it does not fit in the buffer.
+ */
+static const char *get_buffer_string(const char *buf, jint length,
+		int32_t offset)
+{
+	if (offset < (int32_t) sizeof(struct lttng_ust_jul_event_header)
+			|| offset >= length) {
+		return NULL;
+	}
+	if (!memchr(buf + offset, '\0', length - offset)) {
+		return NULL;
+	}
+	return buf + offset;
+}
+
+static int check_buffer_range(jint length, int32_t offset, int32_t len)
+{
+	return offset >= (int32_t) sizeof(struct lttng_ust_jul_event_header)
+		&& len >= 0 && offset <= length && len <= length - offset;
+}
+
+/*
+ * Tracepoint used by Java applications using the JUL handler, taking
+ * the strings and context information encoded in a direct buffer,
+ * which is read in place.
+ */
+JNIEXPORT void JNICALL Java_org_lttng_ust_agent_jul_LttngJulApi_tracepointWithBuffer(JNIEnv *env,
+						jobject jobj,
+						jobject buffer,
+						jint length,
+						jlong millis,
+						jint log_level,
+						jint thread_id)
+{
+	char *buf = (*env)->GetDirectBufferAddress(env, buffer);
+	struct lttng_ust_jul_event_header header;
+	const char *msg_cstr, *logger_name_cstr, *class_name_cstr,
+		*method_name_cstr;
+
+	if (!buf || length < (jint) sizeof(header)
+			|| length > (*env)->GetDirectBufferCapacity(env, buffer)) {
+		return;
+	}
+	memcpy(&header, buf, sizeof(header));
+	msg_cstr = get_buffer_string(buf, length, header.msg_offset);
+	logger_name_cstr = get_buffer_string(buf, length, header.logger_name_offset);
+	class_name_cstr = get_buffer_string(buf, length, header.class_name_offset);
+	method_name_cstr = get_buffer_string(buf, length, header.method_name_offset);
+	if (!msg_cstr || !logger_name_cstr || !class_name_cstr
+			|| !method_name_cstr) {
+		return;
+	}
+	if (!check_buffer_range(length, header.ctx_entries_offset,
+				header.ctx_entries_len)
+			|| !check_buffer_range(length, header.ctx_strings_offset,
+				header.ctx_strings_len)) {
+		return;
+	}
+
+	/*
+	 * Write these to the TLS variables, so that the UST callbacks in
+	 * lttng_ust_context.c can access them.
+	 */
+	lttng_ust_context_info_tls_set(
+		(struct lttng_ust_jni_ctx_entry *) (buf + header.ctx_entries_offset),
+		header.ctx_entries_len,
+		(signed char *) (buf + header.ctx_strings_offset),
+		header.ctx_strings_len);
+
+	tracepoint(lttng_jul, event, msg_cstr, logger_name_cstr,
+			class_name_cstr, method_name_cstr, millis, log_level, thread_id);
+
+	lttng_ust_context_info_tls_set(NULL, 0, NULL, 0);
+}
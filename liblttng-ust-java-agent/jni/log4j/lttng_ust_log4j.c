@@ -25,6 +25,16 @@
 #include "lttng_ust_log4j.h"
 #include "../common/lttng_ust_context.h"
 
+/*
+ * Checked by the appender before formatting an event and querying its
+ * context information.
+ */
+JNIEXPORT jboolean JNICALL Java_org_lttng_ust_agent_log4j_LttngLog4jApi_isEnabled(JNIEnv *env,
+						jclass jcls)
+{
+	return tracepoint_enabled(lttng_log4j, event) ? JNI_TRUE : JNI_FALSE;
+}
+
 /*
  * Deprecated function from before the context information was passed.
  */
@@ -92,20 +102,18 @@ JNIEXPORT void JNICALL Java_org_lttng_ust_agent_log4j_LttngLog4jApi_tracepointWi
 	 * lttng_ust_context.c can access them.
 	 */
 	context_info_entries_array = (*env)->GetByteArrayElements(env, context_info_entries, &iscopy);
-	lttng_ust_context_info_tls.ctx_entries = (struct lttng_ust_jni_ctx_entry *) context_info_entries_array;
-	lttng_ust_context_info_tls.ctx_entries_len = (*env)->GetArrayLength(env, context_info_entries);
 	context_info_strings_array = (*env)->GetByteArrayElements(env, context_info_strings, &iscopy);
-	lttng_ust_context_info_tls.ctx_strings = context_info_strings_array;
-	lttng_ust_context_info_tls.ctx_strings_len = (*env)->GetArrayLength(env, context_info_strings);
+	lttng_ust_context_info_tls_set(
+		(struct lttng_ust_jni_ctx_entry *) context_info_entries_array,
+		(*env)->GetArrayLength(env, context_info_entries),
+		context_info_strings_array,
+		(*env)->GetArrayLength(env, context_info_strings));
 
 	tracepoint(lttng_log4j, event, msg_cstr, logger_name_cstr,
 		   class_name_cstr, method_name_cstr, file_name_cstr,
 		   line_number, timestamp, loglevel, thread_name_cstr);
 
-	lttng_ust_context_info_tls.ctx_entries = NULL;
-	lttng_ust_context_info_tls.ctx_entries_len = 0;
-	lttng_ust_context_info_tls.ctx_strings = NULL;
-	lttng_ust_context_info_tls.ctx_strings_len = 0;
+	lttng_ust_context_info_tls_set(NULL, 0, NULL, 0);
 	(*env)->ReleaseStringUTFChars(env, msg, msg_cstr);
 	(*env)->ReleaseStringUTFChars(env, logger_name, logger_name_cstr);
 	(*env)->ReleaseStringUTFChars(env, class_name, class_name_cstr);
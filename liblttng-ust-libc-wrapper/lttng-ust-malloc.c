@@ -26,6 +26,13 @@
 #include <lttng/ust-dlfcn.h>
 #include <sys/types.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include <assert.h>
 #include <urcu/system.h>
 #include <urcu/uatomic.h>
@@ -40,6 +47,8 @@
 #define TP_IP_PARAM ip
 #include "ust_libc.h"
 
+struct malloc_stats;
+
 #define STATIC_CALLOC_LEN 4096
 static char static_calloc_buf[STATIC_CALLOC_LEN];
 static unsigned long static_calloc_buf_offset;
@@ -96,6 +105,9 @@ void ust_malloc_spin_unlock(pthread_mutex_t *lock)
 #define pthread_mutex_lock ust_malloc_spin_lock
 #define pthread_mutex_unlock ust_malloc_spin_unlock
 static DEFINE_URCU_TLS(int, malloc_nesting);
+static DEFINE_URCU_TLS(struct malloc_stats *, malloc_stats);
+static DEFINE_URCU_TLS(int64_t, malloc_sample_left);
+static DEFINE_URCU_TLS(uint64_t, malloc_sample_rand);
 #undef ust_malloc_spin_unlock
 #undef ust_malloc_spin_lock
 #undef calloc
@@ -253,6 +265,306 @@ void lookup_all_symbols(void)
 	memcpy(&cur_alloc, &af, sizeof(cur_alloc));
 }
 
+/*
+ * Instead of tracing each call, the aggregated mode counts the
+ * allocations of each thread by size class and by callsite, and the
+ * sampling mode only traces the allocations which cross a sampling
+ * point. Sampling points are spaced by exponentially distributed
+ * amounts of allocated bytes, so that the probability of an allocation
+ * to be sampled only depends on its size.
+ */
+#define MALLOC_MODE_AGGREGATE		(1U << 0)
+#define MALLOC_MODE_SAMPLE		(1U << 1)
+
+#define MALLOC_NR_CALLSITES		128	/* Power of 2. */
+#define MALLOC_CALLSITE_PROBES		8
+/* Number of accounted calls between two checks of the flush period. */
+#define MALLOC_FLUSH_CHECK_CALLS	256
+
+/* Statistics of a thread which is exiting. */
+#define MALLOC_STATS_EXITED		((struct malloc_stats *) 1UL)
+
+struct malloc_callsite {
+	void *ip;
+	uint64_t count;
+	uint64_t bytes;
+};
+
+/*
+ * Allocation statistics of a thread since the last flush, only
+ * accessed by that thread. Allocations from callsites which don't fit
+ * in the callsite table are accounted in other_count and other_bytes.
+ */
+struct malloc_stats {
+	uint64_t count[UST_LIBC_NR_SIZE_CLASSES];
+	uint64_t bytes[UST_LIBC_NR_SIZE_CLASSES];
+	uint64_t free_count;
+	uint64_t nr_calls;
+	struct malloc_callsite callsites[MALLOC_NR_CALLSITES];
+	uint64_t other_count;
+	uint64_t other_bytes;
+	/* Fields below are kept across flushes. */
+	uint64_t next_flush;		/* CLOCK_MONOTONIC, in ns */
+	unsigned int flush_check;
+};
+
+/* Set by lttng_ust_malloc_wrapper_init() before the process is threaded. */
+static unsigned int malloc_mode;
+static uint64_t malloc_flush_period;	/* ns */
+static uint64_t malloc_sample_bytes;
+static pthread_key_t malloc_stats_key;
+
+static
+uint64_t malloc_clock_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static
+void malloc_stats_reset(struct malloc_stats *stats)
+{
+	memset(stats, 0, offsetof(struct malloc_stats, next_flush));
+}
+
+/*
+ * Emit the statistics of the current thread. Called with
+ * malloc_nesting held so the tracer's own allocations are not
+ * accounted.
+ */
+static
+void malloc_stats_flush(struct malloc_stats *stats)
+{
+	unsigned int i;
+
+	if (!stats->nr_calls)
+		return;
+	tracepoint(lttng_ust_libc, malloc_histogram,
+		stats->count, stats->bytes, stats->free_count, NULL);
+	for (i = 0; i < MALLOC_NR_CALLSITES; i++) {
+		struct malloc_callsite *cs = &stats->callsites[i];
+
+		if (!cs->count)
+			continue;
+		tracepoint(lttng_ust_libc, malloc_callsite,
+			cs->count, cs->bytes, cs->ip);
+	}
+	if (stats->other_count) {
+		tracepoint(lttng_ust_libc, malloc_callsite,
+			stats->other_count, stats->other_bytes, NULL);
+	}
+	malloc_stats_reset(stats);
+}
+
+/* Thread exit: flush and release the statistics of the thread. */
+static
+void malloc_stats_destroy(void *arg)
+{
+	struct malloc_stats *stats = arg;
+
+	URCU_TLS(malloc_nesting)++;
+	malloc_stats_flush(stats);
+	/* Don't account the remaining allocations of the thread. */
+	URCU_TLS(malloc_stats) = MALLOC_STATS_EXITED;
+	cur_alloc.free(stats);
+	URCU_TLS(malloc_nesting)--;
+}
+
+static
+struct malloc_stats *malloc_get_stats(void)
+{
+	struct malloc_stats *stats = URCU_TLS(malloc_stats);
+
+	if (caa_likely(stats)) {
+		if (caa_unlikely(stats == MALLOC_STATS_EXITED))
+			return NULL;
+		return stats;
+	}
+	stats = cur_alloc.calloc(1, sizeof(*stats));
+	if (!stats)
+		return NULL;
+	stats->next_flush = malloc_clock_ns() + malloc_flush_period;
+	stats->flush_check = MALLOC_FLUSH_CHECK_CALLS;
+	if (pthread_setspecific(malloc_stats_key, stats)) {
+		cur_alloc.free(stats);
+		return NULL;
+	}
+	URCU_TLS(malloc_stats) = stats;
+	return stats;
+}
+
+static
+bool malloc_aggregate_enabled(void)
+{
+	return tracepoint_enabled(lttng_ust_libc, malloc_histogram)
+		|| tracepoint_enabled(lttng_ust_libc, malloc_callsite);
+}
+
+static
+void malloc_stats_account_call(struct malloc_stats *stats)
+{
+	uint64_t now;
+
+	stats->nr_calls++;
+	if (--stats->flush_check)
+		return;
+	stats->flush_check = MALLOC_FLUSH_CHECK_CALLS;
+	now = malloc_clock_ns();
+	if (now < stats->next_flush)
+		return;
+	stats->next_flush = now + malloc_flush_period;
+	malloc_stats_flush(stats);
+}
+
+static
+struct malloc_callsite *malloc_get_callsite(struct malloc_stats *stats,
+		void *ip)
+{
+	unsigned long hash;
+	unsigned int i;
+
+	hash = ((unsigned long) ip >> 2) * 2654435761UL;
+	for (i = 0; i < MALLOC_CALLSITE_PROBES; i++) {
+		struct malloc_callsite *cs;
+
+		cs = &stats->callsites[(hash + i) & (MALLOC_NR_CALLSITES - 1)];
+		if (cs->ip == ip)
+			return cs;
+		if (!cs->ip) {
+			cs->ip = ip;
+			return cs;
+		}
+	}
+	return NULL;
+}
+
+static
+void malloc_aggregate_alloc(size_t size, void *ip)
+{
+	struct malloc_stats *stats;
+	struct malloc_callsite *cs;
+	unsigned int class = 0;
+
+	if (!malloc_aggregate_enabled())
+		return;
+	stats = malloc_get_stats();
+	if (!stats)
+		return;
+	if (size)
+		class = 64 - __builtin_clzll((unsigned long long) size);
+	if (class >= UST_LIBC_NR_SIZE_CLASSES)
+		class = UST_LIBC_NR_SIZE_CLASSES - 1;
+	stats->count[class]++;
+	stats->bytes[class] += size;
+	cs = malloc_get_callsite(stats, ip);
+	if (cs) {
+		cs->count++;
+		cs->bytes += size;
+	} else {
+		stats->other_count++;
+		stats->other_bytes += size;
+	}
+	malloc_stats_account_call(stats);
+}
+
+static
+void malloc_aggregate_free(void)
+{
+	struct malloc_stats *stats;
+
+	if (!malloc_aggregate_enabled())
+		return;
+	stats = malloc_get_stats();
+	if (!stats)
+		return;
+	stats->free_count++;
+	malloc_stats_account_call(stats);
+}
+
+/*
+ * Return the number of bytes until the next sampling point, drawn from
+ * an exponential distribution of mean malloc_sample_bytes. The
+ * logarithm uses a quadratic approximation of log2 over the mantissa,
+ * which is precise enough for sampling and avoids a dependency on
+ * libm.
+ */
+static
+int64_t malloc_sample_next(void)
+{
+	uint64_t x = URCU_TLS(malloc_sample_rand), r;
+	double f, log2_r;
+	int order;
+
+	if (caa_unlikely(!x))
+		x = (malloc_clock_ns() ^ (uintptr_t) &URCU_TLS(malloc_sample_rand)) | 1;
+	/* xorshift64* */
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	URCU_TLS(malloc_sample_rand) = x;
+	/* Uniform in [1, 2^26]. */
+	r = ((x * 0x2545F4914F6CDD1DULL) >> 38) + 1;
+	order = 63 - __builtin_clzll(r);
+	f = (double) r / (double) (1ULL << order) - 1.0;
+	log2_r = order + f * (1.3465 - 0.3465 * f);
+	/* -ln(r / 2^26) */
+	return (int64_t) (malloc_sample_bytes * 0.6931471805599453
+		* (26.0 - log2_r)) + 1;
+}
+
+static
+bool malloc_sample_alloc(size_t size)
+{
+	int64_t left = URCU_TLS(malloc_sample_left);
+
+	if (caa_unlikely(!URCU_TLS(malloc_sample_rand)))
+		left = malloc_sample_next();
+	left -= (int64_t) size;
+	if (caa_likely(left > 0)) {
+		URCU_TLS(malloc_sample_left) = left;
+		return false;
+	}
+	URCU_TLS(malloc_sample_left) = malloc_sample_next();
+	return true;
+}
+
+/*
+ * Account an allocation returning @ptr from callsite @ip. Return
+ * whether the allocation event must be traced.
+ */
+static
+bool malloc_trace_alloc(size_t size, void *ptr, void *ip)
+{
+	bool trace = false;
+
+	if (caa_likely(!malloc_mode))
+		return true;
+	if (!ptr)
+		return false;
+	if (malloc_mode & MALLOC_MODE_AGGREGATE)
+		malloc_aggregate_alloc(size, ip);
+	if (malloc_mode & MALLOC_MODE_SAMPLE)
+		trace = malloc_sample_alloc(size);
+	return trace;
+}
+
+/*
+ * Frees are only traced in the default mode: there is no cheap way to
+ * know whether the freed memory was sampled.
+ */
+static
+bool malloc_trace_free(void *ptr)
+{
+	if (caa_likely(!malloc_mode))
+		return true;
+	if (ptr && (malloc_mode & MALLOC_MODE_AGGREGATE))
+		malloc_aggregate_free();
+	return false;
+}
+
 void *malloc(size_t size)
 {
 	void *retval;
@@ -266,7 +578,9 @@ void *malloc(size_t size)
 		}
 	}
 	retval = cur_alloc.malloc(size);
-	if (URCU_TLS(malloc_nesting) == 1) {
+	if (URCU_TLS(malloc_nesting) == 1
+			&& malloc_trace_alloc(size, retval,
+				LTTNG_UST_CALLER_IP())) {
 		tracepoint(lttng_ust_libc, malloc,
 			size, retval, LTTNG_UST_CALLER_IP());
 	}
@@ -286,7 +600,7 @@ void free(void *ptr)
 		goto end;
 	}
 
-	if (URCU_TLS(malloc_nesting) == 1) {
+	if (URCU_TLS(malloc_nesting) == 1 && malloc_trace_free(ptr)) {
 		tracepoint(lttng_ust_libc, free,
 			ptr, LTTNG_UST_CALLER_IP());
 	}
@@ -316,7 +630,9 @@ void *calloc(size_t nmemb, size_t size)
 		}
 	}
 	retval = cur_alloc.calloc(nmemb, size);
-	if (URCU_TLS(malloc_nesting) == 1) {
+	if (URCU_TLS(malloc_nesting) == 1
+			&& malloc_trace_alloc(nmemb * size, retval,
+				LTTNG_UST_CALLER_IP())) {
 		tracepoint(lttng_ust_libc, calloc,
 			nmemb, size, retval, LTTNG_UST_CALLER_IP());
 	}
@@ -369,7 +685,9 @@ void *realloc(void *ptr, size_t size)
 	}
 	retval = cur_alloc.realloc(ptr, size);
 end:
-	if (URCU_TLS(malloc_nesting) == 1) {
+	if (URCU_TLS(malloc_nesting) == 1
+			&& malloc_trace_alloc(size, retval,
+				LTTNG_UST_CALLER_IP())) {
 		tracepoint(lttng_ust_libc, realloc,
 			ptr, size, retval, LTTNG_UST_CALLER_IP());
 	}
@@ -390,7 +708,9 @@ void *memalign(size_t alignment, size_t size)
 		}
 	}
 	retval = cur_alloc.memalign(alignment, size);
-	if (URCU_TLS(malloc_nesting) == 1) {
+	if (URCU_TLS(malloc_nesting) == 1
+			&& malloc_trace_alloc(size, retval,
+				LTTNG_UST_CALLER_IP())) {
 		tracepoint(lttng_ust_libc, memalign,
 			alignment, size, retval,
 			LTTNG_UST_CALLER_IP());
@@ -412,7 +732,9 @@ int posix_memalign(void **memptr, size_t alignment, size_t size)
 		}
 	}
 	retval = cur_alloc.posix_memalign(memptr, alignment, size);
-	if (URCU_TLS(malloc_nesting) == 1) {
+	if (URCU_TLS(malloc_nesting) == 1
+			&& malloc_trace_alloc(size, retval ? NULL : *memptr,
+				LTTNG_UST_CALLER_IP())) {
 		tracepoint(lttng_ust_libc, posix_memalign,
 			*memptr, alignment, size,
 			retval, LTTNG_UST_CALLER_IP());
@@ -425,11 +747,68 @@ static
 void lttng_ust_fixup_malloc_nesting_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(malloc_nesting)));
+	asm volatile ("" : : "m" (URCU_TLS(malloc_stats)));
+	asm volatile ("" : : "m" (URCU_TLS(malloc_sample_left)));
+	asm volatile ("" : : "m" (URCU_TLS(malloc_sample_rand)));
+}
+
+/* The child starts with empty statistics. */
+static
+void malloc_after_fork_child(void)
+{
+	struct malloc_stats *stats = URCU_TLS(malloc_stats);
+
+	if (stats && stats != MALLOC_STATS_EXITED)
+		malloc_stats_reset(stats);
+}
+
+static
+void malloc_mode_init(void)
+{
+	static bool initialized;
+	const char *str;
+	unsigned long long val;
+
+	if (initialized)
+		return;
+	initialized = true;
+
+	str = getenv("LTTNG_UST_MALLOC_AGGREGATE_MS");
+	if (str && (val = strtoull(str, NULL, 10)) > 0) {
+		if (pthread_key_create(&malloc_stats_key,
+				malloc_stats_destroy)) {
+			fprintf(stderr, "mallocwrap: unable to create statistics key\n");
+		} else {
+			(void) pthread_atfork(NULL, NULL,
+				malloc_after_fork_child);
+			malloc_flush_period = val * 1000000ULL;
+			malloc_mode |= MALLOC_MODE_AGGREGATE;
+		}
+	}
+	str = getenv("LTTNG_UST_MALLOC_SAMPLE_BYTES");
+	if (str && (val = strtoull(str, NULL, 10)) > 0) {
+		malloc_sample_bytes = val;
+		malloc_mode |= MALLOC_MODE_SAMPLE;
+	}
+}
+
+/* Flush the statistics of the thread exiting the process. */
+static __attribute__((destructor))
+void malloc_wrapper_exit(void)
+{
+	struct malloc_stats *stats = URCU_TLS(malloc_stats);
+
+	if (!stats || stats == MALLOC_STATS_EXITED)
+		return;
+	URCU_TLS(malloc_nesting)++;
+	malloc_stats_flush(stats);
+	URCU_TLS(malloc_nesting)--;
 }
 
 __attribute__((constructor))
 void lttng_ust_malloc_wrapper_init(void)
 {
+	malloc_mode_init();
 	/* Initialization already done */
 	if (cur_alloc.calloc) {
 		return;
@@ -25,6 +25,12 @@
 #include <lttng/ust-dlfcn.h>
 #include <helper.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
 
 #define TRACEPOINT_DEFINE
 #define TRACEPOINT_CREATE_PROBES
@@ -33,6 +39,241 @@
 
 static __thread int thread_in_trace;
 
+/*
+ * Contention profiling. When enabled, the lock operations are not
+ * traced one by one. Instead, the waits longer than wait_threshold are
+ * traced as lock_wait events, and each thread aggregates the wait and
+ * hold times of the locks it acquires in a lock table, traced as
+ * lock_stats events every flush_period and when the thread exits.
+ * Locks are first acquired with their trylock variant, so that only
+ * contended acquisitions are timed when not aggregating.
+ */
+#define LOCK_NR_STATS			128	/* Power of 2. */
+#define LOCK_STATS_PROBES		8
+
+/* Lock table of a thread which is exiting. */
+#define LOCK_TABLE_EXITED		((struct lock_table *) 1UL)
+
+struct lock_table {
+	struct ust_pthread_lock_stats stats[LOCK_NR_STATS];
+	uint64_t next_flush;		/* CLOCK_MONOTONIC, in ns */
+};
+
+/* Set by the constructor, before the process is threaded. */
+static bool profile_mode;
+static uint64_t wait_threshold;		/* ns, 0 if disabled */
+static uint64_t flush_period;		/* ns, 0 if disabled */
+static pthread_key_t lock_table_key;
+
+static __thread struct lock_table *lock_table;
+
+static
+uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static
+bool profile_enabled(void)
+{
+	return (wait_threshold
+			&& tracepoint_enabled(lttng_ust_pthread, lock_wait))
+		|| (flush_period
+			&& tracepoint_enabled(lttng_ust_pthread, lock_stats));
+}
+
+static
+struct ust_pthread_lock_stats *lock_table_lookup(struct lock_table *table,
+		void *lock, int type, bool create)
+{
+	unsigned long hash;
+	unsigned int i;
+
+	hash = ((unsigned long) lock >> 3) * 2654435761UL;
+	for (i = 0; i < LOCK_STATS_PROBES; i++) {
+		struct ust_pthread_lock_stats *e;
+
+		e = &table->stats[(hash + i) & (LOCK_NR_STATS - 1)];
+		if (e->lock == lock && e->type == type)
+			return e;
+		if (!e->lock) {
+			if (!create)
+				return NULL;
+			e->lock = lock;
+			e->type = type;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Trace the statistics of the table if @emit, and reset them. Only the
+ * entries of the locks currently held are kept, so that their hold
+ * time is accounted on release.
+ */
+static
+void lock_table_flush(struct lock_table *table, bool emit)
+{
+	unsigned int i;
+
+	for (i = 0; i < LOCK_NR_STATS; i++) {
+		struct ust_pthread_lock_stats *e = &table->stats[i], held;
+
+		if (!e->lock)
+			continue;
+		if (emit && e->nr_acquire)
+			tracepoint(lttng_ust_pthread, lock_stats, e, e->ip);
+		held = *e;
+		memset(e, 0, sizeof(*e));
+		if (!held.depth)
+			continue;
+		/* Reinsert, at the latest in the slot it just left. */
+		e = lock_table_lookup(table, held.lock, held.type, true);
+		e->ip = held.ip;
+		e->depth = held.depth;
+		e->acquire_ts = held.acquire_ts;
+	}
+}
+
+/* Thread exit: flush and release the lock table of the thread. */
+static
+void lock_table_destroy(void *arg)
+{
+	struct lock_table *table = arg;
+
+	thread_in_trace = 1;
+	lock_table_flush(table, true);
+	lock_table = LOCK_TABLE_EXITED;
+	free(table);
+	thread_in_trace = 0;
+}
+
+static
+struct lock_table *get_lock_table(void)
+{
+	struct lock_table *table = lock_table;
+
+	if (table)
+		return table == LOCK_TABLE_EXITED ? NULL : table;
+	table = calloc(1, sizeof(*table));
+	if (!table)
+		return NULL;
+	table->next_flush = clock_ns() + flush_period;
+	if (pthread_setspecific(lock_table_key, table)) {
+		free(table);
+		return NULL;
+	}
+	lock_table = table;
+	return table;
+}
+
+/*
+ * Account the acquisition of @lock, or the return from the wait on a
+ * condition variable, after waiting @wait ns if @contended.
+ */
+static
+void lock_acquired(void *lock, int type, int status, uint64_t wait,
+		bool contended, void *ip)
+{
+	struct ust_pthread_lock_stats *e;
+	struct lock_table *table;
+	uint64_t now;
+
+	if (status && status != EOWNERDEAD && status != ETIMEDOUT)
+		return;
+	if (contended && type != UST_PTHREAD_COND
+			&& wait_threshold && wait >= wait_threshold) {
+		tracepoint(lttng_ust_pthread, lock_wait, lock, type, wait, ip);
+	}
+	if (!flush_period || !tracepoint_enabled(lttng_ust_pthread, lock_stats))
+		return;
+	table = get_lock_table();
+	if (!table)
+		return;
+	e = lock_table_lookup(table, lock, type, true);
+	if (!e)
+		return;
+	now = clock_ns();
+	e->ip = ip;
+	e->nr_acquire++;
+	if (contended) {
+		e->nr_contended++;
+		e->wait_total += wait;
+		if (wait > e->wait_max)
+			e->wait_max = wait;
+	}
+	if (type != UST_PTHREAD_COND && !e->depth++)
+		e->acquire_ts = now;
+	if (now >= table->next_flush) {
+		table->next_flush = now + flush_period;
+		lock_table_flush(table, true);
+	}
+}
+
+/*
+ * Account the release of @lock. Return whether the current thread was
+ * known to hold it.
+ */
+static
+bool lock_released(void *lock, int type)
+{
+	struct ust_pthread_lock_stats *e;
+	struct lock_table *table = lock_table;
+	uint64_t hold;
+
+	if (!table || table == LOCK_TABLE_EXITED)
+		return false;
+	e = lock_table_lookup(table, lock, type, false);
+	if (!e || !e->depth)
+		return false;
+	if (--e->depth)
+		return true;
+	hold = clock_ns() - e->acquire_ts;
+	e->hold_total += hold;
+	if (hold > e->hold_max)
+		e->hold_max = hold;
+	return true;
+}
+
+/*
+ * Acquire @lock with @lock_fn, trying @trylock_fn first so that only
+ * contended acquisitions are timed.
+ */
+#define profile_lock(retval, lock, type, trylock_fn, lock_fn, ip)	\
+	do {								\
+		(retval) = trylock_fn(lock);				\
+		if ((retval) == EBUSY) {				\
+			uint64_t __start = clock_ns();			\
+									\
+			(retval) = lock_fn(lock);			\
+			lock_acquired(lock, type, retval,		\
+				clock_ns() - __start, true, ip);	\
+		} else {						\
+			lock_acquired(lock, type, retval, 0, false, ip); \
+		}							\
+	} while (0)
+
+static
+int lookup_function(void **func, const char *name)
+{
+	if (*func)
+		return 0;
+	*func = dlsym(RTLD_NEXT, name);
+	if (!*func) {
+		if (thread_in_trace) {
+			abort();
+		}
+		fprintf(stderr, "unable to initialize pthread wrapper library.\n");
+		return EINVAL;
+	}
+	return 0;
+}
+
 int pthread_mutex_lock(pthread_mutex_t *mutex)
 {
 	static int (*mutex_lock)(pthread_mutex_t *);
@@ -53,6 +294,21 @@ int pthread_mutex_lock(pthread_mutex_t *mutex)
 	}
 
 	thread_in_trace = 1;
+	if (profile_mode) {
+		static int (*mutex_trylock)(pthread_mutex_t *);
+
+		if (profile_enabled() && !lookup_function(
+				(void **) &mutex_trylock,
+				"pthread_mutex_trylock")) {
+			profile_lock(retval, mutex, UST_PTHREAD_MUTEX,
+				mutex_trylock, mutex_lock,
+				LTTNG_UST_CALLER_IP());
+		} else {
+			retval = mutex_lock(mutex);
+		}
+		thread_in_trace = 0;
+		return retval;
+	}
 	tracepoint(lttng_ust_pthread, pthread_mutex_lock_req, mutex,
 		LTTNG_UST_CALLER_IP());
 	retval = mutex_lock(mutex);
@@ -83,6 +339,14 @@ int pthread_mutex_trylock(pthread_mutex_t *mutex)
 
 	thread_in_trace = 1;
 	retval = mutex_trylock(mutex);
+	if (profile_mode) {
+		if (profile_enabled()) {
+			lock_acquired(mutex, UST_PTHREAD_MUTEX, retval, 0,
+				false, LTTNG_UST_CALLER_IP());
+		}
+		thread_in_trace = 0;
+		return retval;
+	}
 	tracepoint(lttng_ust_pthread, pthread_mutex_trylock, mutex,
 		retval, LTTNG_UST_CALLER_IP());
 	thread_in_trace = 0;
@@ -109,9 +373,280 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex)
 	}
 
 	thread_in_trace = 1;
+	if (profile_mode) {
+		(void) lock_released(mutex, UST_PTHREAD_MUTEX);
+		retval = mutex_unlock(mutex);
+		thread_in_trace = 0;
+		return retval;
+	}
 	retval = mutex_unlock(mutex);
 	tracepoint(lttng_ust_pthread, pthread_mutex_unlock, mutex,
 		retval, LTTNG_UST_CALLER_IP());
 	thread_in_trace = 0;
 	return retval;
 }
+
+/*
+ * The functions below are only instrumented by the contention profiling
+ * mode.
+ */
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
+{
+	static int (*rwlock_rdlock)(pthread_rwlock_t *);
+	static int (*rwlock_tryrdlock)(pthread_rwlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &rwlock_rdlock, "pthread_rwlock_rdlock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode || !profile_enabled()
+			|| lookup_function((void **) &rwlock_tryrdlock,
+				"pthread_rwlock_tryrdlock"))
+		return rwlock_rdlock(rwlock);
+
+	thread_in_trace = 1;
+	profile_lock(retval, rwlock, UST_PTHREAD_RWLOCK_READ,
+		rwlock_tryrdlock, rwlock_rdlock, LTTNG_UST_CALLER_IP());
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+{
+	static int (*rwlock_wrlock)(pthread_rwlock_t *);
+	static int (*rwlock_trywrlock)(pthread_rwlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &rwlock_wrlock, "pthread_rwlock_wrlock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode || !profile_enabled()
+			|| lookup_function((void **) &rwlock_trywrlock,
+				"pthread_rwlock_trywrlock"))
+		return rwlock_wrlock(rwlock);
+
+	thread_in_trace = 1;
+	profile_lock(retval, rwlock, UST_PTHREAD_RWLOCK_WRITE,
+		rwlock_trywrlock, rwlock_wrlock, LTTNG_UST_CALLER_IP());
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock)
+{
+	static int (*rwlock_tryrdlock)(pthread_rwlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &rwlock_tryrdlock,
+			"pthread_rwlock_tryrdlock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode || !profile_enabled())
+		return rwlock_tryrdlock(rwlock);
+
+	thread_in_trace = 1;
+	retval = rwlock_tryrdlock(rwlock);
+	lock_acquired(rwlock, UST_PTHREAD_RWLOCK_READ, retval, 0, false,
+		LTTNG_UST_CALLER_IP());
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock)
+{
+	static int (*rwlock_trywrlock)(pthread_rwlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &rwlock_trywrlock,
+			"pthread_rwlock_trywrlock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode || !profile_enabled())
+		return rwlock_trywrlock(rwlock);
+
+	thread_in_trace = 1;
+	retval = rwlock_trywrlock(rwlock);
+	lock_acquired(rwlock, UST_PTHREAD_RWLOCK_WRITE, retval, 0, false,
+		LTTNG_UST_CALLER_IP());
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+{
+	static int (*rwlock_unlock)(pthread_rwlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &rwlock_unlock, "pthread_rwlock_unlock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode)
+		return rwlock_unlock(rwlock);
+
+	thread_in_trace = 1;
+	if (!lock_released(rwlock, UST_PTHREAD_RWLOCK_WRITE))
+		(void) lock_released(rwlock, UST_PTHREAD_RWLOCK_READ);
+	retval = rwlock_unlock(rwlock);
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_spin_lock(pthread_spinlock_t *lock)
+{
+	static int (*spin_lock)(pthread_spinlock_t *);
+	static int (*spin_trylock)(pthread_spinlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &spin_lock, "pthread_spin_lock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode || !profile_enabled()
+			|| lookup_function((void **) &spin_trylock,
+				"pthread_spin_trylock"))
+		return spin_lock(lock);
+
+	thread_in_trace = 1;
+	profile_lock(retval, (void *) lock, UST_PTHREAD_SPIN,
+		spin_trylock, spin_lock, LTTNG_UST_CALLER_IP());
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_spin_trylock(pthread_spinlock_t *lock)
+{
+	static int (*spin_trylock)(pthread_spinlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &spin_trylock, "pthread_spin_trylock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode || !profile_enabled())
+		return spin_trylock(lock);
+
+	thread_in_trace = 1;
+	retval = spin_trylock(lock);
+	lock_acquired((void *) lock, UST_PTHREAD_SPIN, retval, 0, false,
+		LTTNG_UST_CALLER_IP());
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_spin_unlock(pthread_spinlock_t *lock)
+{
+	static int (*spin_unlock)(pthread_spinlock_t *);
+	int retval;
+
+	if (lookup_function((void **) &spin_unlock, "pthread_spin_unlock"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode)
+		return spin_unlock(lock);
+
+	thread_in_trace = 1;
+	(void) lock_released((void *) lock, UST_PTHREAD_SPIN);
+	retval = spin_unlock(lock);
+	thread_in_trace = 0;
+	return retval;
+}
+
+/*
+ * Waiting on a condition variable releases the mutex: its hold time is
+ * interrupted for the duration of the wait. The wait itself is only
+ * aggregated, as long waits are expected.
+ */
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+	static int (*cond_wait)(pthread_cond_t *, pthread_mutex_t *);
+	uint64_t start;
+	bool held;
+	int retval;
+
+	if (lookup_function((void **) &cond_wait, "pthread_cond_wait"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode)
+		return cond_wait(cond, mutex);
+
+	thread_in_trace = 1;
+	held = lock_released(mutex, UST_PTHREAD_MUTEX);
+	start = clock_ns();
+	retval = cond_wait(cond, mutex);
+	if (profile_enabled()) {
+		lock_acquired(cond, UST_PTHREAD_COND, retval,
+			clock_ns() - start, true, LTTNG_UST_CALLER_IP());
+	}
+	if (held) {
+		lock_acquired(mutex, UST_PTHREAD_MUTEX, 0, 0, false,
+			LTTNG_UST_CALLER_IP());
+	}
+	thread_in_trace = 0;
+	return retval;
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+		const struct timespec *abstime)
+{
+	static int (*cond_timedwait)(pthread_cond_t *, pthread_mutex_t *,
+		const struct timespec *);
+	uint64_t start;
+	bool held;
+	int retval;
+
+	if (lookup_function((void **) &cond_timedwait,
+			"pthread_cond_timedwait"))
+		return EINVAL;
+	if (thread_in_trace || !profile_mode)
+		return cond_timedwait(cond, mutex, abstime);
+
+	thread_in_trace = 1;
+	held = lock_released(mutex, UST_PTHREAD_MUTEX);
+	start = clock_ns();
+	retval = cond_timedwait(cond, mutex, abstime);
+	if (profile_enabled()) {
+		lock_acquired(cond, UST_PTHREAD_COND, retval,
+			clock_ns() - start, true, LTTNG_UST_CALLER_IP());
+	}
+	if (held) {
+		lock_acquired(mutex, UST_PTHREAD_MUTEX, 0, 0, false,
+			LTTNG_UST_CALLER_IP());
+	}
+	thread_in_trace = 0;
+	return retval;
+}
+
+/* The child starts with empty statistics. */
+static
+void pthread_after_fork_child(void)
+{
+	struct lock_table *table = lock_table;
+
+	if (table && table != LOCK_TABLE_EXITED)
+		lock_table_flush(table, false);
+}
+
+static __attribute__((constructor))
+void lttng_ust_pthread_wrapper_init(void)
+{
+	const char *str;
+	unsigned long long val;
+
+	str = getenv("LTTNG_UST_PTHREAD_WAIT_THRESHOLD_NS");
+	if (str && (val = strtoull(str, NULL, 10)) > 0)
+		wait_threshold = val;
+	str = getenv("LTTNG_UST_PTHREAD_AGGREGATE_MS");
+	if (str && (val = strtoull(str, NULL, 10)) > 0) {
+		if (pthread_key_create(&lock_table_key, lock_table_destroy)) {
+			fprintf(stderr, "pthread wrapper: unable to create lock table key\n");
+		} else {
+			(void) pthread_atfork(NULL, NULL,
+				pthread_after_fork_child);
+			flush_period = val * 1000000ULL;
+		}
+	}
+	profile_mode = wait_threshold || flush_period;
+}
+
+/* Flush the lock table of the thread exiting the process. */
+static __attribute__((destructor))
+void lttng_ust_pthread_wrapper_exit(void)
+{
+	struct lock_table *table = lock_table;
+
+	if (!table || table == LOCK_TABLE_EXITED)
+		return;
+	thread_in_trace = 1;
+	lock_table_flush(table, true);
+	thread_in_trace = 0;
+}
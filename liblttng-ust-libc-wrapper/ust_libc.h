@@ -32,6 +32,19 @@ extern "C" {
 
 #include <lttng/tracepoint.h>
 
+#ifndef _UST_LIBC_HISTOGRAM
+#define _UST_LIBC_HISTOGRAM
+
+/*
+ * Allocation size classes of the malloc_histogram event: class 0
+ * counts zero-sized allocations, class i counts allocations of
+ * [2^(i-1), 2^i) bytes, and the last class also counts all the larger
+ * allocations.
+ */
+#define UST_LIBC_NR_SIZE_CLASSES	32
+
+#endif /* _UST_LIBC_HISTOGRAM */
+
 TRACEPOINT_EVENT(lttng_ust_libc, malloc,
 	TP_ARGS(size_t, size, void *, ptr, void *, ip),
 	TP_FIELDS(
@@ -84,6 +97,25 @@ TRACEPOINT_EVENT(lttng_ust_libc, posix_memalign,
 	)
 )
 
+TRACEPOINT_EVENT(lttng_ust_libc, malloc_histogram,
+	TP_ARGS(const uint64_t *, count, const uint64_t *, bytes,
+		uint64_t, free_count, void *, ip),
+	TP_FIELDS(
+		ctf_array(uint64_t, count, count, UST_LIBC_NR_SIZE_CLASSES)
+		ctf_array(uint64_t, bytes, bytes, UST_LIBC_NR_SIZE_CLASSES)
+		ctf_integer(uint64_t, free_count, free_count)
+	)
+)
+
+TRACEPOINT_EVENT(lttng_ust_libc, malloc_callsite,
+	TP_ARGS(uint64_t, count, uint64_t, bytes, void *, ip),
+	TP_FIELDS(
+		ctf_integer_hex(void *, callsite, ip)
+		ctf_integer(uint64_t, count, count)
+		ctf_integer(uint64_t, bytes, bytes)
+	)
+)
+
 #endif /* _TRACEPOINT_UST_LIBC_H */
 
 #undef TRACEPOINT_INCLUDE
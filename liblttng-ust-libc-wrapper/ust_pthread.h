@@ -31,6 +31,39 @@ extern "C" {
  */
 
 #include <lttng/tracepoint.h>
+#include <stdint.h>
+
+#ifndef _UST_PTHREAD_LOCK_STATS
+#define _UST_PTHREAD_LOCK_STATS
+
+enum ust_pthread_lock_type {
+	UST_PTHREAD_MUTEX = 0,
+	UST_PTHREAD_RWLOCK_READ = 1,
+	UST_PTHREAD_RWLOCK_WRITE = 2,
+	UST_PTHREAD_SPIN = 3,
+	UST_PTHREAD_COND = 4,
+};
+
+/*
+ * Per-thread statistics of a lock, in ns. For condition variables,
+ * nr_acquire counts the returns from wait and the wait fields the time
+ * spent waiting.
+ */
+struct ust_pthread_lock_stats {
+	void *lock;
+	void *ip;			/* Last acquisition callsite. */
+	int type;			/* enum ust_pthread_lock_type */
+	unsigned int depth;		/* Held recursion depth. */
+	uint64_t acquire_ts;
+	uint64_t nr_acquire;
+	uint64_t nr_contended;
+	uint64_t wait_total;
+	uint64_t wait_max;
+	uint64_t hold_total;
+	uint64_t hold_max;
+};
+
+#endif /* _UST_PTHREAD_LOCK_STATS */
 
 TRACEPOINT_EVENT(lttng_ust_pthread, pthread_mutex_lock_req,
 	TP_ARGS(pthread_mutex_t *, mutex, void *, ip),
@@ -63,6 +96,39 @@ TRACEPOINT_EVENT(lttng_ust_pthread, pthread_mutex_unlock,
 	)
 )
 
+TRACEPOINT_ENUM(lttng_ust_pthread, lock_type,
+	TP_ENUM_VALUES(
+		ctf_enum_value("mutex", UST_PTHREAD_MUTEX)
+		ctf_enum_value("rwlock_read", UST_PTHREAD_RWLOCK_READ)
+		ctf_enum_value("rwlock_write", UST_PTHREAD_RWLOCK_WRITE)
+		ctf_enum_value("spin", UST_PTHREAD_SPIN)
+		ctf_enum_value("cond", UST_PTHREAD_COND)
+	)
+)
+
+TRACEPOINT_EVENT(lttng_ust_pthread, lock_wait,
+	TP_ARGS(void *, lock, int, type, uint64_t, wait_ns, void *, ip),
+	TP_FIELDS(
+		ctf_integer_hex(void *, lock, lock)
+		ctf_enum(lttng_ust_pthread, lock_type, int, type, type)
+		ctf_integer(uint64_t, wait_ns, wait_ns)
+	)
+)
+
+TRACEPOINT_EVENT(lttng_ust_pthread, lock_stats,
+	TP_ARGS(const struct ust_pthread_lock_stats *, stats, void *, ip),
+	TP_FIELDS(
+		ctf_integer_hex(void *, lock, stats->lock)
+		ctf_enum(lttng_ust_pthread, lock_type, int, type, stats->type)
+		ctf_integer(uint64_t, nr_acquire, stats->nr_acquire)
+		ctf_integer(uint64_t, nr_contended, stats->nr_contended)
+		ctf_integer(uint64_t, wait_total_ns, stats->wait_total)
+		ctf_integer(uint64_t, wait_max_ns, stats->wait_max)
+		ctf_integer(uint64_t, hold_total_ns, stats->hold_total)
+		ctf_integer(uint64_t, hold_max_ns, stats->hold_max)
+	)
+)
+
 #endif /* _TRACEPOINT_UST_PTHREAD_H */
 
 #undef TRACEPOINT_INCLUDE
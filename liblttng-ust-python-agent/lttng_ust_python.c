@@ -18,8 +18,12 @@
 #define _LGPL_SOURCE
 #define TRACEPOINT_DEFINE
 #define TRACEPOINT_CREATE_PROBES
+#include <stdint.h>
+#include <string.h>
 #include "lttng_ust_python.h"
 
+#define PY_RECORD_NR_STRINGS	5
+
 /*
  * The tracepoint fired by the agent.
  */
@@ -31,3 +35,44 @@ void py_tracepoint(const char *asctime, const char *msg,
 	tracepoint(lttng_python, event, asctime, msg, logger_name, funcName,
 			lineno, int_loglevel, thread, threadName);
 }
+
+/*
+ * Checked by the agent before formatting and encoding a record.
+ */
+int py_tracepoint_enabled(void)
+{
+	return tracepoint_enabled(lttng_python, event);
+}
+
+/*
+ * Fire the tracepoint for a batch of count records packed by the agent
+ * in buf. Each record holds the lineno, int_loglevel and thread fields
+ * as native-endian 32-bit integers, followed by the asctime, msg,
+ * logger_name, funcName and threadName null-terminated strings.
+ */
+void py_tracepoint_batch(const char *buf, size_t len, unsigned int count)
+{
+	const char *end = buf + len;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		const char *str[PY_RECORD_NR_STRINGS];
+		uint32_t val[3];
+		int j;
+
+		if ((size_t) (end - buf) < sizeof(val))
+			return;
+		memcpy(val, buf, sizeof(val));
+		buf += sizeof(val);
+		for (j = 0; j < PY_RECORD_NR_STRINGS; j++) {
+			const char *nul = memchr(buf, '\0', end - buf);
+
+			if (!nul)
+				return;
+			str[j] = buf;
+			buf = nul + 1;
+		}
+		tracepoint(lttng_python, event, str[0], str[1], str[2], str[3],
+				val[0], val[1], val[2], str[4]);
+	}
+}
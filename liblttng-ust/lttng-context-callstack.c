@@ -0,0 +1,634 @@
+/*
+ * lttng-context-callstack.c
+ *
+ * LTTng UST user space call stack context.
+ *
+ * Copyright (C) 2026  EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#define _LGPL_SOURCE
+#include <sys/types.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <lttng/ust-events.h>
+#include <lttng/ust-tracer.h>
+#include <lttng/ringbuffer-config.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include <helper.h>
+#include "lttng-tracer-core.h"
+#include "../libringbuffer/backend.h"
+#include "../libringbuffer/frontend.h"
+#include "../libringbuffer/getcpu.h"
+
+/*
+ * The call stack is captured by walking the frame pointer chain of the
+ * recording thread, which only requires plain memory reads. This
+ * requires the application and its libraries to be built with frame
+ * pointers (-fno-omit-frame-pointer): code using the frame pointer
+ * register for other purposes truncates the stack or adds bogus
+ * entries to it. The walk never reads outside of the stack of the
+ * thread, or of its alternate signal stack when recording from a
+ * signal handler running on it. The bounds of the thread stack are
+ * found with pthread_getattr_np() on the first capture of each thread.
+ * The walk stops at a NULL frame pointer, or as soon as a frame
+ * pointer does not move up the stack by a sensible amount.
+ *
+ * The leading frames of the tracer itself, found by their addresses
+ * within the executable mapping of liblttng-ust, are skipped, so the
+ * stack starts at the tracepoint probe.
+ *
+ * The stack is captured by get_size() in a per-thread buffer indexed by
+ * ring buffer nesting level, so that events recorded from nested signal
+ * handlers don't clobber the stack of the interrupted event, and is
+ * written by record(). Both are called within the ring buffer
+ * reservation, at the same nesting level.
+ *
+ * In "dedup" mode, each thread keeps a small cache of the stacks it
+ * recently recorded, each entry tagged with the channel, the stream
+ * (CPU) and the packet where its stack was recorded. An event whose
+ * stack is in the cache for the current packet of its stream records
+ * its stack ID with an empty stack; otherwise it records a new stack ID
+ * along with the full stack, which defines the ID for the following
+ * events. Each packet therefore holds the definitions of the IDs it
+ * references, even when older packets are overwritten or left out of
+ * a snapshot. Stack IDs are unique within the process.
+ *
+ * The current packet of each stream is the one of the last event of
+ * the channel recorded with this context in that stream. get_size()
+ * runs before the space is reserved, so when an event turns out to be
+ * the first of a new packet, a cache hit cannot be honored anymore: the
+ * event then records stack ID 0 with an empty stack.
+ */
+
+#define LTTNG_UST_CALLSTACK_MAX_DEPTH		32
+/* Maximum number of tracer frames skipped. */
+#define LTTNG_UST_CALLSTACK_MAX_SKIP		16
+#define LTTNG_UST_CALLSTACK_MAX_FRAME_SIZE	(1UL << 20)
+#define LTTNG_UST_CALLSTACK_NESTING		4
+#define LTTNG_UST_CALLSTACK_CACHE_BITS		6
+#define LTTNG_UST_CALLSTACK_CACHE_SIZE		(1U << LTTNG_UST_CALLSTACK_CACHE_BITS)
+
+/* Per-channel state of the dedup context. */
+struct lttng_callstack_dedup {
+	unsigned long id;		/* Unique within the process */
+	int nr_cpus;
+	uint64_t *packet;		/* Current packet of each stream */
+};
+
+struct lttng_callstack {
+	unsigned int nr_entries;	/* Entries to record, 0 on dedup hit */
+	bool cache_miss;
+	int cpu;
+	uint64_t hash;
+	uint64_t id;
+	uint64_t packet;		/* Packet of the cache hit */
+	unsigned long entries[LTTNG_UST_CALLSTACK_MAX_DEPTH];
+};
+
+struct lttng_callstack_cache_entry {
+	uint64_t hash;
+	uint64_t id;
+	unsigned long dedup_id;
+	int cpu;
+	uint64_t packet;
+};
+
+struct lttng_callstack_tls {
+	struct lttng_callstack stack[LTTNG_UST_CALLSTACK_NESTING];
+	struct lttng_callstack_cache_entry cache[LTTNG_UST_CALLSTACK_CACHE_SIZE];
+	unsigned long stack_start, stack_end;	/* Thread stack, 0 if unknown */
+	bool stack_init;
+};
+
+static DEFINE_URCU_TLS(struct lttng_callstack_tls, callstack_tls);
+
+/* Last stack ID allocated in the process. */
+static unsigned long callstack_last_id;
+
+/* Last dedup state ID allocated in the process. */
+static unsigned long callstack_last_dedup_id;
+
+/* Executable mapping of liblttng-ust. Set with UST lock held. */
+static unsigned long tracer_text_start, tracer_text_end;
+
+/*
+ * Force a read (imply TLS fixup for dlopen) of TLS variables.
+ */
+void lttng_fixup_callstack_tls(void)
+{
+	asm volatile ("" : : "m" (URCU_TLS(callstack_tls)));
+}
+
+static
+struct lttng_callstack *get_nesting_callstack(void)
+{
+	unsigned int nesting = URCU_TLS(lib_ring_buffer_nesting);
+
+	/* get_size() and record() are called within the reservation. */
+	if (caa_unlikely(!nesting || nesting > LTTNG_UST_CALLSTACK_NESTING))
+		return NULL;
+	return &URCU_TLS(callstack_tls).stack[nesting - 1];
+}
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+
+/*
+ * Find the bounds of the stack of the current thread on its first
+ * capture. Signals are blocked meanwhile, like for the other contexts
+ * which set up per-thread state on the first event of a thread.
+ */
+static
+void init_thread_stack_range(struct lttng_callstack_tls *tls)
+{
+	sigset_t newmask, oldmask;
+	pthread_attr_t attr;
+	size_t size;
+	void *addr;
+
+	if (sigfillset(&newmask) || pthread_sigmask(SIG_BLOCK, &newmask, &oldmask))
+		return;
+	if (!pthread_getattr_np(pthread_self(), &attr)) {
+		if (!pthread_attr_getstack(&attr, &addr, &size)) {
+			tls->stack_start = (unsigned long) addr;
+			tls->stack_end = (unsigned long) addr + size;
+		}
+		(void) pthread_attr_destroy(&attr);
+	}
+	tls->stack_init = true;
+	(void) pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+}
+
+/*
+ * Get the bounds of the stack holding @fp: the thread stack, or the
+ * alternate signal stack when recording from a signal handler running
+ * on it. Returns 0 on success.
+ */
+static
+int get_stack_range(unsigned long fp, unsigned long *start,
+		unsigned long *end)
+{
+	struct lttng_callstack_tls *tls = &URCU_TLS(callstack_tls);
+	stack_t ss;
+
+	if (caa_unlikely(!tls->stack_init))
+		init_thread_stack_range(tls);
+	if (caa_likely(fp >= tls->stack_start && fp < tls->stack_end)) {
+		*start = tls->stack_start;
+		*end = tls->stack_end;
+		return 0;
+	}
+	if (sigaltstack(NULL, &ss) || (ss.ss_flags & SS_DISABLE))
+		return -1;
+	if (fp < (unsigned long) ss.ss_sp
+			|| fp >= (unsigned long) ss.ss_sp + ss.ss_size)
+		return -1;
+	*start = (unsigned long) ss.ss_sp;
+	*end = (unsigned long) ss.ss_sp + ss.ss_size;
+	return 0;
+}
+
+/*
+ * On these architectures, the frame pointer points to the saved frame
+ * pointer of the caller, immediately followed by the return address.
+ */
+static __attribute__((noinline))
+unsigned int walk_frames(unsigned long *entries, unsigned int max)
+{
+	unsigned long *fp = __builtin_frame_address(0);
+	unsigned long start, end;
+	unsigned int nr = 0;
+
+	if (get_stack_range((unsigned long) fp, &start, &end))
+		return 0;
+	while (fp && nr < max) {
+		unsigned long *next_fp;
+		unsigned long ret_addr;
+
+		if ((unsigned long) fp < start
+				|| (unsigned long) (fp + 2) > end)
+			break;
+		next_fp = (unsigned long *) fp[0];
+		ret_addr = fp[1];
+		if (!ret_addr)
+			break;
+		entries[nr++] = ret_addr;
+		if (next_fp <= fp
+				|| (unsigned long) next_fp - (unsigned long) fp
+					> LTTNG_UST_CALLSTACK_MAX_FRAME_SIZE
+				|| ((unsigned long) next_fp & (sizeof(unsigned long) - 1)))
+			break;
+		fp = next_fp;
+	}
+	return nr;
+}
+
+#else
+
+/* Frame layout unknown: record empty call stacks. */
+static
+unsigned int walk_frames(unsigned long *entries, unsigned int max)
+{
+	return 0;
+}
+
+#endif
+
+static
+uint64_t hash_callstack(const unsigned long *entries, unsigned int nr)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;	/* FNV-1a 64-bit */
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		hash ^= entries[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static
+struct lttng_callstack_cache_entry *get_cache_entry(uint64_t hash,
+		unsigned long dedup_id)
+{
+	return &URCU_TLS(callstack_tls).cache[(hash ^ dedup_id)
+			& (LTTNG_UST_CALLSTACK_CACHE_SIZE - 1)];
+}
+
+static
+void capture_callstack(struct lttng_callstack *stack,
+		struct lttng_callstack_dedup *dedup)
+{
+	unsigned long entries[LTTNG_UST_CALLSTACK_MAX_SKIP
+			+ LTTNG_UST_CALLSTACK_MAX_DEPTH];
+	unsigned long text_start = CMM_LOAD_SHARED(tracer_text_start),
+		text_end = CMM_LOAD_SHARED(tracer_text_end);
+	unsigned int nr, skip = 0;
+
+	nr = walk_frames(entries, LTTNG_UST_CALLSTACK_MAX_SKIP
+			+ LTTNG_UST_CALLSTACK_MAX_DEPTH);
+	while (skip < nr && skip < LTTNG_UST_CALLSTACK_MAX_SKIP
+			&& entries[skip] >= text_start
+			&& entries[skip] < text_end)
+		skip++;
+	nr = min_t(unsigned int, nr - skip, LTTNG_UST_CALLSTACK_MAX_DEPTH);
+	memcpy(stack->entries, &entries[skip], nr * sizeof(unsigned long));
+	stack->nr_entries = nr;
+	stack->cache_miss = false;
+	if (dedup) {
+		struct lttng_callstack_cache_entry *entry;
+		int cpu = lttng_ust_get_cpu();
+
+		stack->hash = hash_callstack(stack->entries, nr);
+		stack->cpu = cpu;
+		entry = get_cache_entry(stack->hash, dedup->id);
+		if (entry->id && entry->hash == stack->hash
+				&& entry->dedup_id == dedup->id
+				&& entry->cpu == cpu
+				&& cpu >= 0 && cpu < dedup->nr_cpus
+				&& entry->packet
+					== CMM_LOAD_SHARED(dedup->packet[cpu])) {
+			stack->id = entry->id;
+			stack->packet = entry->packet;
+			stack->nr_entries = 0;
+		} else {
+			/*
+			 * The cache is only updated by record(), so that a
+			 * discarded event does not leave an ID without its
+			 * stack in the trace.
+			 */
+			stack->id = 0;
+			stack->cache_miss = true;
+		}
+	}
+}
+
+static
+size_t callstack_sequence_get_size(unsigned int nr_entries, size_t offset)
+{
+	size_t size = 0;
+
+	size += lib_ring_buffer_align(offset, lttng_alignof(unsigned int));
+	size += sizeof(unsigned int);
+	size += lib_ring_buffer_align(offset + size,
+			lttng_alignof(unsigned long));
+	size += sizeof(unsigned long) * nr_entries;
+	return size;
+}
+
+static
+void callstack_sequence_record(struct lttng_callstack *stack,
+		struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	unsigned int nr_entries = stack ? stack->nr_entries : 0;
+
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(unsigned int));
+	chan->ops->event_write(ctx, &nr_entries, sizeof(unsigned int));
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(unsigned long));
+	if (nr_entries)
+		chan->ops->event_write(ctx, stack->entries,
+				sizeof(unsigned long) * nr_entries);
+}
+
+static
+size_t callstack_get_size(struct lttng_ctx_field *field, size_t offset)
+{
+	struct lttng_callstack *stack = get_nesting_callstack();
+
+	if (caa_unlikely(!stack))
+		return callstack_sequence_get_size(0, offset);
+	capture_callstack(stack, NULL);
+	return callstack_sequence_get_size(stack->nr_entries, offset);
+}
+
+static
+void callstack_record(struct lttng_ctx_field *field,
+		struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	callstack_sequence_record(get_nesting_callstack(), ctx, chan);
+}
+
+/*
+ * In dedup mode, the stack ID field comes first: its get_size()
+ * captures the stack, and its record() allocates the ID of a new stack.
+ * The sequence field which follows records the stack on a cache miss
+ * and inserts it in the cache.
+ */
+static
+size_t callstack_id_get_size(struct lttng_ctx_field *field, size_t offset)
+{
+	struct lttng_callstack *stack = get_nesting_callstack();
+	size_t size = 0;
+
+	if (caa_likely(stack))
+		capture_callstack(stack, field->u.callstack_dedup);
+	size += lib_ring_buffer_align(offset, lttng_alignof(uint64_t));
+	size += sizeof(uint64_t);
+	return size;
+}
+
+/*
+ * Return the sequence number of the packet being written by @ctx, the
+ * same as the packet_seq_num field of its packet context.
+ */
+static
+uint64_t get_packet_seq_num(struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	struct channel *rb_chan = ctx->chan;
+	struct lttng_ust_lib_ring_buffer_backend_counts *counts;
+	unsigned long idx;
+
+	idx = subbuf_index(ctx->buf_offset, rb_chan);
+	counts = shmp_index(ctx->handle, ctx->buf->backend.buf_cnt, idx);
+	if (!counts)
+		return 0;
+	return rb_chan->backend.num_subbuf * counts->seq_cnt + idx;
+}
+
+/*
+ * Publish the packet being written as the current packet of the stream,
+ * and return it.
+ */
+static
+uint64_t update_current_packet(struct lttng_callstack_dedup *dedup,
+		struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	uint64_t packet = get_packet_seq_num(ctx);
+
+	if (caa_likely(ctx->cpu >= 0 && ctx->cpu < dedup->nr_cpus)
+			&& CMM_LOAD_SHARED(dedup->packet[ctx->cpu]) != packet)
+		CMM_STORE_SHARED(dedup->packet[ctx->cpu], packet);
+	return packet;
+}
+
+static
+void callstack_id_record(struct lttng_ctx_field *field,
+		struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	struct lttng_callstack_dedup *dedup = field->u.callstack_dedup;
+	struct lttng_callstack *stack = get_nesting_callstack();
+	uint64_t id = 0, packet;
+
+	packet = update_current_packet(dedup, ctx);
+	if (caa_likely(stack)) {
+		if (stack->cache_miss) {
+			if (!stack->id)
+				stack->id = uatomic_add_return(&callstack_last_id, 1);
+			stack->cpu = ctx->cpu;
+			stack->packet = packet;
+		} else if (stack->cpu != ctx->cpu || stack->packet != packet) {
+			/* The stack is not defined in this packet. */
+			stack->id = 0;
+		}
+		id = stack->id;
+	}
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(id));
+	chan->ops->event_write(ctx, &id, sizeof(id));
+}
+
+static
+size_t callstack_dedup_get_size(struct lttng_ctx_field *field, size_t offset)
+{
+	struct lttng_callstack *stack = get_nesting_callstack();
+
+	return callstack_sequence_get_size(stack ? stack->nr_entries : 0,
+			offset);
+}
+
+static
+void callstack_dedup_record(struct lttng_ctx_field *field,
+		struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	struct lttng_callstack_dedup *dedup = field->u.callstack_dedup;
+	struct lttng_callstack *stack = get_nesting_callstack();
+
+	callstack_sequence_record(stack, ctx, chan);
+	if (stack && stack->cache_miss && stack->id) {
+		struct lttng_callstack_cache_entry *entry;
+
+		entry = get_cache_entry(stack->hash, dedup->id);
+		entry->hash = stack->hash;
+		entry->id = stack->id;
+		entry->dedup_id = dedup->id;
+		entry->cpu = stack->cpu;
+		entry->packet = stack->packet;
+	}
+}
+
+static
+void callstack_dedup_destroy(struct lttng_ctx_field *field)
+{
+	struct lttng_callstack_dedup *dedup = field->u.callstack_dedup;
+
+	if (!dedup)
+		return;
+	free(dedup->packet);
+	free(dedup);
+}
+
+/*
+ * Find the executable mapping of liblttng-ust in /proc/self/maps rather
+ * than with dladdr(), which would take the dynamic loader lock within
+ * the UST lock.
+ */
+static
+int init_tracer_text_range(void)
+{
+	unsigned long addr = (unsigned long) &capture_callstack;
+	char line[512];
+	int ret = -ENOENT;
+	FILE *fp;
+
+	if (tracer_text_end)
+		return 0;
+	fp = fopen("/proc/self/maps", "r");
+	if (!fp)
+		return -errno;
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned long start, end;
+
+		if (sscanf(line, "%lx-%lx", &start, &end) != 2)
+			continue;
+		if (addr >= start && addr < end) {
+			CMM_STORE_SHARED(tracer_text_start, start);
+			CMM_STORE_SHARED(tracer_text_end, end);
+			ret = 0;
+			break;
+		}
+	}
+	fclose(fp);
+	return ret;
+}
+
+static
+void init_callstack_sequence_type(struct lttng_type *type)
+{
+	struct lttng_basic_type *length_type = &type->u.sequence.length_type;
+	struct lttng_basic_type *elem_type = &type->u.sequence.elem_type;
+
+	type->atype = atype_sequence;
+	length_type->atype = atype_integer;
+	length_type->u.basic.integer.size = sizeof(unsigned int) * CHAR_BIT;
+	length_type->u.basic.integer.alignment = lttng_alignof(unsigned int) * CHAR_BIT;
+	length_type->u.basic.integer.signedness = lttng_is_signed_type(unsigned int);
+	length_type->u.basic.integer.reverse_byte_order = 0;
+	length_type->u.basic.integer.base = 10;
+	length_type->u.basic.integer.encoding = lttng_encode_none;
+	elem_type->atype = atype_integer;
+	elem_type->u.basic.integer.size = sizeof(unsigned long) * CHAR_BIT;
+	elem_type->u.basic.integer.alignment = lttng_alignof(unsigned long) * CHAR_BIT;
+	elem_type->u.basic.integer.signedness = lttng_is_signed_type(unsigned long);
+	elem_type->u.basic.integer.reverse_byte_order = 0;
+	elem_type->u.basic.integer.base = 16;
+	elem_type->u.basic.integer.encoding = lttng_encode_none;
+}
+
+int lttng_add_callstack_user_to_ctx(struct lttng_ctx **ctx)
+{
+	struct lttng_ctx_field *field;
+	int ret;
+
+	ret = init_tracer_text_range();
+	if (ret)
+		return ret;
+	field = lttng_append_context(ctx);
+	if (!field)
+		return -ENOMEM;
+	if (lttng_find_context(*ctx, "callstack_user")) {
+		lttng_remove_context_field(ctx, field);
+		return -EEXIST;
+	}
+	field->event_field.name = "callstack_user";
+	init_callstack_sequence_type(&field->event_field.type);
+	field->get_size = callstack_get_size;
+	field->record = callstack_record;
+	lttng_context_update(*ctx);
+	return 0;
+}
+
+int lttng_add_callstack_user_dedup_to_ctx(struct lttng_ctx **ctx)
+{
+	struct lttng_ctx_field *id_field, *field;
+	struct lttng_callstack_dedup *dedup;
+	int ret;
+
+	ret = init_tracer_text_range();
+	if (ret)
+		return ret;
+	dedup = zmalloc(sizeof(*dedup));
+	if (!dedup)
+		return -ENOMEM;
+	dedup->nr_cpus = num_possible_cpus();
+	dedup->packet = zmalloc(dedup->nr_cpus * sizeof(*dedup->packet));
+	if (!dedup->packet) {
+		free(dedup);
+		return -ENOMEM;
+	}
+	dedup->id = uatomic_add_return(&callstack_last_dedup_id, 1);
+	id_field = lttng_append_context(ctx);
+	if (!id_field) {
+		free(dedup->packet);
+		free(dedup);
+		return -ENOMEM;
+	}
+	if (lttng_find_context(*ctx, "callstack_user_id")
+			|| lttng_find_context(*ctx, "callstack_user")) {
+		lttng_remove_context_field(ctx, id_field);
+		free(dedup->packet);
+		free(dedup);
+		return -EEXIST;
+	}
+	id_field->event_field.name = "callstack_user_id";
+	id_field->event_field.type.atype = atype_integer;
+	id_field->event_field.type.u.basic.integer.size = sizeof(uint64_t) * CHAR_BIT;
+	id_field->event_field.type.u.basic.integer.alignment = lttng_alignof(uint64_t) * CHAR_BIT;
+	id_field->event_field.type.u.basic.integer.signedness = lttng_is_signed_type(uint64_t);
+	id_field->event_field.type.u.basic.integer.reverse_byte_order = 0;
+	id_field->event_field.type.u.basic.integer.base = 10;
+	id_field->event_field.type.u.basic.integer.encoding = lttng_encode_none;
+	id_field->get_size = callstack_id_get_size;
+	id_field->record = callstack_id_record;
+	id_field->u.callstack_dedup = dedup;
+	id_field->destroy = callstack_dedup_destroy;
+
+	field = lttng_append_context(ctx);
+	if (!field) {
+		/* The fields may have moved: remove the last one. */
+		lttng_remove_context_field(ctx,
+			&(*ctx)->fields[(*ctx)->nr_fields - 1]);
+		free(dedup->packet);
+		free(dedup);
+		return -ENOMEM;
+	}
+	field->event_field.name = "callstack_user";
+	init_callstack_sequence_type(&field->event_field.type);
+	field->get_size = callstack_dedup_get_size;
+	field->record = callstack_dedup_record;
+	field->u.callstack_dedup = dedup;
+	lttng_context_update(*ctx);
+	return 0;
+}
@@ -29,28 +29,28 @@
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
 
+#include "lttng-tracer-core.h"
 #include "ns.h"
 
 /*
  * We cache the result to ensure we don't stat(2) the proc filesystem on
  * each event. The mount namespace is global to the process.
  */
-static ino_t cached_mnt_ns = NS_INO_UNINITIALIZED;
+static struct lttng_context_cache_slot cached_mnt_ns;
 
 static
-ino_t get_mnt_ns(void)
+ino_t get_mnt_ns(unsigned long gen)
 {
 	struct stat sb;
+	uint64_t cached;
 	ino_t mnt_ns;
 
-	mnt_ns = CMM_LOAD_SHARED(cached_mnt_ns);
-
 	/*
-	 * If the cache is populated, do nothing and return the
-	 * cached inode number.
+	 * If the cache is populated for the current generation, do
+	 * nothing and return the cached inode number.
 	 */
-	if (caa_likely(mnt_ns != NS_INO_UNINITIALIZED))
-		return mnt_ns;
+	if (caa_likely(lttng_context_cache_slot_get(&cached_mnt_ns, gen, &cached)))
+		return (ino_t) cached;
 
 	/*
 	 * At this point we have to populate the cache, set the initial
@@ -67,7 +67,7 @@ ino_t get_mnt_ns(void)
 	/*
 	 * And finally, store the inode number in the cache.
 	 */
-	CMM_STORE_SHARED(cached_mnt_ns, mnt_ns);
+	lttng_context_cache_slot_set(&cached_mnt_ns, gen, mnt_ns);
 
 	return mnt_ns;
 }
@@ -80,7 +80,7 @@ ino_t get_mnt_ns(void)
  */
 void lttng_context_mnt_ns_reset(void)
 {
-	CMM_STORE_SHARED(cached_mnt_ns, NS_INO_UNINITIALIZED);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -100,7 +100,7 @@ void mnt_ns_record(struct lttng_ctx_field *field,
 {
 	ino_t mnt_ns;
 
-	mnt_ns = get_mnt_ns();
+	mnt_ns = get_mnt_ns(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(mnt_ns));
 	chan->ops->event_write(ctx, &mnt_ns, sizeof(mnt_ns));
 }
@@ -109,7 +109,7 @@ static
 void mnt_ns_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_mnt_ns();
+	value->u.s64 = get_mnt_ns(lttng_context_cache_get_gen());
 }
 
 int lttng_add_mnt_ns_to_ctx(struct lttng_ctx **ctx)
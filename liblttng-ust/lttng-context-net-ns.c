@@ -37,26 +37,21 @@
  * We cache the result to ensure we don't stat(2) the proc filesystem on
  * each event.
  */
-#ifdef CONFIG_RCU_TLS
-static DEFINE_URCU_TLS(ino_t, cached_net_ns) = NS_INO_UNINITIALIZED;
-#else
-static DEFINE_URCU_TLS_INIT(ino_t, cached_net_ns, NS_INO_UNINITIALIZED);
-#endif
+static DEFINE_URCU_TLS(ino_t, cached_net_ns);
+static DEFINE_URCU_TLS(unsigned long, cached_net_ns_gen);
 
 static
-ino_t get_net_ns(void)
+ino_t get_net_ns(unsigned long gen)
 {
 	struct stat sb;
 	ino_t net_ns;
 
-	net_ns = CMM_LOAD_SHARED(URCU_TLS(cached_net_ns));
-
 	/*
-	 * If the cache is populated, do nothing and return the
-	 * cached inode number.
+	 * If the cache is populated for the current generation, do
+	 * nothing and return the cached inode number.
 	 */
-	if (caa_likely(net_ns != NS_INO_UNINITIALIZED))
-		return net_ns;
+	if (caa_likely(CMM_LOAD_SHARED(URCU_TLS(cached_net_ns_gen)) == gen))
+		return CMM_LOAD_SHARED(URCU_TLS(cached_net_ns));
 
 	/*
 	 * At this point we have to populate the cache, set the initial
@@ -88,6 +83,7 @@ ino_t get_net_ns(void)
 	 * And finally, store the inode number in the cache.
 	 */
 	CMM_STORE_SHARED(URCU_TLS(cached_net_ns), net_ns);
+	CMM_STORE_SHARED(URCU_TLS(cached_net_ns_gen), gen);
 
 	return net_ns;
 }
@@ -100,7 +96,7 @@ ino_t get_net_ns(void)
  */
 void lttng_context_net_ns_reset(void)
 {
-	CMM_STORE_SHARED(URCU_TLS(cached_net_ns), NS_INO_UNINITIALIZED);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -120,7 +116,7 @@ void net_ns_record(struct lttng_ctx_field *field,
 {
 	ino_t net_ns;
 
-	net_ns = get_net_ns();
+	net_ns = get_net_ns(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(net_ns));
 	chan->ops->event_write(ctx, &net_ns, sizeof(net_ns));
 }
@@ -129,7 +125,7 @@ static
 void net_ns_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_net_ns();
+	value->u.s64 = get_net_ns(lttng_context_cache_get_gen());
 }
 
 int lttng_add_net_ns_to_ctx(struct lttng_ctx **ctx)
@@ -164,4 +160,5 @@ int lttng_add_net_ns_to_ctx(struct lttng_ctx **ctx)
 void lttng_fixup_net_ns_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(cached_net_ns)));
+	asm volatile ("" : : "m" (URCU_TLS(cached_net_ns_gen)));
 }
@@ -27,6 +27,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/syscall.h>
 #include <lttng/ust-events.h>
@@ -40,8 +43,10 @@
 #include <usterr-signal-safe.h>
 #include <signal.h>
 #include <urcu/tls-compat.h>
+#include <lttng/ust-tid.h>
 #include "perf_event.h"
 #include "lttng-tracer-core.h"
+#include "getenv.h"
 
 /*
  * We use a global perf counter key and iterate on per-thread RCU lists
@@ -51,27 +56,65 @@
  *
  * Updates and traversals of thread_list are protected by UST lock.
  * Updates to rcu_field_list are protected by UST lock.
+ *
+ * Perf counters added to the same context are gathered in perf event
+ * groups of up to LTTNG_PERF_COUNTER_GROUP_MAX counters: the kernel
+ * schedules the counters of a group together, and all of them are read
+ * in a single sweep when the group leader field is recorded. The other
+ * fields of the group then record the values of that sweep, so the
+ * per-counter fields stay unchanged in the trace.
+ *
+ * A thread sets up its thread fields on its first event, unless they
+ * were prewarmed for it by lttng_perf_counter_prewarm() at session
+ * start.
  */
 
+#define LTTNG_PERF_COUNTER_GROUP_MAX	8
+
+struct lttng_perf_counter_group {
+	unsigned int refcount;			/* Fields using this group. Protected by UST lock. */
+	unsigned int nr_counters;
+	struct perf_event_attr attr[LTTNG_PERF_COUNTER_GROUP_MAX];
+	struct cds_list_head thread_field_list;	/* Per-group list of thread fields */
+};
+
 struct lttng_perf_counter_thread_field {
-	struct lttng_perf_counter_field *field;	/* Back reference */
-	struct perf_event_mmap_page *pc;
-	struct cds_list_head thread_field_node;	/* Per-field list of thread fields (node) */
+	struct lttng_perf_counter_group *group;	/* Back reference */
+	struct cds_list_head thread_field_node;	/* Per-group list of thread fields (node) */
 	struct cds_list_head rcu_field_node;	/* RCU per-thread list of fields (node) */
-	int fd;					/* Perf FD */
+	unsigned int nr_counters;		/* Counters opened for this thread */
+	uint64_t sweep_tsc;			/* Timestamp of the event which read values */
+	struct perf_event_mmap_page *pc[LTTNG_PERF_COUNTER_GROUP_MAX];
+	int fd[LTTNG_PERF_COUNTER_GROUP_MAX];	/* Perf FDs, leader first */
+	uint64_t values[LTTNG_PERF_COUNTER_GROUP_MAX];
 };
 
 struct lttng_perf_counter_thread {
 	struct cds_list_head rcu_field_list;	/* RCU per-thread list of fields */
+	struct cds_list_head thread_node;	/* perf_thread_list node, if prewarming */
+	pid_t tid;
+	uint64_t start_time;			/* Of the prewarmed thread, in clock ticks */
+	bool adopted;				/* Owned by its thread through perf_counter_key */
+	bool stale;				/* Not seen by the current prewarm scan */
 };
 
 struct lttng_perf_counter_field {
-	struct perf_event_attr attr;
-	struct cds_list_head thread_field_list;	/* Per-field list of thread fields */
+	struct lttng_perf_counter_group *group;
+	unsigned int index;			/* Index within the group, 0 for the leader */
 };
 
 static pthread_key_t perf_counter_key;
 
+/*
+ * Threads using the perf counter contexts when prewarming is enabled,
+ * including the prewarmed threads which did not record any event yet.
+ * Protected by the perf lock.
+ */
+static CDS_LIST_HEAD(perf_thread_list);
+
+/* Set from the LTTNG_UST_PERF_PREWARM environment variable. */
+static bool perf_prewarm;
+
 /*
  * lttng_perf_lock - Protect lttng-ust perf counter data structures
  *
@@ -174,20 +217,31 @@ size_t perf_counter_get_size(struct lttng_ctx_field *field, size_t offset)
 	return size;
 }
 
+/*
+ * The group leader is opened with PERF_FORMAT_GROUP, so a single read
+ * returns the values of all the counters of the group.
+ */
 static
-uint64_t read_perf_counter_syscall(
-		struct lttng_perf_counter_thread_field *thread_field)
+void read_perf_counters_syscall(
+		struct lttng_perf_counter_thread_field *thread_field,
+		uint64_t *values)
 {
-	uint64_t count;
-
-	if (caa_unlikely(thread_field->fd < 0))
-		return 0;
+	uint64_t buf[1 + LTTNG_PERF_COUNTER_GROUP_MAX];
+	unsigned int i, nr = thread_field->nr_counters;
+	ssize_t len;
 
-	if (caa_unlikely(read(thread_field->fd, &count, sizeof(count))
-				< sizeof(count)))
-		return 0;
+	memset(values, 0, nr * sizeof(*values));
+	if (caa_unlikely(thread_field->fd[0] < 0))
+		return;
 
-	return count;
+	len = read(thread_field->fd[0], buf, (1 + nr) * sizeof(uint64_t));
+	if (caa_unlikely(len < (ssize_t) sizeof(uint64_t)))
+		return;
+	for (i = 0; i < nr && i < buf[0]; i++) {
+		if ((i + 2) * sizeof(uint64_t) > (size_t) len)
+			break;
+		values[i] = buf[i + 1];
+	}
 }
 
 #if defined(__x86_64__) || defined(__i386__)
@@ -211,58 +265,83 @@ bool has_rdpmc(struct perf_event_mmap_page *pc)
 	return pc->cap_user_rdpmc;
 }
 
+/*
+ * Read all the counters of the group with rdpmc within a single
+ * seqlock-protected sweep: the sweep is retried if any of the user
+ * pages was updated concurrently.
+ */
 static
-uint64_t arch_read_perf_counter(
-		struct lttng_perf_counter_thread_field *thread_field)
+void arch_read_perf_counters(
+		struct lttng_perf_counter_thread_field *thread_field,
+		uint64_t *values)
 {
-	uint32_t seq, idx;
-	uint64_t count;
-	struct perf_event_mmap_page *pc = thread_field->pc;
-
-	if (caa_unlikely(!pc))
-		return 0;
+	uint32_t seq[LTTNG_PERF_COUNTER_GROUP_MAX];
+	unsigned int i, nr = thread_field->nr_counters;
+	bool retry;
+
+	for (i = 0; i < nr; i++) {
+		if (caa_unlikely(!thread_field->pc[i])) {
+			read_perf_counters_syscall(thread_field, values);
+			return;
+		}
+	}
 
 	do {
-		seq = CMM_LOAD_SHARED(pc->lock);
+		for (i = 0; i < nr; i++)
+			seq[i] = CMM_LOAD_SHARED(thread_field->pc[i]->lock);
 		cmm_barrier();
 
-		idx = pc->index;
-		if (caa_likely(has_rdpmc(pc) && idx)) {
+		for (i = 0; i < nr; i++) {
+			struct perf_event_mmap_page *pc = thread_field->pc[i];
+			uint32_t idx = pc->index;
 			int64_t pmcval;
 
+			if (caa_unlikely(!has_rdpmc(pc) || !idx)) {
+				/* Fall-back on system call if rdpmc cannot be used. */
+				read_perf_counters_syscall(thread_field, values);
+				return;
+			}
 			pmcval = rdpmc(idx - 1);
 			/* Sign-extend the pmc register result. */
 			pmcval <<= 64 - pc->pmc_width;
 			pmcval >>= 64 - pc->pmc_width;
-			count = pc->offset + pmcval;
-		} else {
-			/* Fall-back on system call if rdpmc cannot be used. */
-			return read_perf_counter_syscall(thread_field);
+			values[i] = pc->offset + pmcval;
 		}
 		cmm_barrier();
-	} while (CMM_LOAD_SHARED(pc->lock) != seq);
 
-	return count;
+		retry = false;
+		for (i = 0; i < nr; i++) {
+			if (CMM_LOAD_SHARED(thread_field->pc[i]->lock) != seq[i]) {
+				retry = true;
+				break;
+			}
+		}
+	} while (retry);
 }
 
 static
 int arch_perf_keep_fd(struct lttng_perf_counter_thread_field *thread_field)
 {
-	struct perf_event_mmap_page *pc = thread_field->pc;
+	unsigned int i;
 
-	if (!pc)
-		return 0;
-	return !has_rdpmc(pc);
+	for (i = 0; i < thread_field->nr_counters; i++) {
+		struct perf_event_mmap_page *pc = thread_field->pc[i];
+
+		if (!pc || !has_rdpmc(pc))
+			return 1;
+	}
+	return 0;
 }
 
 #else
 
 /* Generic (slow) implementation using a read system call. */
 static
-uint64_t arch_read_perf_counter(
-		struct lttng_perf_counter_thread_field *thread_field)
+void arch_read_perf_counters(
+		struct lttng_perf_counter_thread_field *thread_field,
+		uint64_t *values)
 {
-	return read_perf_counter_syscall(thread_field);
+	read_perf_counters_syscall(thread_field, values);
 }
 
 static
@@ -282,12 +361,15 @@ int sys_perf_event_open(struct perf_event_attr *attr,
 			group_fd, flags);
 }
 
+/*
+ * @tid is 0 for the current thread.
+ */
 static
-int open_perf_fd(struct perf_event_attr *attr)
+int open_perf_fd(struct perf_event_attr *attr, pid_t tid, int group_fd)
 {
 	int fd;
 
-	fd = sys_perf_event_open(attr, 0, -1, -1, 0);
+	fd = sys_perf_event_open(attr, tid, -1, group_fd, 0);
 	if (fd < 0)
 		return -1;
 
@@ -308,19 +390,49 @@ void close_perf_fd(int fd)
 	}
 }
 
-static void setup_perf(struct lttng_perf_counter_thread_field *thread_field)
+/*
+ * Open the group leader, then its siblings. A sibling which cannot be
+ * opened keeps a -1 FD and reads as 0.
+ */
+static
+void open_perf_group_fds(struct perf_event_attr *attr, unsigned int nr,
+		pid_t tid, int *fds)
 {
-	void *perf_addr;
+	unsigned int i;
 
-	perf_addr = mmap(NULL, sizeof(struct perf_event_mmap_page),
-			PROT_READ, MAP_SHARED, thread_field->fd, 0);
-	if (perf_addr == MAP_FAILED)
-		perf_addr = NULL;
-	thread_field->pc = perf_addr;
+	for (i = 0; i < nr; i++) {
+		if (i && fds[0] < 0)
+			fds[i] = -1;
+		else
+			fds[i] = open_perf_fd(&attr[i], tid, i ? fds[0] : -1);
+	}
+}
 
+static void setup_perf(struct lttng_perf_counter_thread_field *thread_field)
+{
+	unsigned int i;
+
+	for (i = 0; i < thread_field->nr_counters; i++) {
+		void *perf_addr;
+
+		if (thread_field->fd[i] < 0)
+			continue;
+		perf_addr = mmap(NULL, sizeof(struct perf_event_mmap_page),
+				PROT_READ, MAP_SHARED, thread_field->fd[i], 0);
+		if (perf_addr == MAP_FAILED)
+			perf_addr = NULL;
+		thread_field->pc[i] = perf_addr;
+	}
+
+	/*
+	 * The user pages keep the events alive, so the FDs are only
+	 * needed by the read system call fall-back.
+	 */
 	if (!arch_perf_keep_fd(thread_field)) {
-		close_perf_fd(thread_field->fd);
-		thread_field->fd = -1;
+		for (i = 0; i < thread_field->nr_counters; i++) {
+			close_perf_fd(thread_field->fd[i]);
+			thread_field->fd[i] = -1;
+		}
 	}
 }
 
@@ -338,6 +450,110 @@ void unmap_perf_page(struct perf_event_mmap_page *pc)
 	}
 }
 
+static
+void destroy_perf_thread(struct lttng_perf_counter_thread *perf_thread);
+
+/* Called with perf lock held */
+static
+struct lttng_perf_counter_thread *find_perf_thread(pid_t tid)
+{
+	struct lttng_perf_counter_thread *perf_thread;
+
+	cds_list_for_each_entry(perf_thread, &perf_thread_list, thread_node) {
+		if (perf_thread->tid == tid)
+			return perf_thread;
+	}
+	return NULL;
+}
+
+/* Called with perf lock held */
+static
+struct lttng_perf_counter_thread *create_perf_thread(pid_t tid,
+		uint64_t start_time)
+{
+	struct lttng_perf_counter_thread *perf_thread;
+
+	perf_thread = zmalloc(sizeof(*perf_thread));
+	if (!perf_thread)
+		abort();
+	CDS_INIT_LIST_HEAD(&perf_thread->rcu_field_list);
+	perf_thread->tid = tid;
+	perf_thread->start_time = start_time;
+	cds_list_add(&perf_thread->thread_node, &perf_thread_list);
+	return perf_thread;
+}
+
+/*
+ * Get the start time of thread @tid, which tells apart the threads
+ * reusing the ID of an exited thread. Returns 0 on success.
+ */
+static
+int get_thread_start_time(pid_t tid, uint64_t *start_time)
+{
+	char path[64], buf[1024], *p, *end;
+	unsigned int i;
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int) tid);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	do {
+		len = read(fd, buf, sizeof(buf) - 1);
+	} while (len < 0 && errno == EINTR);
+	(void) close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	/* The command name may contain spaces and parentheses. */
+	p = strrchr(buf, ')');
+	if (!p)
+		return -1;
+	/* The start time is the 20th field after the command name. */
+	for (i = 0; i < 20; i++) {
+		p = strchr(p + 1, ' ');
+		if (!p)
+			return -1;
+	}
+	errno = 0;
+	*start_time = strtoull(p + 1, &end, 10);
+	if (errno || end == p + 1)
+		return -1;
+	return 0;
+}
+
+/*
+ * Adopt the fields prewarmed for the current thread, if any. They were
+ * opened for its thread ID, so check that they were not prewarmed for
+ * an exited thread which had the same ID. Only used when prewarming is
+ * enabled: threads are otherwise not registered in perf_thread_list.
+ */
+static
+struct lttng_perf_counter_thread *adopt_perf_thread(void)
+{
+	struct lttng_perf_counter_thread *perf_thread;
+	pid_t tid;
+
+	tid = lttng_gettid();
+	lttng_perf_lock();
+	perf_thread = find_perf_thread(tid);
+	if (perf_thread && !perf_thread->adopted) {
+		uint64_t start_time;
+
+		if (get_thread_start_time(tid, &start_time)
+				|| start_time != perf_thread->start_time) {
+			destroy_perf_thread(perf_thread);
+			perf_thread = NULL;
+		}
+	}
+	if (!perf_thread || perf_thread->adopted)
+		perf_thread = create_perf_thread(tid, 0);
+	perf_thread->adopted = true;
+	lttng_perf_unlock();
+	return perf_thread;
+}
+
 static
 struct lttng_perf_counter_thread *alloc_perf_counter_thread(void)
 {
@@ -355,10 +571,15 @@ struct lttng_perf_counter_thread *alloc_perf_counter_thread(void)
 	perf_thread = pthread_getspecific(perf_counter_key);
 	if (perf_thread)
 		goto skip;
-	perf_thread = zmalloc(sizeof(*perf_thread));
-	if (!perf_thread)
-		abort();
-	CDS_INIT_LIST_HEAD(&perf_thread->rcu_field_list);
+	if (perf_prewarm) {
+		perf_thread = adopt_perf_thread();
+	} else {
+		perf_thread = zmalloc(sizeof(*perf_thread));
+		if (!perf_thread)
+			abort();
+		CDS_INIT_LIST_HEAD(&perf_thread->rcu_field_list);
+		CDS_INIT_LIST_HEAD(&perf_thread->thread_node);
+	}
 	ret = pthread_setspecific(perf_counter_key, perf_thread);
 	if (ret)
 		abort();
@@ -371,10 +592,45 @@ skip:
 
 static
 struct lttng_perf_counter_thread_field *
-	add_thread_field(struct lttng_perf_counter_field *perf_field,
+	find_thread_field(struct lttng_perf_counter_group *group,
 		struct lttng_perf_counter_thread *perf_thread)
 {
 	struct lttng_perf_counter_thread_field *thread_field;
+
+	cds_list_for_each_entry_rcu(thread_field, &perf_thread->rcu_field_list,
+			rcu_field_node) {
+		if (thread_field->group == group)
+			return thread_field;
+	}
+	return NULL;
+}
+
+/*
+ * Close and unmap the counters, and free the thread field. Called
+ * with perf lock held, once the thread field is unreachable.
+ */
+static
+void release_thread_field(struct lttng_perf_counter_thread_field *thread_field)
+{
+	unsigned int i;
+
+	for (i = 0; i < thread_field->nr_counters; i++) {
+		close_perf_fd(thread_field->fd[i]);
+		unmap_perf_page(thread_field->pc[i]);
+	}
+	free(thread_field);
+}
+
+/*
+ * @tid is 0 when called by the thread itself, or the thread ID when
+ * prewarming on its behalf.
+ */
+static
+struct lttng_perf_counter_thread_field *
+	add_thread_field(struct lttng_perf_counter_group *group,
+		struct lttng_perf_counter_thread *perf_thread, pid_t tid)
+{
+	struct lttng_perf_counter_thread_field *thread_field, *new_field;
 	sigset_t newmask, oldmask;
 	int ret;
 
@@ -385,27 +641,33 @@ struct lttng_perf_counter_thread_field *
 	if (ret)
 		abort();
 	/* Check again with signals disabled */
-	cds_list_for_each_entry_rcu(thread_field, &perf_thread->rcu_field_list,
-			rcu_field_node) {
-		if (thread_field->field == perf_field)
-			goto skip;
-	}
-	thread_field = zmalloc(sizeof(*thread_field));
-	if (!thread_field)
+	thread_field = find_thread_field(group, perf_thread);
+	if (thread_field)
+		goto skip;
+	new_field = zmalloc(sizeof(*new_field));
+	if (!new_field)
 		abort();
-	thread_field->field = perf_field;
-	thread_field->fd = open_perf_fd(&perf_field->attr);
-	if (thread_field->fd >= 0)
-		setup_perf(thread_field);
+	new_field->group = group;
+	new_field->nr_counters = group->nr_counters;
+	new_field->sweep_tsc = UINT64_MAX;
+	open_perf_group_fds(group->attr, group->nr_counters, tid, new_field->fd);
+	setup_perf(new_field);
 	/*
-	 * Note: thread_field->pc can be NULL if setup_perf() fails.
-	 * Also, thread_field->fd can be -1 if open_perf_fd() fails.
+	 * Note: thread_field->pc[i] can be NULL if setup_perf() fails.
+	 * Also, thread_field->fd[i] can be -1 if open_perf_fd() fails.
 	 */
 	lttng_perf_lock();
-	cds_list_add_rcu(&thread_field->rcu_field_node,
-			&perf_thread->rcu_field_list);
-	cds_list_add(&thread_field->thread_field_node,
-			&perf_field->thread_field_list);
+	/* Check again, prewarming may have raced with the thread. */
+	thread_field = find_thread_field(group, perf_thread);
+	if (!thread_field) {
+		thread_field = new_field;
+		cds_list_add_rcu(&thread_field->rcu_field_node,
+				&perf_thread->rcu_field_list);
+		cds_list_add(&thread_field->thread_field_node,
+				&group->thread_field_list);
+	} else {
+		release_thread_field(new_field);
+	}
 	lttng_perf_unlock();
 skip:
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
@@ -416,7 +678,7 @@ skip:
 
 static
 struct lttng_perf_counter_thread_field *
-		get_thread_field(struct lttng_perf_counter_field *field)
+		get_thread_field(struct lttng_perf_counter_group *group)
 {
 	struct lttng_perf_counter_thread *perf_thread;
 	struct lttng_perf_counter_thread_field *thread_field;
@@ -424,34 +686,34 @@ struct lttng_perf_counter_thread_field *
 	perf_thread = pthread_getspecific(perf_counter_key);
 	if (!perf_thread)
 		perf_thread = alloc_perf_counter_thread();
-	cds_list_for_each_entry_rcu(thread_field, &perf_thread->rcu_field_list,
-			rcu_field_node) {
-		if (thread_field->field == field)
-			return thread_field;
-	}
+	thread_field = find_thread_field(group, perf_thread);
+	if (caa_likely(thread_field))
+		return thread_field;
 	/* perf_counter_thread_field not found, need to add one */
-	return add_thread_field(field, perf_thread);
-}
-
-static
-uint64_t wrapper_perf_counter_read(struct lttng_ctx_field *field)
-{
-	struct lttng_perf_counter_field *perf_field;
-	struct lttng_perf_counter_thread_field *perf_thread_field;
-
-	perf_field = field->u.perf_counter;
-	perf_thread_field = get_thread_field(perf_field);
-	return arch_read_perf_counter(perf_thread_field);
+	return add_thread_field(group, perf_thread, 0);
 }
 
+/*
+ * The leader field reads the whole group. Other fields reuse the values
+ * of that sweep when recorded within the same event, which is
+ * identified by its timestamp.
+ */
 static
 void perf_counter_record(struct lttng_ctx_field *field,
 		 struct lttng_ust_lib_ring_buffer_ctx *ctx,
 		 struct lttng_channel *chan)
 {
-	uint64_t value;
+	struct lttng_perf_counter_field *perf_field = field->u.perf_counter;
+	struct lttng_perf_counter_thread_field *thread_field;
+	uint64_t value = 0;
 
-	value = wrapper_perf_counter_read(field);
+	thread_field = get_thread_field(perf_field->group);
+	if (perf_field->index == 0 || thread_field->sweep_tsc != ctx->tsc) {
+		arch_read_perf_counters(thread_field, thread_field->values);
+		thread_field->sweep_tsc = ctx->tsc;
+	}
+	if (caa_likely(perf_field->index < thread_field->nr_counters))
+		value = thread_field->values[perf_field->index];
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(value));
 	chan->ops->event_write(ctx, &value, sizeof(value));
 }
@@ -460,7 +722,16 @@ static
 void perf_counter_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = wrapper_perf_counter_read(field);
+	struct lttng_perf_counter_field *perf_field = field->u.perf_counter;
+	struct lttng_perf_counter_thread_field *thread_field;
+	uint64_t values[LTTNG_PERF_COUNTER_GROUP_MAX];
+
+	thread_field = get_thread_field(perf_field->group);
+	value->u.s64 = 0;
+	if (caa_unlikely(perf_field->index >= thread_field->nr_counters))
+		return;
+	arch_read_perf_counters(thread_field, values);
+	value->u.s64 = values[perf_field->index];
 }
 
 /* Called with perf lock held */
@@ -468,36 +739,46 @@ static
 void lttng_destroy_perf_thread_field(
 		struct lttng_perf_counter_thread_field *thread_field)
 {
-	close_perf_fd(thread_field->fd);
-	unmap_perf_page(thread_field->pc);
 	cds_list_del_rcu(&thread_field->rcu_field_node);
 	cds_list_del(&thread_field->thread_field_node);
-	free(thread_field);
+	release_thread_field(thread_field);
 }
 
+/* Called with perf lock held */
 static
-void lttng_destroy_perf_thread_key(void *_key)
+void destroy_perf_thread(struct lttng_perf_counter_thread *perf_thread)
 {
-	struct lttng_perf_counter_thread *perf_thread = _key;
 	struct lttng_perf_counter_thread_field *pos, *p;
 
-	lttng_perf_lock();
 	cds_list_for_each_entry_safe(pos, p, &perf_thread->rcu_field_list,
 			rcu_field_node)
 		lttng_destroy_perf_thread_field(pos);
-	lttng_perf_unlock();
+	cds_list_del(&perf_thread->thread_node);
 	free(perf_thread);
 }
 
+/*
+ * The exiting thread is the only reader of its own field list, so its
+ * thread fields can be freed right away.
+ */
+static
+void lttng_destroy_perf_thread_key(void *_key)
+{
+	struct lttng_perf_counter_thread *perf_thread = _key;
+
+	lttng_perf_lock();
+	destroy_perf_thread(perf_thread);
+	lttng_perf_unlock();
+}
+
 /* Called with UST lock held */
 static
-void lttng_destroy_perf_counter_field(struct lttng_ctx_field *field)
+void put_perf_counter_group(struct lttng_perf_counter_group *group)
 {
-	struct lttng_perf_counter_field *perf_field;
 	struct lttng_perf_counter_thread_field *pos, *p;
 
-	free((char *) field->event_field.name);
-	perf_field = field->u.perf_counter;
+	if (--group->refcount)
+		return;
 	/*
 	 * This put is performed when no threads can concurrently
 	 * perform a "get" concurrently, thanks to urcu-bp grace
@@ -506,10 +787,22 @@ void lttng_destroy_perf_counter_field(struct lttng_ctx_field *field)
 	 * list.
 	 */
 	lttng_perf_lock();
-	cds_list_for_each_entry_safe(pos, p, &perf_field->thread_field_list,
+	cds_list_for_each_entry_safe(pos, p, &group->thread_field_list,
 			thread_field_node)
 		lttng_destroy_perf_thread_field(pos);
 	lttng_perf_unlock();
+	free(group);
+}
+
+/* Called with UST lock held */
+static
+void lttng_destroy_perf_counter_field(struct lttng_ctx_field *field)
+{
+	struct lttng_perf_counter_field *perf_field;
+
+	free((char *) field->event_field.name);
+	perf_field = field->u.perf_counter;
+	put_perf_counter_group(perf_field->group);
 	free(perf_field);
 }
 
@@ -531,6 +824,49 @@ int perf_get_exclude_kernel(void)
 
 #endif /* __ARM_ARCH_7A__ */
 
+/*
+ * Return the group of the last perf counter field of the context, if
+ * any.
+ */
+static
+struct lttng_perf_counter_group *find_perf_counter_group(struct lttng_ctx *ctx)
+{
+	unsigned int i;
+
+	for (i = ctx->nr_fields; i > 0; i--) {
+		struct lttng_ctx_field *field = &ctx->fields[i - 1];
+
+		if (field->destroy == lttng_destroy_perf_counter_field)
+			return field->u.perf_counter->group;
+	}
+	return NULL;
+}
+
+/*
+ * Check that the counters of @group, followed by @attr, can be opened
+ * together as a single perf event group in this process. The PMU may
+ * not be able to schedule that many counters at once.
+ */
+static
+bool perf_counter_group_can_add(struct lttng_perf_counter_group *group,
+		struct perf_event_attr *attr)
+{
+	int fds[LTTNG_PERF_COUNTER_GROUP_MAX];
+	unsigned int i, nr = group->nr_counters;
+	bool ret = true;
+
+	if (nr >= LTTNG_PERF_COUNTER_GROUP_MAX)
+		return false;
+	group->attr[nr] = *attr;
+	open_perf_group_fds(group->attr, nr + 1, 0, fds);
+	for (i = 0; i < nr + 1; i++) {
+		if (fds[i] < 0)
+			ret = false;
+		close_perf_fd(fds[i]);
+	}
+	return ret;
+}
+
 /* Called with UST lock held */
 int lttng_add_perf_counter_to_ctx(uint32_t type,
 				uint64_t config,
@@ -539,6 +875,8 @@ int lttng_add_perf_counter_to_ctx(uint32_t type,
 {
 	struct lttng_ctx_field *field;
 	struct lttng_perf_counter_field *perf_field;
+	struct lttng_perf_counter_group *group;
+	struct perf_event_attr attr;
 	char *name_alloc;
 	int ret;
 
@@ -562,8 +900,6 @@ int lttng_add_perf_counter_to_ctx(uint32_t type,
 		goto find_error;
 	}
 
-	field->destroy = lttng_destroy_perf_counter_field;
-
 	field->event_field.name = name_alloc;
 	field->event_field.type.atype = atype_integer;
 	field->event_field.type.u.basic.integer.size =
@@ -579,20 +915,46 @@ int lttng_add_perf_counter_to_ctx(uint32_t type,
 	field->record = perf_counter_record;
 	field->get_value = perf_counter_get_value;
 
-	perf_field->attr.type = type;
-	perf_field->attr.config = config;
-	perf_field->attr.exclude_kernel = perf_get_exclude_kernel();
-	CDS_INIT_LIST_HEAD(&perf_field->thread_field_list);
-	field->u.perf_counter = perf_field;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = perf_get_exclude_kernel();
+	attr.read_format = PERF_FORMAT_GROUP;
 
 	/* Ensure that this perf counter can be used in this process. */
-	ret = open_perf_fd(&perf_field->attr);
+	ret = open_perf_fd(&attr, 0, -1);
 	if (ret < 0) {
 		ret = -ENODEV;
 		goto setup_error;
 	}
 	close_perf_fd(ret);
 
+	/*
+	 * Join the group of the previous perf counter of this context
+	 * if the counters can be scheduled together, else lead a new
+	 * group.
+	 */
+	group = find_perf_counter_group(*ctx);
+	if (group && perf_counter_group_can_add(group, &attr)) {
+		perf_field->index = group->nr_counters;
+		group->attr[group->nr_counters++] = attr;
+		group->refcount++;
+	} else {
+		group = zmalloc(sizeof(*group));
+		if (!group) {
+			ret = -ENOMEM;
+			goto setup_error;
+		}
+		group->refcount = 1;
+		group->attr[0] = attr;
+		group->nr_counters = 1;
+		CDS_INIT_LIST_HEAD(&group->thread_field_list);
+		perf_field->index = 0;
+	}
+	perf_field->group = group;
+	field->u.perf_counter = perf_field;
+	field->destroy = lttng_destroy_perf_counter_field;
+
 	/*
 	 * Contexts can only be added before tracing is started, so we
 	 * don't have to synchronize against concurrent threads using
@@ -613,10 +975,92 @@ name_alloc_error:
 	return ret;
 }
 
+/*
+ * Prewarm the perf counter fields of @ctx for all the threads of the
+ * process, so that their first event does not open and map the
+ * counters. This is done synchronously while the session starts, and
+ * only covers the threads existing at that time: threads created
+ * afterwards still set up their fields on their first event.
+ * Prewarmed threads which exited without recording any event are
+ * forgotten.
+ *
+ * The perf lock is held from the lookup of each thread until its fields
+ * are added, so an adopting thread cannot exit and free it meanwhile.
+ *
+ * Called with UST lock held.
+ */
+void lttng_perf_counter_prewarm(struct lttng_ctx *ctx)
+{
+	struct lttng_perf_counter_thread *perf_thread, *tmp;
+	struct dirent *entry;
+	unsigned int i;
+	DIR *dir;
+
+	if (!perf_prewarm || !ctx || !find_perf_counter_group(ctx))
+		return;
+	dir = opendir("/proc/self/task");
+	if (!dir) {
+		PERROR("opendir /proc/self/task");
+		return;
+	}
+
+	lttng_perf_lock();
+	cds_list_for_each_entry(perf_thread, &perf_thread_list, thread_node)
+		perf_thread->stale = !perf_thread->adopted;
+	lttng_perf_unlock();
+
+	while ((entry = readdir(dir)) != NULL) {
+		uint64_t start_time;
+		char *end;
+		long tid;
+
+		tid = strtol(entry->d_name, &end, 10);
+		if (*end != '\0' || tid <= 0)
+			continue;
+		if (get_thread_start_time(tid, &start_time))
+			continue;	/* Exited meanwhile. */
+
+		lttng_perf_lock();
+		perf_thread = find_perf_thread(tid);
+		if (perf_thread && !perf_thread->adopted
+				&& perf_thread->start_time != start_time) {
+			/* Prewarmed for an exited thread with the same ID. */
+			destroy_perf_thread(perf_thread);
+			perf_thread = NULL;
+		}
+		if (!perf_thread)
+			perf_thread = create_perf_thread(tid, start_time);
+		perf_thread->stale = false;
+
+		for (i = 0; i < ctx->nr_fields; i++) {
+			struct lttng_ctx_field *field = &ctx->fields[i];
+
+			if (field->destroy != lttng_destroy_perf_counter_field
+					|| field->u.perf_counter->index != 0)
+				continue;
+			(void) add_thread_field(field->u.perf_counter->group,
+					perf_thread, tid);
+		}
+		lttng_perf_unlock();
+	}
+	closedir(dir);
+
+	lttng_perf_lock();
+	cds_list_for_each_entry_safe(perf_thread, tmp, &perf_thread_list,
+			thread_node) {
+		if (perf_thread->stale && !perf_thread->adopted)
+			destroy_perf_thread(perf_thread);
+	}
+	lttng_perf_unlock();
+}
+
 int lttng_perf_counter_init(void)
 {
 	int ret;
 
+	if (lttng_getenv("LTTNG_UST_PERF_PREWARM"))
+		perf_prewarm = true;
+
 	ret = pthread_key_create(&perf_counter_key,
 			lttng_destroy_perf_thread_key);
 	if (ret)
@@ -626,6 +1070,7 @@ int lttng_perf_counter_init(void)
 
 void lttng_perf_counter_exit(void)
 {
+	struct lttng_perf_counter_thread *perf_thread, *tmp;
 	int ret;
 
 	ret = pthread_key_delete(perf_counter_key);
@@ -633,4 +1078,12 @@ void lttng_perf_counter_exit(void)
 		errno = ret;
 		PERROR("Error in pthread_key_delete");
 	}
+
+	lttng_perf_lock();
+	cds_list_for_each_entry_safe(perf_thread, tmp, &perf_thread_list,
+			thread_node) {
+		if (!perf_thread->adopted)
+			destroy_perf_thread(perf_thread);
+	}
+	lttng_perf_unlock();
 }
@@ -21,12 +21,25 @@
  */
 
 #define _LGPL_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
 #include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
 #include <assert.h>
 #include "compat.h"
+#include "lttng-tracer-core.h"
+
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "lttng-ust-procname-provider.h"
 
 /* Maximum number of nesting levels for the procname cache. */
 #define PROCNAME_NESTING_MAX	2
@@ -46,6 +59,33 @@ static DEFINE_URCU_TLS(procname_array, cached_procname);
 
 static DEFINE_URCU_TLS(int, procname_nesting);
 
+/*
+ * The procname_id context records a compact ID instead of the name.
+ * IDs are allocated in a process-wide table the first time a thread
+ * uses a name which is not in it yet. The lttng_ust:procname_map events
+ * giving the name of each ID are emitted by the procname statedump,
+ * which first interns the names of all the threads of the process, and
+ * never from the event recording path. ID 0 means the table is full.
+ */
+#define PROCNAME_ID_MAX		1024
+#define PROCNAME_ID_CACHED	(1U << 16)
+
+struct procname_entry {
+	char name[LTTNG_UST_PROCNAME_LEN];
+	int valid;
+};
+
+static struct procname_entry procname_table[PROCNAME_ID_MAX];
+static unsigned long procname_next_id;
+
+/*
+ * Per nesting level, the ID of the cached procname ORed with
+ * PROCNAME_ID_CACHED, or 0 if not looked up yet.
+ */
+typedef unsigned int procname_id_array[PROCNAME_NESTING_MAX];
+
+static DEFINE_URCU_TLS(procname_id_array, cached_procname_id);
+
 static inline
 char *wrapper_getprocname(void)
 {
@@ -66,15 +106,147 @@ char *wrapper_getprocname(void)
 	return URCU_TLS(cached_procname)[nesting];
 }
 
+/*
+ * Find the ID of @name, or allocate a new one. Lock-free: two threads
+ * racing to intern the same name may get distinct IDs, which both map
+ * to it.
+ */
+static
+uint16_t procname_intern(const char *name)
+{
+	unsigned long nr, id;
+
+	nr = min_t(unsigned long, CMM_LOAD_SHARED(procname_next_id),
+			PROCNAME_ID_MAX - 1);
+	for (id = 1; id <= nr; id++) {
+		struct procname_entry *entry = &procname_table[id];
+
+		if (!CMM_LOAD_SHARED(entry->valid))
+			continue;
+		cmm_smp_rmb();
+		if (!strncmp(entry->name, name, LTTNG_UST_PROCNAME_LEN))
+			return id;
+	}
+	id = uatomic_add_return(&procname_next_id, 1);
+	if (id >= PROCNAME_ID_MAX)
+		return 0;
+	strncpy(procname_table[id].name, name, LTTNG_UST_PROCNAME_LEN - 1);
+	/* Publish the name before the entry. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(procname_table[id].valid, 1);
+	return id;
+}
+
+static
+uint16_t wrapper_getprocname_id(void)
+{
+	int nesting = CMM_LOAD_SHARED(URCU_TLS(procname_nesting));
+	unsigned int cached;
+	char *procname;
+	uint16_t id;
+
+	if (caa_unlikely(nesting >= PROCNAME_NESTING_MAX))
+		return 0;
+	cached = URCU_TLS(cached_procname_id)[nesting];
+	if (caa_likely(cached))
+		return (uint16_t) cached;
+	procname = wrapper_getprocname();
+	CMM_STORE_SHARED(URCU_TLS(procname_nesting), nesting + 1);
+	/* Increment nesting before updating cache. */
+	cmm_barrier();
+	id = procname_intern(procname);
+	URCU_TLS(cached_procname_id)[nesting] = id | PROCNAME_ID_CACHED;
+	/* Decrement nesting after updating cache. */
+	cmm_barrier();
+	CMM_STORE_SHARED(URCU_TLS(procname_nesting), nesting);
+	return id;
+}
+
 /* Reset should not be called from a signal handler. */
 void lttng_context_procname_reset(void)
 {
 	CMM_STORE_SHARED(URCU_TLS(cached_procname)[1][0], '\0');
+	CMM_STORE_SHARED(URCU_TLS(cached_procname_id)[1], 0);
 	CMM_STORE_SHARED(URCU_TLS(procname_nesting), 1);
 	CMM_STORE_SHARED(URCU_TLS(cached_procname)[0][0], '\0');
+	CMM_STORE_SHARED(URCU_TLS(cached_procname_id)[0], 0);
 	CMM_STORE_SHARED(URCU_TLS(procname_nesting), 0);
 }
 
+/*
+ * The child process starts with an empty table: the IDs allocated by
+ * the parent are never defined in the traces of the child. Only the
+ * thread calling fork() exists in the child.
+ */
+void lttng_context_procname_after_fork_child(void)
+{
+	memset(procname_table, 0, sizeof(procname_table));
+	CMM_STORE_SHARED(procname_next_id, 0);
+}
+
+/*
+ * Intern the current names of all the threads of the process, so that
+ * the IDs they record are mapped by this statedump even if they did not
+ * record any event yet.
+ */
+static
+void procname_intern_threads(void)
+{
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		return;
+	while ((entry = readdir(dir)) != NULL) {
+		char path[64], name[LTTNG_UST_PROCNAME_LEN], *end;
+		ssize_t len;
+		long tid;
+		int fd;
+
+		tid = strtol(entry->d_name, &end, 10);
+		if (*end != '\0' || tid <= 0)
+			continue;
+		snprintf(path, sizeof(path), "/proc/self/task/%ld/comm", tid);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			continue;	/* Exited meanwhile. */
+		do {
+			len = read(fd, name, sizeof(name) - 1);
+		} while (len < 0 && errno == EINTR);
+		(void) close(fd);
+		if (len <= 0)
+			continue;
+		name[len] = '\0';
+		name[strcspn(name, "\n")] = '\0';
+		(void) procname_intern(name);
+	}
+	closedir(dir);
+}
+
+/*
+ * Emit the mapping of all the allocated IDs, after interning the names
+ * of the existing threads. Names first used by a thread after this
+ * statedump are mapped by the next one. Called by the statedump, with
+ * ust lock held.
+ */
+void lttng_context_procname_statedump(void)
+{
+	unsigned long nr, id;
+
+	procname_intern_threads();
+	nr = min_t(unsigned long, CMM_LOAD_SHARED(procname_next_id),
+			PROCNAME_ID_MAX - 1);
+	for (id = 1; id <= nr; id++) {
+		struct procname_entry *entry = &procname_table[id];
+
+		if (!CMM_LOAD_SHARED(entry->valid))
+			continue;
+		cmm_smp_rmb();
+		tracepoint(lttng_ust, procname_map, id, entry->name);
+	}
+}
+
 static
 size_t procname_get_size(struct lttng_ctx_field *field, size_t offset)
 {
@@ -127,10 +299,66 @@ int lttng_add_procname_to_ctx(struct lttng_ctx **ctx)
 	return 0;
 }
 
+static
+size_t procname_id_get_size(struct lttng_ctx_field *field, size_t offset)
+{
+	size_t size = 0;
+
+	size += lib_ring_buffer_align(offset, lttng_alignof(uint16_t));
+	size += sizeof(uint16_t);
+	return size;
+}
+
+static
+void procname_id_record(struct lttng_ctx_field *field,
+		 struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		 struct lttng_channel *chan)
+{
+	uint16_t id;
+
+	id = wrapper_getprocname_id();
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(id));
+	chan->ops->event_write(ctx, &id, sizeof(id));
+}
+
+static
+void procname_id_get_value(struct lttng_ctx_field *field,
+		struct lttng_ctx_value *value)
+{
+	value->u.s64 = wrapper_getprocname_id();
+}
+
+int lttng_add_procname_id_to_ctx(struct lttng_ctx **ctx)
+{
+	struct lttng_ctx_field *field;
+
+	field = lttng_append_context(ctx);
+	if (!field)
+		return -ENOMEM;
+	if (lttng_find_context(*ctx, "procname_id")) {
+		lttng_remove_context_field(ctx, field);
+		return -EEXIST;
+	}
+	field->event_field.name = "procname_id";
+	field->event_field.type.atype = atype_integer;
+	field->event_field.type.u.basic.integer.size = sizeof(uint16_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.alignment = lttng_alignof(uint16_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.signedness = lttng_is_signed_type(uint16_t);
+	field->event_field.type.u.basic.integer.reverse_byte_order = 0;
+	field->event_field.type.u.basic.integer.base = 10;
+	field->event_field.type.u.basic.integer.encoding = lttng_encode_none;
+	field->get_size = procname_id_get_size;
+	field->record = procname_id_record;
+	field->get_value = procname_id_get_value;
+	lttng_context_update(*ctx);
+	return 0;
+}
+
 /*
  * Force a read (imply TLS fixup for dlopen) of TLS variables.
  */
 void lttng_fixup_procname_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(cached_procname)[0]));
+	asm volatile ("" : : "m" (URCU_TLS(cached_procname_id)[0]));
 }
@@ -23,7 +23,12 @@
 #define _LGPL_SOURCE
 #include <sys/types.h>
 #include <unistd.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#include <urcu/list.h>
 #include <lttng/ust-context-provider.h>
+#include <lttng/ringbuffer-config.h>
 #include "lttng-tracer-core.h"
 #include "jhash.h"
 #include <helper.h>
@@ -36,6 +41,297 @@ struct context_provider_ht {
 
 static struct context_provider_ht context_provider_ht;
 
+/*
+ * Providers registered with a static type. Protected by ust lock. The
+ * static type fields are only read for these providers, since
+ * providers registered by applications built against older headers
+ * don't have them.
+ */
+struct typed_provider {
+	struct cds_list_head node;
+	struct lttng_ust_context_provider *provider;
+};
+
+static CDS_LIST_HEAD(typed_providers);
+
+static const struct lttng_type static_types[_NR_LTTNG_UST_DYNAMIC_TYPES] = {
+	[LTTNG_UST_DYNAMIC_TYPE_S8] = __type_integer(int8_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_S16] = __type_integer(int16_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_S32] = __type_integer(int32_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_S64] = __type_integer(int64_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_U8] = __type_integer(uint8_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_U16] = __type_integer(uint16_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_U32] = __type_integer(uint32_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_U64] = __type_integer(uint64_t, BYTE_ORDER, 10, none),
+	[LTTNG_UST_DYNAMIC_TYPE_FLOAT] = __type_float(float),
+	[LTTNG_UST_DYNAMIC_TYPE_DOUBLE] = __type_float(double),
+};
+
+static
+struct typed_provider *lookup_typed_provider(
+		struct lttng_ust_context_provider *provider)
+{
+	struct typed_provider *typed;
+
+	cds_list_for_each_entry(typed, &typed_providers, node) {
+		if (typed->provider == provider)
+			return typed;
+	}
+	return NULL;
+}
+
+static
+void provider_static_type(const struct lttng_ust_context_provider *provider,
+		struct lttng_type *type)
+{
+	struct lttng_basic_type *elem_type;
+
+	if (provider->static_type != LTTNG_UST_DYNAMIC_TYPE_STRING) {
+		*type = static_types[provider->static_type];
+		return;
+	}
+	memset(type, 0, sizeof(*type));
+	type->atype = atype_array;
+	elem_type = &type->u.array.elem_type;
+	elem_type->atype = atype_integer;
+	elem_type->u.basic.integer.size = sizeof(char) * CHAR_BIT;
+	elem_type->u.basic.integer.alignment = lttng_alignof(char) * CHAR_BIT;
+	elem_type->u.basic.integer.signedness = lttng_is_signed_type(char);
+	elem_type->u.basic.integer.reverse_byte_order = 0;
+	elem_type->u.basic.integer.base = 10;
+	elem_type->u.basic.integer.encoding = lttng_encode_UTF8;
+	type->u.array.length = provider->static_string_len;
+}
+
+static
+bool static_type_match(const struct lttng_type *a, const struct lttng_type *b)
+{
+	if (a->atype != b->atype)
+		return false;
+	switch (a->atype) {
+	case atype_integer:
+		return a->u.basic.integer.size == b->u.basic.integer.size
+			&& a->u.basic.integer.signedness
+				== b->u.basic.integer.signedness;
+	case atype_float:
+		return a->u.basic._float.mant_dig == b->u.basic._float.mant_dig;
+	case atype_array:
+		return a->u.array.length == b->u.array.length;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Convert the value returned by the provider to the static type of the
+ * context, so the filter sees the value which is recorded.
+ */
+static
+void static_type_get_value(struct lttng_ctx_field *field,
+		struct lttng_ctx_value *value)
+{
+	struct lttng_ust_context_provider *provider = field->u.app_provider;
+	const struct lttng_type *type = &field->event_field.type;
+	struct lttng_ctx_value v;
+
+	v.sel = LTTNG_UST_DYNAMIC_TYPE_NONE;
+	if (provider)
+		provider->get_value(field, &v);
+	switch (type->atype) {
+	case atype_integer:
+	{
+		unsigned int size = type->u.basic.integer.size;
+		int64_t s64;
+
+		switch (v.sel) {
+		case LTTNG_UST_DYNAMIC_TYPE_S8:
+		case LTTNG_UST_DYNAMIC_TYPE_S16:
+		case LTTNG_UST_DYNAMIC_TYPE_S32:
+		case LTTNG_UST_DYNAMIC_TYPE_S64:
+		case LTTNG_UST_DYNAMIC_TYPE_U8:
+		case LTTNG_UST_DYNAMIC_TYPE_U16:
+		case LTTNG_UST_DYNAMIC_TYPE_U32:
+		case LTTNG_UST_DYNAMIC_TYPE_U64:
+			s64 = v.u.s64;
+			break;
+		case LTTNG_UST_DYNAMIC_TYPE_FLOAT:
+		case LTTNG_UST_DYNAMIC_TYPE_DOUBLE:
+			s64 = (int64_t) v.u.d;
+			break;
+		default:
+			s64 = 0;
+			break;
+		}
+		if (size < 64) {
+			if (type->u.basic.integer.signedness)
+				s64 = (int64_t) ((uint64_t) s64 << (64 - size))
+					>> (64 - size);
+			else
+				s64 = (int64_t) ((uint64_t) s64
+					& ((1ULL << size) - 1));
+		}
+		value->sel = LTTNG_UST_DYNAMIC_TYPE_S64;
+		value->u.s64 = s64;
+		break;
+	}
+	case atype_float:
+		value->sel = LTTNG_UST_DYNAMIC_TYPE_DOUBLE;
+		switch (v.sel) {
+		case LTTNG_UST_DYNAMIC_TYPE_U64:
+			value->u.d = (double) (uint64_t) v.u.s64;
+			break;
+		case LTTNG_UST_DYNAMIC_TYPE_S8:
+		case LTTNG_UST_DYNAMIC_TYPE_S16:
+		case LTTNG_UST_DYNAMIC_TYPE_S32:
+		case LTTNG_UST_DYNAMIC_TYPE_S64:
+		case LTTNG_UST_DYNAMIC_TYPE_U8:
+		case LTTNG_UST_DYNAMIC_TYPE_U16:
+		case LTTNG_UST_DYNAMIC_TYPE_U32:
+			value->u.d = (double) v.u.s64;
+			break;
+		case LTTNG_UST_DYNAMIC_TYPE_FLOAT:
+		case LTTNG_UST_DYNAMIC_TYPE_DOUBLE:
+			value->u.d = v.u.d;
+			break;
+		default:
+			value->u.d = 0.0;
+			break;
+		}
+		break;
+	case atype_array:
+		value->sel = LTTNG_UST_DYNAMIC_TYPE_STRING;
+		if (v.sel == LTTNG_UST_DYNAMIC_TYPE_STRING && v.u.str)
+			value->u.str = v.u.str;
+		else
+			value->u.str = "";
+		break;
+	default:
+		value->sel = LTTNG_UST_DYNAMIC_TYPE_NONE;
+		break;
+	}
+}
+
+static
+size_t static_type_get_size(struct lttng_ctx_field *field, size_t offset)
+{
+	const struct lttng_type *type = &field->event_field.type;
+	size_t size = 0, len, align;
+
+	switch (type->atype) {
+	case atype_integer:
+		len = type->u.basic.integer.size / CHAR_BIT;
+		align = type->u.basic.integer.alignment / CHAR_BIT;
+		break;
+	case atype_float:
+		if (type->u.basic._float.mant_dig == _float_mant_dig(float)) {
+			len = sizeof(float);
+			align = lttng_alignof(float);
+		} else {
+			len = sizeof(double);
+			align = lttng_alignof(double);
+		}
+		break;
+	case atype_array:
+		return type->u.array.length;
+	default:
+		return 0;
+	}
+	size += lib_ring_buffer_align(offset, align);
+	size += len;
+	return size;
+}
+
+static
+void static_type_record(struct lttng_ctx_field *field,
+		struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	const struct lttng_type *type = &field->event_field.type;
+	struct lttng_ctx_value v;
+
+	static_type_get_value(field, &v);
+	switch (type->atype) {
+	case atype_integer:
+		switch (type->u.basic.integer.size) {
+		case 8:
+		{
+			int8_t tmp = v.u.s64;
+
+			lib_ring_buffer_align_ctx(ctx, lttng_alignof(tmp));
+			chan->ops->event_write(ctx, &tmp, sizeof(tmp));
+			break;
+		}
+		case 16:
+		{
+			int16_t tmp = v.u.s64;
+
+			lib_ring_buffer_align_ctx(ctx, lttng_alignof(tmp));
+			chan->ops->event_write(ctx, &tmp, sizeof(tmp));
+			break;
+		}
+		case 32:
+		{
+			int32_t tmp = v.u.s64;
+
+			lib_ring_buffer_align_ctx(ctx, lttng_alignof(tmp));
+			chan->ops->event_write(ctx, &tmp, sizeof(tmp));
+			break;
+		}
+		case 64:
+		{
+			int64_t tmp = v.u.s64;
+
+			lib_ring_buffer_align_ctx(ctx, lttng_alignof(tmp));
+			chan->ops->event_write(ctx, &tmp, sizeof(tmp));
+			break;
+		}
+		}
+		break;
+	case atype_float:
+		if (type->u.basic._float.mant_dig == _float_mant_dig(float)) {
+			float tmp = v.u.d;
+
+			lib_ring_buffer_align_ctx(ctx, lttng_alignof(tmp));
+			chan->ops->event_write(ctx, &tmp, sizeof(tmp));
+		} else {
+			double tmp = v.u.d;
+
+			lib_ring_buffer_align_ctx(ctx, lttng_alignof(tmp));
+			chan->ops->event_write(ctx, &tmp, sizeof(tmp));
+		}
+		break;
+	case atype_array:
+		chan->ops->event_strcpy(ctx, v.u.str, type->u.array.length);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Called with ust lock held, on a copy of the context fields. A context
+ * of static type keeps recording zeroes until a provider of the same
+ * type is registered.
+ */
+void lttng_ust_context_provider_set_typed_field(struct lttng_ctx_field *field,
+		struct lttng_ust_context_provider *provider)
+{
+	struct lttng_type type;
+
+	if (provider) {
+		provider_static_type(provider, &type);
+		if (!static_type_match(&type, &field->event_field.type)) {
+			DBG("Type of application context provider \"%s\" differs from the type of context \"%s\"",
+				provider->name, field->event_field.name);
+			provider = NULL;
+		}
+	}
+	field->u.app_provider = provider;
+	field->get_size = static_type_get_size;
+	field->record = static_type_record;
+	field->get_value = static_type_get_value;
+}
+
 static struct lttng_ust_context_provider *
 		lookup_provider_by_name(const char *name)
 {
@@ -61,10 +357,13 @@ static struct lttng_ust_context_provider *
 	return NULL;
 }
 
-int lttng_ust_context_provider_register(struct lttng_ust_context_provider *provider)
+static
+int context_provider_register(struct lttng_ust_context_provider *provider,
+		bool typed)
 {
 	struct cds_hlist_head *head;
 	size_t name_len = strlen(provider->name);
+	struct typed_provider *typed_node = NULL;
 	uint32_t hash;
 	int ret = 0;
 
@@ -76,6 +375,32 @@ int lttng_ust_context_provider_register(struct lttng_ust_context_provider *provi
 	/* Provider name cannot contain a column character. */
 	if (strchr(provider->name, ':'))
 		return -EINVAL;
+	if (typed) {
+		switch (provider->static_type) {
+		case LTTNG_UST_DYNAMIC_TYPE_S8:
+		case LTTNG_UST_DYNAMIC_TYPE_S16:
+		case LTTNG_UST_DYNAMIC_TYPE_S32:
+		case LTTNG_UST_DYNAMIC_TYPE_S64:
+		case LTTNG_UST_DYNAMIC_TYPE_U8:
+		case LTTNG_UST_DYNAMIC_TYPE_U16:
+		case LTTNG_UST_DYNAMIC_TYPE_U32:
+		case LTTNG_UST_DYNAMIC_TYPE_U64:
+		case LTTNG_UST_DYNAMIC_TYPE_FLOAT:
+		case LTTNG_UST_DYNAMIC_TYPE_DOUBLE:
+			break;
+		case LTTNG_UST_DYNAMIC_TYPE_STRING:
+			if (!provider->static_string_len
+					|| provider->static_string_len > UINT_MAX)
+				return -EINVAL;
+			break;
+		default:
+			return -EINVAL;
+		}
+		typed_node = zmalloc(sizeof(*typed_node));
+		if (!typed_node)
+			return -ENOMEM;
+		typed_node->provider = provider;
+	}
 	if (ust_lock()) {
 		ret = -EBUSY;
 		goto end;
@@ -87,24 +412,51 @@ int lttng_ust_context_provider_register(struct lttng_ust_context_provider *provi
 	hash = jhash(provider->name, name_len, 0);
 	head = &context_provider_ht.table[hash & (CONTEXT_PROVIDER_HT_SIZE - 1)];
 	cds_hlist_add_head(&provider->node, head);
-	lttng_ust_context_set_session_provider(provider->name,
+	if (typed_node) {
+		cds_list_add(&typed_node->node, &typed_providers);
+		typed_node = NULL;
+	}
+	lttng_ust_context_set_session_app_provider(provider->name,
 		provider->get_size, provider->record,
-		provider->get_value);
+		provider->get_value, typed ? provider : NULL);
 end:
 	ust_unlock();
+	free(typed_node);
 	return ret;
 }
 
+int lttng_ust_context_provider_register(struct lttng_ust_context_provider *provider)
+{
+	return context_provider_register(provider, false);
+}
+
+/*
+ * Contexts added while the provider is registered have its static type.
+ * Contexts added before keep the dynamic type, and are recorded with
+ * the get_size and record callbacks, which are therefore still needed.
+ */
+int lttng_ust_context_provider_register_typed(struct lttng_ust_context_provider *provider)
+{
+	return context_provider_register(provider, true);
+}
+
 void lttng_ust_context_provider_unregister(struct lttng_ust_context_provider *provider)
 {
+	struct typed_provider *typed;
+
 	lttng_ust_fixup_tls();
 
 	if (ust_lock())
 		goto end;
-	lttng_ust_context_set_session_provider(provider->name,
+	lttng_ust_context_set_session_app_provider(provider->name,
 		lttng_ust_dummy_get_size, lttng_ust_dummy_record,
-		lttng_ust_dummy_get_value);
+		lttng_ust_dummy_get_value, NULL);
 	cds_hlist_del(&provider->node);
+	typed = lookup_typed_provider(provider);
+	if (typed) {
+		cds_list_del(&typed->node);
+		free(typed);
+	}
 end:
 	ust_unlock();
 }
@@ -141,7 +493,11 @@ int lttng_ust_add_app_context_to_ctx_rcu(const char *name,
 	 * it will provide a dummy context.
 	 */
 	provider = lookup_provider_by_name(name);
-	if (provider) {
+	if (provider && lookup_typed_provider(provider)) {
+		provider_static_type(provider, &new_field.event_field.type);
+		lttng_ust_context_provider_set_typed_field(&new_field,
+				provider);
+	} else if (provider) {
 		new_field.get_size = provider->get_size;
 		new_field.record = provider->record;
 		new_field.get_value = provider->get_value;
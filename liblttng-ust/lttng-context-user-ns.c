@@ -29,28 +29,28 @@
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
 
+#include "lttng-tracer-core.h"
 #include "ns.h"
 
 /*
  * We cache the result to ensure we don't stat(2) the proc filesystem on
  * each event. The user namespace is global to the process.
  */
-static ino_t cached_user_ns = NS_INO_UNINITIALIZED;
+static struct lttng_context_cache_slot cached_user_ns;
 
 static
-ino_t get_user_ns(void)
+ino_t get_user_ns(unsigned long gen)
 {
 	struct stat sb;
+	uint64_t cached;
 	ino_t user_ns;
 
-	user_ns = CMM_LOAD_SHARED(cached_user_ns);
-
 	/*
-	 * If the cache is populated, do nothing and return the
-	 * cached inode number.
+	 * If the cache is populated for the current generation, do
+	 * nothing and return the cached inode number.
 	 */
-	if (caa_likely(user_ns != NS_INO_UNINITIALIZED))
-		return user_ns;
+	if (caa_likely(lttng_context_cache_slot_get(&cached_user_ns, gen, &cached)))
+		return (ino_t) cached;
 
 	/*
 	 * At this point we have to populate the cache, set the initial
@@ -67,7 +67,7 @@ ino_t get_user_ns(void)
 	/*
 	 * And finally, store the inode number in the cache.
 	 */
-	CMM_STORE_SHARED(cached_user_ns, user_ns);
+	lttng_context_cache_slot_set(&cached_user_ns, gen, user_ns);
 
 	return user_ns;
 }
@@ -80,7 +80,7 @@ ino_t get_user_ns(void)
  */
 void lttng_context_user_ns_reset(void)
 {
-	CMM_STORE_SHARED(cached_user_ns, NS_INO_UNINITIALIZED);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -100,7 +100,7 @@ void user_ns_record(struct lttng_ctx_field *field,
 {
 	ino_t user_ns;
 
-	user_ns = get_user_ns();
+	user_ns = get_user_ns(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(user_ns));
 	chan->ops->event_write(ctx, &user_ns, sizeof(user_ns));
 }
@@ -109,7 +109,7 @@ static
 void user_ns_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_user_ns();
+	value->u.s64 = get_user_ns(lttng_context_cache_get_gen());
 }
 
 int lttng_add_user_ns_to_ctx(struct lttng_ctx **ctx)
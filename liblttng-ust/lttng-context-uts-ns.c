@@ -38,26 +38,21 @@
  * We cache the result to ensure we don't stat(2) the proc filesystem on
  * each event.
  */
-#ifdef CONFIG_RCU_TLS
-static DEFINE_URCU_TLS(ino_t, cached_uts_ns) = NS_INO_UNINITIALIZED;
-#else
-static DEFINE_URCU_TLS_INIT(ino_t, cached_uts_ns, NS_INO_UNINITIALIZED);
-#endif
+static DEFINE_URCU_TLS(ino_t, cached_uts_ns);
+static DEFINE_URCU_TLS(unsigned long, cached_uts_ns_gen);
 
 static
-ino_t get_uts_ns(void)
+ino_t get_uts_ns(unsigned long gen)
 {
 	struct stat sb;
 	ino_t uts_ns;
 
-	uts_ns = CMM_LOAD_SHARED(URCU_TLS(cached_uts_ns));
-
 	/*
-	 * If the cache is populated, do nothing and return the
-	 * cached inode number.
+	 * If the cache is populated for the current generation, do
+	 * nothing and return the cached inode number.
 	 */
-	if (caa_likely(uts_ns != NS_INO_UNINITIALIZED))
-		return uts_ns;
+	if (caa_likely(CMM_LOAD_SHARED(URCU_TLS(cached_uts_ns_gen)) == gen))
+		return CMM_LOAD_SHARED(URCU_TLS(cached_uts_ns));
 
 	/*
 	 * At this point we have to populate the cache, set the initial
@@ -89,6 +84,7 @@ ino_t get_uts_ns(void)
 	 * And finally, store the inode number in the cache.
 	 */
 	CMM_STORE_SHARED(URCU_TLS(cached_uts_ns), uts_ns);
+	CMM_STORE_SHARED(URCU_TLS(cached_uts_ns_gen), gen);
 
 	return uts_ns;
 }
@@ -101,7 +97,7 @@ ino_t get_uts_ns(void)
  */
 void lttng_context_uts_ns_reset(void)
 {
-	CMM_STORE_SHARED(URCU_TLS(cached_uts_ns), NS_INO_UNINITIALIZED);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -121,7 +117,7 @@ void uts_ns_record(struct lttng_ctx_field *field,
 {
 	ino_t uts_ns;
 
-	uts_ns = get_uts_ns();
+	uts_ns = get_uts_ns(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(uts_ns));
 	chan->ops->event_write(ctx, &uts_ns, sizeof(uts_ns));
 }
@@ -130,7 +126,7 @@ static
 void uts_ns_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_uts_ns();
+	value->u.s64 = get_uts_ns(lttng_context_cache_get_gen());
 }
 
 int lttng_add_uts_ns_to_ctx(struct lttng_ctx **ctx)
@@ -165,4 +161,5 @@ int lttng_add_uts_ns_to_ctx(struct lttng_ctx **ctx)
 void lttng_fixup_uts_ns_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(cached_uts_ns)));
+	asm volatile ("" : : "m" (URCU_TLS(cached_uts_ns_gen)));
 }
@@ -28,6 +28,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 #include "creds.h"
 
 
@@ -46,19 +47,18 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event. User / group IDs are global to the process.
  */
-static gid_t cached_vegid = INVALID_GID;
+static struct lttng_context_cache_slot cached_vegid;
 
 static
-gid_t get_vegid(void)
+gid_t get_vegid(unsigned long gen)
 {
+	uint64_t cached;
 	gid_t vegid;
 
-	vegid = CMM_LOAD_SHARED(cached_vegid);
-
-	if (caa_unlikely(vegid == INVALID_GID)) {
-		vegid = getegid();
-		CMM_STORE_SHARED(cached_vegid, vegid);
-	}
+	if (caa_likely(lttng_context_cache_slot_get(&cached_vegid, gen, &cached)))
+		return (gid_t) cached;
+	vegid = getegid();
+	lttng_context_cache_slot_set(&cached_vegid, gen, vegid);
 
 	return vegid;
 }
@@ -68,7 +68,7 @@ gid_t get_vegid(void)
  */
 void lttng_context_vegid_reset(void)
 {
-	CMM_STORE_SHARED(cached_vegid, INVALID_GID);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -88,7 +88,7 @@ void vegid_record(struct lttng_ctx_field *field,
 {
 	gid_t vegid;
 
-	vegid = get_vegid();
+	vegid = get_vegid(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(vegid));
 	chan->ops->event_write(ctx, &vegid, sizeof(vegid));
 }
@@ -97,7 +97,7 @@ static
 void vegid_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_vegid();
+	value->u.s64 = get_vegid(lttng_context_cache_get_gen());
 }
 
 int lttng_add_vegid_to_ctx(struct lttng_ctx **ctx)
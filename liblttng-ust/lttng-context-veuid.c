@@ -28,6 +28,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 #include "creds.h"
 
 
@@ -46,19 +47,18 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event. User / group IDs are global to the process.
  */
-static uid_t cached_veuid = INVALID_UID;
+static struct lttng_context_cache_slot cached_veuid;
 
 static
-uid_t get_veuid(void)
+uid_t get_veuid(unsigned long gen)
 {
+	uint64_t cached;
 	uid_t veuid;
 
-	veuid = CMM_LOAD_SHARED(cached_veuid);
-
-	if (caa_unlikely(veuid == INVALID_UID)) {
-		veuid = geteuid();
-		CMM_STORE_SHARED(cached_veuid, veuid);
-	}
+	if (caa_likely(lttng_context_cache_slot_get(&cached_veuid, gen, &cached)))
+		return (uid_t) cached;
+	veuid = geteuid();
+	lttng_context_cache_slot_set(&cached_veuid, gen, veuid);
 
 	return veuid;
 }
@@ -68,7 +68,7 @@ uid_t get_veuid(void)
  */
 void lttng_context_veuid_reset(void)
 {
-	CMM_STORE_SHARED(cached_veuid, INVALID_UID);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -88,7 +88,7 @@ void veuid_record(struct lttng_ctx_field *field,
 {
 	uid_t veuid;
 
-	veuid = get_veuid();
+	veuid = get_veuid(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(veuid));
 	chan->ops->event_write(ctx, &veuid, sizeof(veuid));
 }
@@ -97,7 +97,7 @@ static
 void veuid_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_veuid();
+	value->u.s64 = get_veuid(lttng_context_cache_get_gen());
 }
 
 int lttng_add_veuid_to_ctx(struct lttng_ctx **ctx)
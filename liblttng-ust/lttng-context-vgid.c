@@ -28,6 +28,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 #include "creds.h"
 
 
@@ -46,19 +47,18 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event. User / group IDs are global to the process.
  */
-static gid_t cached_vgid = INVALID_GID;
+static struct lttng_context_cache_slot cached_vgid;
 
 static
-gid_t get_vgid(void)
+gid_t get_vgid(unsigned long gen)
 {
+	uint64_t cached;
 	gid_t vgid;
 
-	vgid = CMM_LOAD_SHARED(cached_vgid);
-
-	if (caa_unlikely(cached_vgid == (gid_t) -1)) {
-		vgid = getgid();
-		CMM_STORE_SHARED(cached_vgid, vgid);
-	}
+	if (caa_likely(lttng_context_cache_slot_get(&cached_vgid, gen, &cached)))
+		return (gid_t) cached;
+	vgid = getgid();
+	lttng_context_cache_slot_set(&cached_vgid, gen, vgid);
 
 	return vgid;
 }
@@ -68,7 +68,7 @@ gid_t get_vgid(void)
  */
 void lttng_context_vgid_reset(void)
 {
-	CMM_STORE_SHARED(cached_vgid, INVALID_GID);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -88,7 +88,7 @@ void vgid_record(struct lttng_ctx_field *field,
 {
 	gid_t vgid;
 
-	vgid = get_vgid();
+	vgid = get_vgid(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(vgid));
 	chan->ops->event_write(ctx, &vgid, sizeof(vgid));
 }
@@ -97,7 +97,7 @@ static
 void vgid_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_vgid();
+	value->u.s64 = get_vgid(lttng_context_cache_get_gen());
 }
 
 int lttng_add_vgid_to_ctx(struct lttng_ctx **ctx)
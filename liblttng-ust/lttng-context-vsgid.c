@@ -29,6 +29,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 #include "creds.h"
 
 
@@ -47,22 +48,21 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event. User / group IDs are global to the process.
  */
-static gid_t cached_vsgid = INVALID_GID;
+static struct lttng_context_cache_slot cached_vsgid;
 
 static
-gid_t get_vsgid(void)
+gid_t get_vsgid(unsigned long gen)
 {
+	uint64_t cached;
 	gid_t vsgid;
-
-	vsgid = CMM_LOAD_SHARED(cached_vsgid);
-
-	if (caa_unlikely(vsgid == INVALID_GID)) {
-		gid_t gid, egid, sgid;
-
-		if (getresgid(&gid, &egid, &sgid) == 0) {
-			vsgid = sgid;
-			CMM_STORE_SHARED(cached_vsgid, vsgid);
-		}
+	gid_t gid, egid, sgid;
+
+	if (caa_likely(lttng_context_cache_slot_get(&cached_vsgid, gen, &cached)))
+		return (gid_t) cached;
+	vsgid = INVALID_GID;
+	if (getresgid(&gid, &egid, &sgid) == 0) {
+		vsgid = sgid;
+		lttng_context_cache_slot_set(&cached_vsgid, gen, vsgid);
 	}
 
 	return vsgid;
@@ -73,7 +73,7 @@ gid_t get_vsgid(void)
  */
 void lttng_context_vsgid_reset(void)
 {
-	CMM_STORE_SHARED(cached_vsgid, INVALID_GID);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -93,7 +93,7 @@ void vsgid_record(struct lttng_ctx_field *field,
 {
 	gid_t vsgid;
 
-	vsgid = get_vsgid();
+	vsgid = get_vsgid(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(vsgid));
 	chan->ops->event_write(ctx, &vsgid, sizeof(vsgid));
 }
@@ -102,7 +102,7 @@ static
 void vsgid_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_vsgid();
+	value->u.s64 = get_vsgid(lttng_context_cache_get_gen());
 }
 
 int lttng_add_vsgid_to_ctx(struct lttng_ctx **ctx)
@@ -29,6 +29,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 #include "creds.h"
 
 
@@ -47,22 +48,21 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event. User / group IDs are global to the process.
  */
-static uid_t cached_vsuid = INVALID_UID;
+static struct lttng_context_cache_slot cached_vsuid;
 
 static
-uid_t get_vsuid(void)
+uid_t get_vsuid(unsigned long gen)
 {
+	uint64_t cached;
 	uid_t vsuid;
-
-	vsuid = CMM_LOAD_SHARED(cached_vsuid);
-
-	if (caa_unlikely(vsuid == INVALID_UID)) {
-		uid_t uid, euid, suid;
-
-		if (getresuid(&uid, &euid, &suid) == 0) {
-			vsuid = suid;
-			CMM_STORE_SHARED(cached_vsuid, vsuid);
-		}
+	uid_t uid, euid, suid;
+
+	if (caa_likely(lttng_context_cache_slot_get(&cached_vsuid, gen, &cached)))
+		return (uid_t) cached;
+	vsuid = INVALID_UID;
+	if (getresuid(&uid, &euid, &suid) == 0) {
+		vsuid = suid;
+		lttng_context_cache_slot_set(&cached_vsuid, gen, vsuid);
 	}
 
 	return vsuid;
@@ -73,7 +73,7 @@ uid_t get_vsuid(void)
  */
 void lttng_context_vsuid_reset(void)
 {
-	CMM_STORE_SHARED(cached_vsuid, INVALID_UID);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -93,7 +93,7 @@ void vsuid_record(struct lttng_ctx_field *field,
 {
 	uid_t vsuid;
 
-	vsuid = get_vsuid();
+	vsuid = get_vsuid(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(vsuid));
 	chan->ops->event_write(ctx, &vsuid, sizeof(vsuid));
 }
@@ -102,7 +102,7 @@ static
 void vsuid_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_vsuid();
+	value->u.s64 = get_vsuid(lttng_context_cache_get_gen());
 }
 
 int lttng_add_vsuid_to_ctx(struct lttng_ctx **ctx)
@@ -28,6 +28,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 #include "creds.h"
 
 
@@ -46,19 +47,18 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event. User / group IDs are global to the process.
  */
-static uid_t cached_vuid = INVALID_UID;
+static struct lttng_context_cache_slot cached_vuid;
 
 static
-uid_t get_vuid(void)
+uid_t get_vuid(unsigned long gen)
 {
+	uint64_t cached;
 	uid_t vuid;
 
-	vuid = CMM_LOAD_SHARED(cached_vuid);
-
-	if (caa_unlikely(vuid == INVALID_UID)) {
-		vuid = getuid();
-		CMM_STORE_SHARED(cached_vuid, vuid);
-	}
+	if (caa_likely(lttng_context_cache_slot_get(&cached_vuid, gen, &cached)))
+		return (uid_t) cached;
+	vuid = getuid();
+	lttng_context_cache_slot_set(&cached_vuid, gen, vuid);
 
 	return vuid;
 }
@@ -68,7 +68,7 @@ uid_t get_vuid(void)
  */
 void lttng_context_vuid_reset(void)
 {
-	CMM_STORE_SHARED(cached_vuid, INVALID_UID);
+	lttng_context_cache_invalidate();
 }
 
 static
@@ -88,7 +88,7 @@ void vuid_record(struct lttng_ctx_field *field,
 {
 	uid_t vuid;
 
-	vuid = get_vuid();
+	vuid = get_vuid(lttng_context_cache_get_gen_tsc(ctx->tsc));
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(vuid));
 	chan->ops->event_write(ctx, &vuid, sizeof(vuid));
 }
@@ -97,7 +97,7 @@ static
 void vuid_get_value(struct lttng_ctx_field *field,
 		struct lttng_ctx_value *value)
 {
-	value->u.s64 = get_vuid();
+	value->u.s64 = get_vuid(lttng_context_cache_get_gen());
 }
 
 int lttng_add_vuid_to_ctx(struct lttng_ctx **ctx)
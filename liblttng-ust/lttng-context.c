@@ -25,10 +25,16 @@
 #include <lttng/ust-tracer.h>
 #include <lttng/ust-context-provider.h>
 #include <urcu-pointer.h>
+#include <urcu/uatomic.h>
 #include <usterr-signal-safe.h>
 #include <helper.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <assert.h>
+#include "lttng-tracer-core.h"
+#include "clock.h"
+#include "getenv.h"
 
 /*
  * The filter implementation requires that two consecutive "get" for the
@@ -293,15 +299,20 @@ void lttng_destroy_context(struct lttng_ctx *ctx)
  * a provider (by name) while tracing is using it, in a way that ensures
  * a single RCU read-side critical section see either all old, or all
  * new handlers.
+ *
+ * Contexts of dynamic type use the given handlers. Contexts of static
+ * type use the handlers of @typed_provider if it provides their type,
+ * and record zeroes otherwise.
  */
-int lttng_ust_context_set_provider_rcu(struct lttng_ctx **_ctx,
+int lttng_context_set_app_provider_rcu(struct lttng_ctx **_ctx,
 		const char *name,
 		size_t (*get_size)(struct lttng_ctx_field *field, size_t offset),
 		void (*record)(struct lttng_ctx_field *field,
 			struct lttng_ust_lib_ring_buffer_ctx *ctx,
 			struct lttng_channel *chan),
 		void (*get_value)(struct lttng_ctx_field *field,
-			struct lttng_ctx_value *value))
+			struct lttng_ctx_value *value),
+		struct lttng_ust_context_provider *typed_provider)
 {
 	int i, ret;
 	struct lttng_ctx *ctx = *_ctx, *new_ctx;
@@ -327,6 +338,11 @@ int lttng_ust_context_set_provider_rcu(struct lttng_ctx **_ctx,
 		if (strncmp(new_fields[i].event_field.name,
 				name, strlen(name)) != 0)
 			continue;
+		if (new_fields[i].event_field.type.atype != atype_dynamic) {
+			lttng_ust_context_provider_set_typed_field(&new_fields[i],
+					typed_provider);
+			continue;
+		}
 		new_fields[i].get_size = get_size;
 		new_fields[i].record = record;
 		new_fields[i].get_value = get_value;
@@ -343,6 +359,19 @@ field_error:
 	return ret;
 }
 
+int lttng_ust_context_set_provider_rcu(struct lttng_ctx **_ctx,
+		const char *name,
+		size_t (*get_size)(struct lttng_ctx_field *field, size_t offset),
+		void (*record)(struct lttng_ctx_field *field,
+			struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			struct lttng_channel *chan),
+		void (*get_value)(struct lttng_ctx_field *field,
+			struct lttng_ctx_value *value))
+{
+	return lttng_context_set_app_provider_rcu(_ctx, name, get_size,
+			record, get_value, NULL);
+}
+
 int lttng_session_context_init(struct lttng_ctx **ctx)
 {
 	int ret;
@@ -445,6 +474,72 @@ error:
 	return ret;
 }
 
+unsigned long lttng_context_cache_gen = 1;
+unsigned long lttng_context_cache_expire;
+uint64_t lttng_context_cache_period_ns;
+
+/*
+ * Read the revalidation period of the context caches. Unset or 0
+ * keeps the cached values until a reset function invalidates them.
+ */
+void lttng_context_cache_init(void)
+{
+	const char *str;
+	char *endptr;
+	unsigned long period_ms;
+
+	str = lttng_getenv("LTTNG_UST_CONTEXT_REVALIDATE_MS");
+	if (!str)
+		return;
+	errno = 0;
+	period_ms = strtoul(str, &endptr, 10);
+	if (errno || endptr == str || *endptr) {
+		ERR("Invalid LTTNG_UST_CONTEXT_REVALIDATE_MS value \"%s\"",
+			str);
+		return;
+	}
+	lttng_context_cache_period_ns = (uint64_t) period_ms * 1000000ULL;
+}
+
+void lttng_context_cache_invalidate(void)
+{
+	uatomic_inc(&lttng_context_cache_gen);
+}
+
+static
+uint64_t context_cache_period(void)
+{
+	struct lttng_trace_clock *ltc = CMM_LOAD_SHARED(lttng_trace_clock);
+	uint64_t freq;
+
+	if (caa_likely(!ltc))
+		return lttng_context_cache_period_ns;
+	cmm_read_barrier_depends();	/* load ltc before content */
+	freq = ltc->freq();
+	if (!freq)
+		return lttng_context_cache_period_ns;
+	return lttng_context_cache_period_ns * freq / 1000000000ULL;
+}
+
+/*
+ * Called at most once per period from the tracing fast path, which
+ * can be nested within signal handlers: only one of the concurrent
+ * callers succeeding the cmpxchg starts the new generation.
+ */
+void lttng_context_cache_expire_tsc(uint64_t tsc)
+{
+	unsigned long old_expire, new_expire;
+
+	old_expire = CMM_LOAD_SHARED(lttng_context_cache_expire);
+	if ((long) ((unsigned long) tsc - old_expire) < 0)
+		return;
+	new_expire = (unsigned long) (tsc + context_cache_period());
+	if (uatomic_cmpxchg(&lttng_context_cache_expire, old_expire,
+			new_expire) != old_expire)
+		return;
+	lttng_context_cache_invalidate();
+}
+
 /* For backward compatibility. Leave those exported symbols in place. */
 struct lttng_ctx *lttng_static_ctx;
 
@@ -84,6 +84,8 @@ void lttng_session_lazy_sync_enablers(struct lttng_session *session);
 static
 void lttng_session_sync_enablers(struct lttng_session *session);
 static
+void lttng_session_sync_event_state(struct lttng_session *session);
+static
 void lttng_enabler_destroy(struct lttng_enabler *enabler);
 
 /*
@@ -461,6 +463,13 @@ int lttng_session_enable(struct lttng_session *session)
 		}
 	}
 
+	/*
+	 * Set up the perf counters of the existing threads before they
+	 * record their first event, if prewarming is enabled.
+	 */
+	cds_list_for_each_entry(chan, &session->chan_head, node)
+		lttng_perf_counter_prewarm(chan->ctx);
+
 	/* Set atomically the state to "active" */
 	CMM_ACCESS_ONCE(session->active) = 1;
 	CMM_ACCESS_ONCE(session->been_active) = 1;
@@ -725,66 +734,148 @@ struct lttng_enabler_ref * lttng_event_enabler_ref(struct lttng_event *event,
 }
 
 /*
- * Create struct lttng_event if it is missing and present in the list of
- * tracepoint probes.
+ * Compute the length of the literal prefix of the enabler event name,
+ * which any matching event name must begin with.
  */
 static
-void lttng_create_event_if_missing(struct lttng_enabler *enabler)
+size_t lttng_enabler_literal_prefix_len(struct lttng_enabler *enabler)
+{
+	const char *name = enabler->event_param.name;
+
+	switch (enabler->type) {
+	case LTTNG_ENABLER_STAR_GLOB:
+		/* Stop at the first wildcard or escape character. */
+		return strcspn(name, "*\\");
+	case LTTNG_ENABLER_EVENT:
+	default:
+		return strlen(name);
+	}
+}
+
+/*
+ * Event names all begin with "<provider>:". Skip providers for which
+ * this is incompatible with the literal prefix of the enabler, without
+ * matching each of their events.
+ */
+static
+int lttng_probe_may_match_enabler(const struct lttng_probe_desc *probe_desc,
+		const char *name, size_t prefix_len)
+{
+	size_t provider_len = strlen(probe_desc->provider);
+
+	if (strncmp(name, probe_desc->provider,
+			min_t(size_t, prefix_len, provider_len)))
+		return 0;
+	if (prefix_len > provider_len && name[provider_len] != ':')
+		return 0;
+	return 1;
+}
+
+/*
+ * Create struct lttng_event for each event of the given probe provider
+ * matching the enabler, if missing.
+ */
+static
+void lttng_create_probe_event_if_missing(struct lttng_enabler *enabler,
+		struct lttng_probe_desc *probe_desc)
 {
 	struct lttng_session *session = enabler->chan->session;
-	struct lttng_probe_desc *probe_desc;
 	const struct lttng_event_desc *desc;
 	struct lttng_event *event;
 	int i;
+
+	for (i = 0; i < probe_desc->nr_events; i++) {
+		int found = 0, ret;
+		struct cds_hlist_head *head;
+		struct cds_hlist_node *node;
+		const char *event_name;
+		size_t name_len;
+		uint32_t hash;
+
+		desc = probe_desc->event_desc[i];
+		if (!lttng_desc_match_enabler(desc, enabler))
+			continue;
+		event_name = desc->name;
+		name_len = strlen(event_name);
+
+		/*
+		 * Check if already created.
+		 */
+		hash = jhash(event_name, name_len, 0);
+		head = &session->events_ht.table[hash & (LTTNG_UST_EVENT_HT_SIZE - 1)];
+		cds_hlist_for_each_entry(event, node, head, hlist) {
+			if (event->desc == desc
+					&& event->chan == enabler->chan) {
+				found = 1;
+				break;
+			}
+		}
+		if (found)
+			continue;
+
+		/*
+		 * We need to create an event for this
+		 * event probe.
+		 */
+		ret = lttng_event_create(probe_desc->event_desc[i],
+				enabler->chan);
+		if (ret) {
+			DBG("Unable to create event %s, error %d\n",
+				probe_desc->event_desc[i]->name, ret);
+		}
+	}
+}
+
+/*
+ * Create struct lttng_event if it is missing and present in the list of
+ * tracepoint probes.
+ */
+static
+void lttng_create_event_if_missing(struct lttng_enabler *enabler)
+{
+	const char *name = enabler->event_param.name;
+	struct lttng_probe_desc *probe_desc;
 	struct cds_list_head *probe_list;
+	size_t prefix_len;
+	const char *sep;
 
 	probe_list = lttng_get_probe_list_head();
+	prefix_len = lttng_enabler_literal_prefix_len(enabler);
+
+	/*
+	 * When the provider name is fully spelled out by the enabler,
+	 * only consider the providers registered under that name.
+	 */
+	sep = memchr(name, ':', prefix_len);
+	if (sep) {
+		struct lttng_probe_ht_node *ht_node;
+		struct cds_hlist_head *head;
+		size_t provider_len = sep - name;
+
+		head = lttng_get_probe_ht_bucket(name, provider_len);
+		cds_hlist_for_each_entry_2(ht_node, head, hlist) {
+			probe_desc = ht_node->desc;
+			if (probe_desc->lazy)
+				continue;
+			if (strlen(probe_desc->provider) != provider_len
+					|| strncmp(probe_desc->provider, name,
+						provider_len))
+				continue;
+			lttng_create_probe_event_if_missing(enabler,
+				probe_desc);
+		}
+		return;
+	}
+
 	/*
 	 * For each probe event, if we find that a probe event matches
 	 * our enabler, create an associated lttng_event if not
 	 * already present.
 	 */
 	cds_list_for_each_entry(probe_desc, probe_list, head) {
-		for (i = 0; i < probe_desc->nr_events; i++) {
-			int found = 0, ret;
-			struct cds_hlist_head *head;
-			struct cds_hlist_node *node;
-			const char *event_name;
-			size_t name_len;
-			uint32_t hash;
-
-			desc = probe_desc->event_desc[i];
-			if (!lttng_desc_match_enabler(desc, enabler))
-				continue;
-			event_name = desc->name;
-			name_len = strlen(event_name);
-
-			/*
-			 * Check if already created.
-			 */
-			hash = jhash(event_name, name_len, 0);
-			head = &session->events_ht.table[hash & (LTTNG_UST_EVENT_HT_SIZE - 1)];
-			cds_hlist_for_each_entry(event, node, head, hlist) {
-				if (event->desc == desc
-						&& event->chan == enabler->chan) {
-					found = 1;
-					break;
-				}
-			}
-			if (found)
-				continue;
-
-			/*
-			 * We need to create an event for this
-			 * event probe.
-			 */
-			ret = lttng_event_create(probe_desc->event_desc[i],
-					enabler->chan);
-			if (ret) {
-				DBG("Unable to create event %s, error %d\n",
-					probe_desc->event_desc[i]->name, ret);
-			}
-		}
+		if (!lttng_probe_may_match_enabler(probe_desc, name, prefix_len))
+			continue;
+		lttng_create_probe_event_if_missing(enabler, probe_desc);
 	}
 }
 
@@ -894,8 +985,8 @@ void lttng_probe_provider_unregister_events(struct lttng_probe_desc *provider_de
 }
 
 /*
- * Create events associated with an enabler (if not already present),
- * and add backward reference from the event to the enabler.
+ * Add backward reference from the events associated with an enabler to
+ * the enabler. The events need to be created beforehand.
  */
 static
 int lttng_enabler_ref_events(struct lttng_enabler *enabler)
@@ -906,9 +997,6 @@ int lttng_enabler_ref_events(struct lttng_enabler *enabler)
 	if (!enabler->enabled)
 		goto end;
 
-	/* First ensure that probe events are created for this enabler. */
-	lttng_create_event_if_missing(enabler);
-
 	/* For each event matching enabler in session event list. */
 	cds_list_for_each_entry(event, &session->events_head, node) {
 		struct lttng_enabler_ref *enabler_ref;
@@ -943,45 +1031,53 @@ end:
 
 /*
  * Called at library load: connect the probe on all enablers matching
- * this event.
+ * this event. Only the probes being registered need to be matched
+ * against the enablers, the events of other probes already exist.
  * Called with session mutex held.
  */
 int lttng_fix_pending_events(void)
 {
+	struct cds_list_head *new_probes;
 	struct lttng_session *session;
 
+	new_probes = lttng_get_new_probe_list_head();
 	cds_list_for_each_entry(session, &sessions, node) {
-		lttng_session_lazy_sync_enablers(session);
+		struct lttng_enabler *enabler;
+
+		/* We can skip if session is not active */
+		if (!session->active)
+			continue;
+		cds_list_for_each_entry(enabler, &session->enablers_head, node) {
+			struct lttng_probe_desc *probe_desc;
+			size_t prefix_len;
+
+			if (!enabler->enabled)
+				continue;
+			prefix_len = lttng_enabler_literal_prefix_len(enabler);
+			cds_list_for_each_entry(probe_desc, new_probes,
+					lazy_init_head) {
+				if (!lttng_probe_may_match_enabler(probe_desc,
+						enabler->event_param.name,
+						prefix_len))
+					continue;
+				lttng_create_probe_event_if_missing(enabler,
+					probe_desc);
+			}
+		}
+		lttng_session_sync_event_state(session);
 	}
 	return 0;
 }
 
 /*
- * For each session of the owner thread, execute pending statedump.
- * Only dump state for the sessions owned by the caller thread, because
- * we don't keep ust_lock across the entire iteration.
+ * Execute pending statedump. The statedump covers the sessions of all
+ * owners for which a statedump is pending, and clears their pending
+ * state as it starts.
  */
 void lttng_handle_pending_statedump(void *owner)
 {
-	struct lttng_session *session;
-
 	/* Execute state dump */
 	do_lttng_ust_statedump(owner);
-
-	/* Clear pending state dump */
-	if (ust_lock()) {
-		goto end;
-	}
-	cds_list_for_each_entry(session, &sessions, node) {
-		if (session->owner != owner)
-			continue;
-		if (!session->statedump_pending)
-			continue;
-		session->statedump_pending = 0;
-	}
-end:
-	ust_unlock();
-	return;
 }
 
 /*
@@ -1144,6 +1240,12 @@ int lttng_attach_context(struct lttng_ust_context *context_param,
 		return lttng_add_vegid_to_ctx(ctx);
 	case LTTNG_UST_CONTEXT_VSGID:
 		return lttng_add_vsgid_to_ctx(ctx);
+	case LTTNG_UST_CONTEXT_CALLSTACK_USER:
+		return lttng_add_callstack_user_to_ctx(ctx);
+	case LTTNG_UST_CONTEXT_CALLSTACK_USER_DEDUP:
+		return lttng_add_callstack_user_dedup_to_ctx(ctx);
+	case LTTNG_UST_CONTEXT_PROCNAME_ID:
+		return lttng_add_procname_id_to_ctx(ctx);
 	default:
 		return -EINVAL;
 	}
@@ -1196,6 +1298,23 @@ void lttng_enabler_destroy(struct lttng_enabler *enabler)
  */
 static
 void lttng_session_sync_enablers(struct lttng_session *session)
+{
+	struct lttng_enabler *enabler;
+
+	/* First ensure that probe events are created for the enablers. */
+	cds_list_for_each_entry(enabler, &session->enablers_head, node) {
+		if (enabler->enabled)
+			lttng_create_event_if_missing(enabler);
+	}
+	lttng_session_sync_event_state(session);
+}
+
+/*
+ * Reference the session events from their enablers, and sync the
+ * events enabled state with them. The events must have been created.
+ */
+static
+void lttng_session_sync_event_state(struct lttng_session *session)
 {
 	struct lttng_enabler *enabler;
 	struct lttng_event *event;
@@ -1282,14 +1401,16 @@ void lttng_session_lazy_sync_enablers(struct lttng_session *session)
  * This is invoked when an application context gets loaded/unloaded. It
  * ensures the context callbacks are in sync with the application
  * context (either app context callbacks, or dummy callbacks).
+ * @typed_provider is the provider registered with a static type, if any.
  */
-void lttng_ust_context_set_session_provider(const char *name,
+void lttng_ust_context_set_session_app_provider(const char *name,
 		size_t (*get_size)(struct lttng_ctx_field *field, size_t offset),
 		void (*record)(struct lttng_ctx_field *field,
 			struct lttng_ust_lib_ring_buffer_ctx *ctx,
 			struct lttng_channel *chan),
 		void (*get_value)(struct lttng_ctx_field *field,
-			struct lttng_ctx_value *value))
+			struct lttng_ctx_value *value),
+		struct lttng_ust_context_provider *typed_provider)
 {
 	struct lttng_session *session;
 
@@ -1298,21 +1419,36 @@ void lttng_ust_context_set_session_provider(const char *name,
 		struct lttng_event *event;
 		int ret;
 
-		ret = lttng_ust_context_set_provider_rcu(&session->ctx,
-				name, get_size, record, get_value);
+		ret = lttng_context_set_app_provider_rcu(&session->ctx,
+				name, get_size, record, get_value,
+				typed_provider);
 		if (ret)
 			abort();
 		cds_list_for_each_entry(chan, &session->chan_head, node) {
-			ret = lttng_ust_context_set_provider_rcu(&chan->ctx,
-					name, get_size, record, get_value);
+			ret = lttng_context_set_app_provider_rcu(&chan->ctx,
+					name, get_size, record, get_value,
+					typed_provider);
 			if (ret)
 				abort();
 		}
 		cds_list_for_each_entry(event, &session->events_head, node) {
-			ret = lttng_ust_context_set_provider_rcu(&event->ctx,
-					name, get_size, record, get_value);
+			ret = lttng_context_set_app_provider_rcu(&event->ctx,
+					name, get_size, record, get_value,
+					typed_provider);
 			if (ret)
 				abort();
 		}
 	}
 }
+
+void lttng_ust_context_set_session_provider(const char *name,
+		size_t (*get_size)(struct lttng_ctx_field *field, size_t offset),
+		void (*record)(struct lttng_ctx_field *field,
+			struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			struct lttng_channel *chan),
+		void (*get_value)(struct lttng_ctx_field *field,
+			struct lttng_ctx_value *value))
+{
+	lttng_ust_context_set_session_app_provider(name, get_size, record,
+			get_value, NULL);
+}
@@ -46,6 +46,12 @@ static CDS_LIST_HEAD(_probe_list);
  */
 static CDS_LIST_HEAD(lazy_probe_init);
 
+/*
+ * Probes (lazy or not) hashed by provider name. Protected by
+ * ust_lock()/ust_unlock().
+ */
+static struct cds_hlist_head probe_ht[LTTNG_UST_PROBE_HT_SIZE];
+
 /*
  * lazy_nesting counter ensures we don't trigger lazy probe registration
  * fixup while we are performing the fixup. It is protected by the ust
@@ -53,9 +59,9 @@ static CDS_LIST_HEAD(lazy_probe_init);
  */
 static int lazy_nesting;
 
-/*
- * Called under ust lock.
- */
+static
+void invalidate_list_caches(void);
+
 static
 int check_event_provider(struct lttng_probe_desc *desc)
 {
@@ -76,20 +82,39 @@ int check_event_provider(struct lttng_probe_desc *desc)
 /*
  * Called under ust lock.
  */
-static
-void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
+struct cds_hlist_head *lttng_get_probe_ht_bucket(const char *provider,
+		size_t len)
 {
-	struct lttng_probe_desc *iter;
-	struct cds_list_head *probe_list;
+	uint32_t hash;
 
-	/*
-	 * Each provider enforce that every event name begins with the
-	 * provider name. Check this in an assertion for extra
-	 * carefulness. This ensures we cannot have duplicate event
-	 * names across providers.
-	 */
-	assert(check_event_provider(desc));
+	hash = jhash(provider, len, 0);
+	return &probe_ht[hash & (LTTNG_UST_PROBE_HT_SIZE - 1)];
+}
 
+/*
+ * Called under ust lock.
+ */
+static
+struct lttng_probe_ht_node *lttng_probe_ht_lookup(struct lttng_probe_desc *desc)
+{
+	struct lttng_probe_ht_node *node;
+	struct cds_hlist_head *head;
+
+	head = lttng_get_probe_ht_bucket(desc->provider,
+			strlen(desc->provider));
+	cds_hlist_for_each_entry_2(node, head, hlist) {
+		if (node->desc == desc)
+			return node;
+	}
+	return NULL;
+}
+
+/*
+ * Called under ust lock.
+ */
+static
+void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
+{
 	/*
 	 * The provider ensures there are no duplicate event names.
 	 * Duplicated TRACEPOINT_EVENT event names would generate a
@@ -97,46 +122,46 @@ void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
 	 */
 
 	/*
-	 * We sort the providers by struct lttng_probe_desc pointer
-	 * address.
+	 * Providers are validated and hashed when registered, so only
+	 * append them to the probe list.
 	 */
-	probe_list = &_probe_list;
-	cds_list_for_each_entry_reverse(iter, probe_list, head) {
-		BUG_ON(iter == desc); /* Should never be in the list twice */
-		if (iter < desc) {
-			/* We belong to the location right after iter. */
-			cds_list_add(&desc->head, &iter->head);
-			goto desc_added;
-		}
-	}
-	/* We should be added at the head of the list */
-	cds_list_add(&desc->head, probe_list);
-desc_added:
+	cds_list_add_tail(&desc->head, &_probe_list);
 	DBG("just registered probe %s containing %u events",
 		desc->provider, desc->nr_events);
 }
 
 /*
  * Called under ust lock.
+ *
+ * The probes being registered stay on the lazy list while pending
+ * events are fixed, so only those new providers are matched against
+ * the session enablers.
  */
 static
 void fixup_lazy_probes(void)
 {
-	struct lttng_probe_desc *iter, *tmp;
+	struct lttng_probe_desc *iter;
 	int ret;
 
 	lazy_nesting++;
-	cds_list_for_each_entry_safe(iter, tmp,
-			&lazy_probe_init, lazy_init_head) {
+	cds_list_for_each_entry(iter, &lazy_probe_init, lazy_init_head) {
 		lttng_lazy_probe_register(iter);
 		iter->lazy = 0;
-		cds_list_del(&iter->lazy_init_head);
 	}
 	ret = lttng_fix_pending_events();
 	assert(!ret);
+	CDS_INIT_LIST_HEAD(&lazy_probe_init);
 	lazy_nesting--;
 }
 
+/*
+ * Called under ust lock, from lttng_fix_pending_events().
+ */
+struct cds_list_head *lttng_get_new_probe_list_head(void)
+{
+	return &lazy_probe_init;
+}
+
 /*
  * Called under ust lock.
  */
@@ -179,6 +204,7 @@ int check_provider_version(struct lttng_probe_desc *desc)
 
 int lttng_probe_register(struct lttng_probe_desc *desc)
 {
+	struct lttng_probe_ht_node *node;
 	int ret = 0;
 
 	lttng_ust_fixup_tls();
@@ -190,8 +216,26 @@ int lttng_probe_register(struct lttng_probe_desc *desc)
 	if (!check_provider_version(desc))
 		return 0;
 
+	/*
+	 * Each provider enforce that every event name begins with the
+	 * provider name. Check this in an assertion for extra
+	 * carefulness. This ensures we cannot have duplicate event
+	 * names across providers.
+	 */
+	assert(check_event_provider(desc));
+
+	node = zmalloc(sizeof(*node));
+	if (!node)
+		return -ENOMEM;
+	node->desc = desc;
+
 	ust_lock_nocheck();
 
+	BUG_ON(lttng_probe_ht_lookup(desc)); /* Should never be registered twice */
+	cds_hlist_add_head(&node->hlist,
+		lttng_get_probe_ht_bucket(desc->provider,
+			strlen(desc->provider)));
+	invalidate_list_caches();
 	cds_list_add(&desc->lazy_init_head, &lazy_probe_init);
 	desc->lazy = 1;
 	DBG("adding probe %s containing %u events to lazy registration list",
@@ -216,18 +260,26 @@ int ltt_probe_register(struct lttng_probe_desc *desc)
 
 void lttng_probe_unregister(struct lttng_probe_desc *desc)
 {
+	struct lttng_probe_ht_node *node;
+
 	lttng_ust_fixup_tls();
 
 	if (!check_provider_version(desc))
 		return;
 
 	ust_lock_nocheck();
+	node = lttng_probe_ht_lookup(desc);
+	if (node) {
+		cds_hlist_del(&node->hlist);
+		free(node);
+	}
 	if (!desc->lazy)
 		cds_list_del(&desc->head);
 	else
 		cds_list_del(&desc->lazy_init_head);
 
 	lttng_probe_provider_unregister_events(desc);
+	invalidate_list_caches();
 	DBG("just unregistered probes of provider %s", desc->provider);
 
 	ust_unlock();
@@ -239,194 +291,275 @@ void ltt_probe_unregister(struct lttng_probe_desc *desc)
 	lttng_probe_unregister(desc);
 }
 
-void lttng_probes_prune_event_list(struct lttng_ust_tracepoint_list *list)
+/*
+ * Snapshots of the tracepoint and field listings, shared by all the
+ * list objects created while the set of registered probes is
+ * unchanged. Each list object holds a reference on the snapshot it
+ * iterates on. Protected by ust_lock()/ust_unlock().
+ */
+struct lttng_ust_tracepoint_list_cache {
+	int refcount;
+	size_t nr_entries;
+	struct lttng_ust_tracepoint_iter entries[];
+};
+
+struct lttng_ust_field_list_cache {
+	int refcount;
+	size_t nr_entries;
+	struct lttng_ust_field_iter entries[];
+};
+
+static struct lttng_ust_tracepoint_list_cache *tracepoint_list_cache;
+static struct lttng_ust_field_list_cache *field_list_cache;
+
+static
+void put_tracepoint_list_cache(struct lttng_ust_tracepoint_list_cache *cache)
 {
-	struct tp_list_entry *list_entry, *tmp;
+	if (cache && !--cache->refcount)
+		free(cache);
+}
 
-	cds_list_for_each_entry_safe(list_entry, tmp, &list->head, head) {
-		cds_list_del(&list_entry->head);
-		free(list_entry);
-	}
+static
+void put_field_list_cache(struct lttng_ust_field_list_cache *cache)
+{
+	if (cache && !--cache->refcount)
+		free(cache);
 }
 
 /*
- * called with UST lock held.
+ * Called under ust lock, whenever the set of registered probes changes.
  */
-int lttng_probes_get_event_list(struct lttng_ust_tracepoint_list *list)
+static
+void invalidate_list_caches(void)
 {
-	struct lttng_probe_desc *probe_desc;
-	int i;
-	struct cds_list_head *probe_list;
+	put_tracepoint_list_cache(tracepoint_list_cache);
+	tracepoint_list_cache = NULL;
+	put_field_list_cache(field_list_cache);
+	field_list_cache = NULL;
+}
 
-	probe_list = lttng_get_probe_list_head();
-	CDS_INIT_LIST_HEAD(&list->head);
-	cds_list_for_each_entry(probe_desc, probe_list, head) {
-		for (i = 0; i < probe_desc->nr_events; i++) {
-			struct tp_list_entry *list_entry;
-
-			list_entry = zmalloc(sizeof(*list_entry));
-			if (!list_entry)
-				goto err_nomem;
-			cds_list_add(&list_entry->head, &list->head);
-			strncpy(list_entry->tp.name,
-				probe_desc->event_desc[i]->name,
-				LTTNG_UST_SYM_NAME_LEN);
-			list_entry->tp.name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
-			if (!probe_desc->event_desc[i]->loglevel) {
-				list_entry->tp.loglevel = TRACE_DEFAULT;
-			} else {
-				list_entry->tp.loglevel = *(*probe_desc->event_desc[i]->loglevel);
-			}
-		}
-	}
-	if (cds_list_empty(&list->head))
-		list->iter = NULL;
-	else
-		list->iter =
-			cds_list_first_entry(&list->head, struct tp_list_entry, head);
-	return 0;
+static
+int get_event_loglevel(const struct lttng_event_desc *event_desc)
+{
+	if (!event_desc->loglevel)
+		return TRACE_DEFAULT;
+	return *(*event_desc->loglevel);
+}
 
-err_nomem:
-	lttng_probes_prune_event_list(list);
-	return -ENOMEM;
+static
+enum lttng_ust_field_type get_field_type(const struct lttng_event_field *event_field)
+{
+	switch (event_field->type.atype) {
+	case atype_integer:
+		return LTTNG_UST_FIELD_INTEGER;
+	case atype_string:
+		return LTTNG_UST_FIELD_STRING;
+	case atype_array:
+		if (event_field->type.u.array.elem_type.atype != atype_integer
+			|| event_field->type.u.array.elem_type.u.basic.integer.encoding == lttng_encode_none)
+			return LTTNG_UST_FIELD_OTHER;
+		else
+			return LTTNG_UST_FIELD_STRING;
+	case atype_sequence:
+		if (event_field->type.u.sequence.elem_type.atype != atype_integer
+			|| event_field->type.u.sequence.elem_type.u.basic.integer.encoding == lttng_encode_none)
+			return LTTNG_UST_FIELD_OTHER;
+		else
+			return LTTNG_UST_FIELD_STRING;
+	case atype_float:
+		return LTTNG_UST_FIELD_FLOAT;
+	case atype_enum:
+		return LTTNG_UST_FIELD_ENUM;
+	default:
+		return LTTNG_UST_FIELD_OTHER;
+	}
 }
 
 /*
- * Return current iteration position, advance internal iterator to next.
- * Return NULL if end of list.
+ * Called under ust lock.
  */
-struct lttng_ust_tracepoint_iter *
-	lttng_ust_tracepoint_list_get_iter_next(struct lttng_ust_tracepoint_list *list)
+static
+struct lttng_ust_tracepoint_list_cache *get_tracepoint_list_cache(void)
 {
-	struct tp_list_entry *entry;
+	struct lttng_ust_tracepoint_list_cache *cache;
+	struct lttng_probe_desc *probe_desc;
+	struct cds_list_head *probe_list;
+	size_t nr_entries = 0, pos = 0;
+	int i;
 
-	if (!list->iter)
+	/* Registers the lazy probes, which may invalidate the cache. */
+	probe_list = lttng_get_probe_list_head();
+	if (tracepoint_list_cache)
+		goto end;
+
+	cds_list_for_each_entry(probe_desc, probe_list, head)
+		nr_entries += probe_desc->nr_events;
+	cache = zmalloc(sizeof(*cache)
+			+ nr_entries * sizeof(struct lttng_ust_tracepoint_iter));
+	if (!cache)
 		return NULL;
-	entry = list->iter;
-	if (entry->head.next == &list->head)
-		list->iter = NULL;
-	else
-		list->iter = cds_list_entry(entry->head.next,
-				struct tp_list_entry, head);
-	return &entry->tp;
-}
-
-void lttng_probes_prune_field_list(struct lttng_ust_field_list *list)
-{
-	struct tp_field_list_entry *list_entry, *tmp;
+	cache->refcount = 1;	/* Reference held by tracepoint_list_cache. */
+	cache->nr_entries = nr_entries;
+	cds_list_for_each_entry(probe_desc, probe_list, head) {
+		for (i = 0; i < probe_desc->nr_events; i++) {
+			const struct lttng_event_desc *event_desc =
+				probe_desc->event_desc[i];
+			struct lttng_ust_tracepoint_iter *entry =
+				&cache->entries[pos++];
 
-	cds_list_for_each_entry_safe(list_entry, tmp, &list->head, head) {
-		cds_list_del(&list_entry->head);
-		free(list_entry);
+			strncpy(entry->name, event_desc->name,
+				LTTNG_UST_SYM_NAME_LEN);
+			entry->name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+			entry->loglevel = get_event_loglevel(event_desc);
+		}
 	}
+	tracepoint_list_cache = cache;
+end:
+	tracepoint_list_cache->refcount++;
+	return tracepoint_list_cache;
 }
 
 /*
- * called with UST lock held.
+ * Called under ust lock.
  */
-int lttng_probes_get_field_list(struct lttng_ust_field_list *list)
+static
+struct lttng_ust_field_list_cache *get_field_list_cache(void)
 {
+	struct lttng_ust_field_list_cache *cache;
 	struct lttng_probe_desc *probe_desc;
-	int i;
 	struct cds_list_head *probe_list;
+	size_t nr_entries = 0, pos = 0;
+	int i;
 
+	/* Registers the lazy probes, which may invalidate the cache. */
 	probe_list = lttng_get_probe_list_head();
-	CDS_INIT_LIST_HEAD(&list->head);
+	if (field_list_cache)
+		goto end;
+
+	cds_list_for_each_entry(probe_desc, probe_list, head) {
+		for (i = 0; i < probe_desc->nr_events; i++) {
+			unsigned int nr_fields =
+				probe_desc->event_desc[i]->nr_fields;
+
+			/* Events without fields are listed once. */
+			nr_entries += nr_fields ? nr_fields : 1;
+		}
+	}
+	cache = zmalloc(sizeof(*cache)
+			+ nr_entries * sizeof(struct lttng_ust_field_iter));
+	if (!cache)
+		return NULL;
+	cache->refcount = 1;	/* Reference held by field_list_cache. */
+	cache->nr_entries = nr_entries;
 	cds_list_for_each_entry(probe_desc, probe_list, head) {
 		for (i = 0; i < probe_desc->nr_events; i++) {
 			const struct lttng_event_desc *event_desc =
 				probe_desc->event_desc[i];
+			struct lttng_ust_field_iter *entry;
 			int j;
 
 			if (event_desc->nr_fields == 0) {
 				/* Events without fields. */
-				struct tp_field_list_entry *list_entry;
-
-				list_entry = zmalloc(sizeof(*list_entry));
-				if (!list_entry)
-					goto err_nomem;
-				cds_list_add(&list_entry->head, &list->head);
-				strncpy(list_entry->field.event_name,
+				entry = &cache->entries[pos++];
+				strncpy(entry->event_name,
 					event_desc->name,
 					LTTNG_UST_SYM_NAME_LEN);
-				list_entry->field.event_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
-				list_entry->field.field_name[0] = '\0';
-				list_entry->field.type = LTTNG_UST_FIELD_OTHER;
-				if (!event_desc->loglevel) {
-					list_entry->field.loglevel = TRACE_DEFAULT;
-				} else {
-					list_entry->field.loglevel = *(*event_desc->loglevel);
-				}
-				list_entry->field.nowrite = 1;
+				entry->event_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+				entry->field_name[0] = '\0';
+				entry->type = LTTNG_UST_FIELD_OTHER;
+				entry->loglevel = get_event_loglevel(event_desc);
+				entry->nowrite = 1;
 			}
 
 			for (j = 0; j < event_desc->nr_fields; j++) {
 				const struct lttng_event_field *event_field =
 					&event_desc->fields[j];
-				struct tp_field_list_entry *list_entry;
 
-				list_entry = zmalloc(sizeof(*list_entry));
-				if (!list_entry)
-					goto err_nomem;
-				cds_list_add(&list_entry->head, &list->head);
-				strncpy(list_entry->field.event_name,
+				entry = &cache->entries[pos++];
+				strncpy(entry->event_name,
 					event_desc->name,
 					LTTNG_UST_SYM_NAME_LEN);
-				list_entry->field.event_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
-				strncpy(list_entry->field.field_name,
+				entry->event_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+				strncpy(entry->field_name,
 					event_field->name,
 					LTTNG_UST_SYM_NAME_LEN);
-				list_entry->field.field_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
-				switch (event_field->type.atype) {
-				case atype_integer:
-					list_entry->field.type = LTTNG_UST_FIELD_INTEGER;
-					break;
-				case atype_string:
-					list_entry->field.type = LTTNG_UST_FIELD_STRING;
-					break;
-				case atype_array:
-					if (event_field->type.u.array.elem_type.atype != atype_integer
-						|| event_field->type.u.array.elem_type.u.basic.integer.encoding == lttng_encode_none)
-						list_entry->field.type = LTTNG_UST_FIELD_OTHER;
-					else
-						list_entry->field.type = LTTNG_UST_FIELD_STRING;
-					break;
-				case atype_sequence:
-					if (event_field->type.u.sequence.elem_type.atype != atype_integer
-						|| event_field->type.u.sequence.elem_type.u.basic.integer.encoding == lttng_encode_none)
-						list_entry->field.type = LTTNG_UST_FIELD_OTHER;
-					else
-						list_entry->field.type = LTTNG_UST_FIELD_STRING;
-					break;
-				case atype_float:
-					list_entry->field.type = LTTNG_UST_FIELD_FLOAT;
-					break;
-				case atype_enum:
-					list_entry->field.type = LTTNG_UST_FIELD_ENUM;
-					break;
-				default:
-					list_entry->field.type = LTTNG_UST_FIELD_OTHER;
-				}
-				if (!event_desc->loglevel) {
-					list_entry->field.loglevel = TRACE_DEFAULT;
-				} else {
-					list_entry->field.loglevel = *(*event_desc->loglevel);
-				}
-				list_entry->field.nowrite = event_field->nowrite;
+				entry->field_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+				entry->type = get_field_type(event_field);
+				entry->loglevel = get_event_loglevel(event_desc);
+				entry->nowrite = event_field->nowrite;
 			}
 		}
 	}
-	if (cds_list_empty(&list->head))
-		list->iter = NULL;
-	else
-		list->iter =
-			cds_list_first_entry(&list->head,
-				struct tp_field_list_entry, head);
+	field_list_cache = cache;
+end:
+	field_list_cache->refcount++;
+	return field_list_cache;
+}
+
+void lttng_probes_prune_event_list(struct lttng_ust_tracepoint_list *list)
+{
+	put_tracepoint_list_cache(list->cache);
+	list->cache = NULL;
+}
+
+/*
+ * called with UST lock held.
+ */
+int lttng_probes_get_event_list(struct lttng_ust_tracepoint_list *list)
+{
+	list->cache = get_tracepoint_list_cache();
+	if (!list->cache)
+		return -ENOMEM;
+	list->pos = 0;
 	return 0;
+}
+
+/*
+ * Return current iteration position, advance internal iterator to next.
+ * Return NULL if end of list.
+ */
+struct lttng_ust_tracepoint_iter *
+	lttng_ust_tracepoint_list_get_iter_next(struct lttng_ust_tracepoint_list *list)
+{
+	if (list->pos >= list->cache->nr_entries)
+		return NULL;
+	return &list->cache->entries[list->pos++];
+}
+
+/*
+ * Return up to max_entries contiguous entries from the current
+ * iteration position in *entries, and advance the internal iterator
+ * past them. Return the number of entries, 0 if end of list.
+ */
+size_t lttng_ust_tracepoint_list_get_bulk(struct lttng_ust_tracepoint_list *list,
+		const struct lttng_ust_tracepoint_iter **entries,
+		size_t max_entries)
+{
+	size_t count;
+
+	count = min_t(size_t, max_entries,
+			list->cache->nr_entries - list->pos);
+	*entries = &list->cache->entries[list->pos];
+	list->pos += count;
+	return count;
+}
 
-err_nomem:
-	lttng_probes_prune_field_list(list);
-	return -ENOMEM;
+void lttng_probes_prune_field_list(struct lttng_ust_field_list *list)
+{
+	put_field_list_cache(list->cache);
+	list->cache = NULL;
+}
+
+/*
+ * called with UST lock held.
+ */
+int lttng_probes_get_field_list(struct lttng_ust_field_list *list)
+{
+	list->cache = get_field_list_cache();
+	if (!list->cache)
+		return -ENOMEM;
+	list->pos = 0;
+	return 0;
 }
 
 /*
@@ -436,15 +569,25 @@ err_nomem:
 struct lttng_ust_field_iter *
 	lttng_ust_field_list_get_iter_next(struct lttng_ust_field_list *list)
 {
-	struct tp_field_list_entry *entry;
-
-	if (!list->iter)
+	if (list->pos >= list->cache->nr_entries)
 		return NULL;
-	entry = list->iter;
-	if (entry->head.next == &list->head)
-		list->iter = NULL;
-	else
-		list->iter = cds_list_entry(entry->head.next,
-				struct tp_field_list_entry, head);
-	return &entry->field;
+	return &list->cache->entries[list->pos++];
+}
+
+/*
+ * Return up to max_entries contiguous entries from the current
+ * iteration position in *entries, and advance the internal iterator
+ * past them. Return the number of entries, 0 if end of list.
+ */
+size_t lttng_ust_field_list_get_bulk(struct lttng_ust_field_list *list,
+		const struct lttng_ust_field_iter **entries,
+		size_t max_entries)
+{
+	size_t count;
+
+	count = min_t(size_t, max_entries,
+			list->cache->nr_entries - list->pos);
+	*entries = &list->cache->entries[list->pos];
+	list->pos += count;
+	return count;
 }
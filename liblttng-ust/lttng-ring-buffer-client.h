@@ -723,7 +723,16 @@ int lttng_event_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
 	struct lttng_client_ctx client_ctx;
 	int ret, cpu;
 
-	/* Compute internal size of context structures. */
+	cpu = lib_ring_buffer_get_cpu(&client_config);
+	if (cpu < 0)
+		return -EPERM;
+	ctx->cpu = cpu;
+
+	/*
+	 * Compute internal size of context structures. This is done
+	 * within the ring buffer nesting count, so that contexts can keep
+	 * per-nesting-level state between get_size and record.
+	 */
 
 	if (lttng_ctx) {
 		/* 2.8+ probe ABI. */
@@ -739,11 +748,6 @@ int lttng_event_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
 				APP_CTX_DISABLED);
 	}
 
-	cpu = lib_ring_buffer_get_cpu(&client_config);
-	if (cpu < 0)
-		return -EPERM;
-	ctx->cpu = cpu;
-
 	switch (lttng_chan->header_type) {
 	case 1:	/* compact */
 		if (event_id > 30)
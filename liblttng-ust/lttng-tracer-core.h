@@ -23,8 +23,12 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 #include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
 #include <urcu/list.h>
+#include <urcu/hlist.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/bug.h>
 #include <lttng/ringbuffer-config.h>
@@ -45,6 +49,21 @@ struct lttng_event;
 struct lttng_ctx_field;
 struct lttng_ust_lib_ring_buffer_ctx;
 struct lttng_ctx_value;
+struct lttng_probe_desc;
+struct lttng_ctx;
+struct lttng_ust_context_provider;
+
+/*
+ * Registered probe providers, hashed by provider name. Protected by
+ * ust_lock().
+ */
+#define LTTNG_UST_PROBE_HT_BITS		9
+#define LTTNG_UST_PROBE_HT_SIZE		(1U << LTTNG_UST_PROBE_HT_BITS)
+
+struct lttng_probe_ht_node {
+	struct cds_hlist_node hlist;
+	struct lttng_probe_desc *desc;
+};
 
 int ust_lock(void) __attribute__ ((warn_unused_result));
 void ust_lock_nocheck(void);
@@ -57,6 +76,17 @@ void lttng_fixup_cgroup_ns_tls(void);
 void lttng_fixup_ipc_ns_tls(void);
 void lttng_fixup_net_ns_tls(void);
 void lttng_fixup_uts_ns_tls(void);
+void lttng_fixup_callstack_tls(void);
+
+LTTNG_HIDDEN
+void lttng_context_procname_statedump(void);
+LTTNG_HIDDEN
+void lttng_context_procname_after_fork_child(void);
+LTTNG_HIDDEN
+void lttng_ust_tracef_statedump(void);
+LTTNG_HIDDEN
+char *lttng_ust_tracef_vformat(char *buf, size_t buf_len, const char *fmt,
+		va_list ap, int *len);
 
 const char *lttng_ust_obj_get_name(int id);
 
@@ -80,10 +110,141 @@ void lttng_ust_dummy_get_value(struct lttng_ctx_field *field,
 int lttng_context_is_app(const char *name);
 void lttng_ust_fixup_tls(void);
 
+/* Application contexts provided with a static type. */
+LTTNG_HIDDEN
+void lttng_ust_context_provider_set_typed_field(struct lttng_ctx_field *field,
+		struct lttng_ust_context_provider *provider);
+LTTNG_HIDDEN
+int lttng_context_set_app_provider_rcu(struct lttng_ctx **_ctx,
+		const char *name,
+		size_t (*get_size)(struct lttng_ctx_field *field, size_t offset),
+		void (*record)(struct lttng_ctx_field *field,
+			struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			struct lttng_channel *chan),
+		void (*get_value)(struct lttng_ctx_field *field,
+			struct lttng_ctx_value *value),
+		struct lttng_ust_context_provider *typed_provider);
+LTTNG_HIDDEN
+void lttng_ust_context_set_session_app_provider(const char *name,
+		size_t (*get_size)(struct lttng_ctx_field *field, size_t offset),
+		void (*record)(struct lttng_ctx_field *field,
+			struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			struct lttng_channel *chan),
+		void (*get_value)(struct lttng_ctx_field *field,
+			struct lttng_ctx_value *value),
+		struct lttng_ust_context_provider *typed_provider);
+
+/*
+ * Generation of the namespace and credential context caches. A cached
+ * value is valid only while the generation it was computed at is
+ * current. The generation is bumped by the reset functions (fork,
+ * setns, unshare, set*id wrappers). A process which is not running
+ * with liblttng-ust-fork.so preloaded can also start a new generation
+ * periodically, based on the event timestamps, by setting the
+ * LTTNG_UST_CONTEXT_REVALIDATE_MS environment variable. Generation 0
+ * is never current, so zero-initialized cache entries are stale.
+ */
+LTTNG_HIDDEN
+extern unsigned long lttng_context_cache_gen;
+LTTNG_HIDDEN
+extern unsigned long lttng_context_cache_expire;
+/* Revalidation period (ns), 0 if periodic revalidation is disabled. */
+LTTNG_HIDDEN
+extern uint64_t lttng_context_cache_period_ns;
+
+LTTNG_HIDDEN
+void lttng_context_cache_init(void);
+LTTNG_HIDDEN
+void lttng_context_cache_invalidate(void);
+LTTNG_HIDDEN
+void lttng_context_cache_expire_tsc(uint64_t tsc);
+
+static inline
+unsigned long lttng_context_cache_get_gen(void)
+{
+	return CMM_LOAD_SHARED(lttng_context_cache_gen);
+}
+
+/*
+ * Same as lttng_context_cache_get_gen(), but first starts a new
+ * generation if periodic revalidation is enabled and its period has
+ * elapsed at @tsc. Only the record callbacks use it: get_value
+ * callbacks must keep returning the same value within the filter of a
+ * given event.
+ */
+static inline
+unsigned long lttng_context_cache_get_gen_tsc(uint64_t tsc)
+{
+	if (caa_unlikely(lttng_context_cache_period_ns)
+			&& caa_unlikely((long) ((unsigned long) tsc
+				- CMM_LOAD_SHARED(lttng_context_cache_expire)) >= 0))
+		lttng_context_cache_expire_tsc(tsc);
+	return lttng_context_cache_get_gen();
+}
+
+/*
+ * Cache of a per-process context value for one generation. The value
+ * and its generation are updated together under a sequence count, so
+ * concurrent updates can never pair a value with the generation of
+ * another. An update finding the slot busy is skipped, which keeps
+ * both operations signal-safe.
+ */
+struct lttng_context_cache_slot {
+	unsigned long seq;	/* Odd while an update is in progress. */
+	unsigned long gen;
+	uint64_t value;
+};
+
+/*
+ * Return 1 and set @value if the slot holds the value of generation
+ * @gen, 0 otherwise.
+ */
+static inline
+int lttng_context_cache_slot_get(struct lttng_context_cache_slot *slot,
+		unsigned long gen, uint64_t *value)
+{
+	unsigned long seq;
+	uint64_t v;
+
+	seq = CMM_LOAD_SHARED(slot->seq);
+	if (caa_unlikely(seq & 1))
+		return 0;
+	cmm_smp_rmb();	/* Load sequence before slot content. */
+	if (CMM_LOAD_SHARED(slot->gen) != gen)
+		return 0;
+	v = CMM_LOAD_SHARED(slot->value);
+	cmm_smp_rmb();	/* Load slot content before sequence. */
+	if (caa_unlikely(CMM_LOAD_SHARED(slot->seq) != seq))
+		return 0;
+	*value = v;
+	return 1;
+}
+
+static inline
+void lttng_context_cache_slot_set(struct lttng_context_cache_slot *slot,
+		unsigned long gen, uint64_t value)
+{
+	unsigned long seq;
+
+	seq = CMM_LOAD_SHARED(slot->seq);
+	if ((seq & 1) || uatomic_cmpxchg(&slot->seq, seq, seq + 1) != seq)
+		return;
+	/* uatomic_cmpxchg() implies a full memory barrier. */
+	CMM_STORE_SHARED(slot->gen, gen);
+	CMM_STORE_SHARED(slot->value, value);
+	cmm_smp_wmb();	/* Store slot content before sequence. */
+	CMM_STORE_SHARED(slot->seq, seq + 2);
+}
+
+struct cds_hlist_head *lttng_get_probe_ht_bucket(const char *provider,
+		size_t len);
+struct cds_list_head *lttng_get_new_probe_list_head(void);
+
 #ifdef LTTNG_UST_HAVE_PERF_EVENT
 void lttng_ust_fixup_perf_counter_tls(void);
 void lttng_perf_lock(void);
 void lttng_perf_unlock(void);
+void lttng_perf_counter_prewarm(struct lttng_ctx *ctx);
 #else /* #ifdef LTTNG_UST_HAVE_PERF_EVENT */
 static inline
 void lttng_ust_fixup_perf_counter_tls(void)
@@ -97,6 +258,10 @@ static inline
 void lttng_perf_unlock(void)
 {
 }
+static inline
+void lttng_perf_counter_prewarm(struct lttng_ctx *ctx)
+{
+}
 #endif /* #else #ifdef LTTNG_UST_HAVE_PERF_EVENT */
 
 #endif /* _LTTNG_TRACER_CORE_H */
@@ -38,6 +38,7 @@
  */
 
 #define _LGPL_SOURCE
+#include <limits.h>
 #include <lttng/ust-abi.h>
 #include <lttng/ust-error.h>
 #include <urcu/compiler.h>
@@ -628,6 +629,20 @@ long lttng_tracepoint_list_cmd(int objd, unsigned int cmd, unsigned long arg,
 		memcpy(tp, iter, sizeof(*tp));
 		return 0;
 	}
+	case LTTNG_UST_TRACEPOINT_LIST_GET_BULK:
+	{
+		const struct lttng_ust_tracepoint_iter *entries;
+		size_t count;
+
+		/* arg is the maximum number of entries. */
+		count = lttng_ust_tracepoint_list_get_bulk(list, &entries,
+				min_t(unsigned long, arg, INT_MAX));
+		if (!count)
+			return -LTTNG_UST_ERR_NOENT;
+		uargs->list_bulk.entries = entries;
+		uargs->list_bulk.len = count * sizeof(*entries);
+		return count;
+	}
 	default:
 		return -EINVAL;
 	}
@@ -707,6 +722,20 @@ long lttng_tracepoint_field_list_cmd(int objd, unsigned int cmd,
 		memcpy(tp, iter, sizeof(*tp));
 		return 0;
 	}
+	case LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK:
+	{
+		const struct lttng_ust_field_iter *entries;
+		size_t count;
+
+		/* arg is the maximum number of entries. */
+		count = lttng_ust_field_list_get_bulk(list, &entries,
+				min_t(unsigned long, arg, INT_MAX));
+		if (!count)
+			return -LTTNG_UST_ERR_NOENT;
+		uargs->list_bulk.entries = entries;
+		uargs->list_bulk.len = count * sizeof(*entries);
+		return count;
+	}
 	default:
 		return -EINVAL;
 	}
@@ -87,6 +87,9 @@ static int initialized;
  * ust_lock nests within the dynamic loader lock (within glibc) because
  * it is taken within the library constructor.
  *
+ * The dl state table mutex nests within ust_fork_mutex, and ust_mutex
+ * nests within it.
+ *
  * The ust fd tracker lock nests within the ust_mutex.
  */
 static pthread_mutex_t ust_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -338,6 +341,8 @@ static const char *cmd_name_mapping[] = {
 	/* Tracepoint list commands */
 	[ LTTNG_UST_TRACEPOINT_LIST_GET ] = "List Next Tracepoint",
 	[ LTTNG_UST_TRACEPOINT_FIELD_LIST_GET ] = "List Next Tracepoint Field",
+	[ LTTNG_UST_TRACEPOINT_LIST_GET_BULK ] = "List Next Tracepoints",
+	[ LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK ] = "List Next Tracepoint Fields",
 
 	/* Event FD commands */
 	[ LTTNG_UST_FILTER ] = "Create Filter",
@@ -347,6 +352,32 @@ static const char *cmd_name_mapping[] = {
 static const char *str_timeout;
 static int got_timeout_env;
 
+/*
+ * Fork registration jitter (LTTNG_UST_FORK_REGISTER_JITTER): -1 if
+ * disabled, otherwise the maximum delay, in ms, before the listener
+ * threads of a forked child register to the session daemon. The child
+ * does not wait for its registration, so the events it records before
+ * the registration completes are lost. Registering the configuration
+ * inherited from the parent in one batch would need session daemon
+ * protocol support; each child registers individually instead.
+ */
+static long fork_register_jitter_ms = -1;
+/* Set in a jittered fork child until lttng_ust_init() completes. */
+static int fork_jitter_child;
+/*
+ * Startup registration delay (LTTNG_UST_REGISTER_DELAY): delay, in ms,
+ * before registering to the session daemon. 0 if not set.
+ */
+static long startup_register_delay_ms;
+/* Delay, in ms, before the listener threads register. */
+static long register_delay_ms;
+/*
+ * Set when the initial listing of the loaded objects is left to the
+ * listener threads, after the registration delay. Cleared by the first
+ * listener thread which performs it.
+ */
+static int dl_update_deferred;
+
 extern void lttng_ring_buffer_client_overwrite_init(void);
 extern void lttng_ring_buffer_client_overwrite_rt_init(void);
 extern void lttng_ring_buffer_client_discard_init(void);
@@ -433,6 +464,7 @@ void lttng_ust_fixup_tls(void)
 	lttng_fixup_ipc_ns_tls();
 	lttng_fixup_net_ns_tls();
 	lttng_fixup_uts_ns_tls();
+	lttng_fixup_callstack_tls();
 }
 
 int lttng_get_notify_socket(void *owner)
@@ -604,6 +636,50 @@ int get_constructor_timeout(struct timespec *constructor_timeout)
 	return 1;
 }
 
+static
+void get_fork_register_jitter(void)
+{
+	const char *str_jitter = lttng_getenv("LTTNG_UST_FORK_REGISTER_JITTER");
+
+	if (!str_jitter) {
+		fork_register_jitter_ms = -1;
+		return;
+	}
+	fork_register_jitter_ms = strtol(str_jitter, NULL, 10);
+	if (fork_register_jitter_ms < 0)
+		fork_register_jitter_ms = 0;
+}
+
+static
+void get_startup_register_delay(void)
+{
+	const char *str_delay = lttng_getenv("LTTNG_UST_REGISTER_DELAY");
+
+	startup_register_delay_ms = 0;
+	if (str_delay)
+		startup_register_delay_ms = strtol(str_delay, NULL, 10);
+	if (startup_register_delay_ms < 0)
+		startup_register_delay_ms = 0;
+}
+
+/*
+ * Spread the registration of the children forked at once by a pre-fork
+ * server over the configured delay, rather than having all of them
+ * connect to the session daemon at the same time.
+ *
+ * A startup registration delay postpones the registration of the
+ * process, which is not traced at all if it exits before the delay
+ * expires.
+ */
+static
+long get_register_delay(void)
+{
+	if (fork_jitter_child && fork_register_jitter_ms > 0)
+		return ((unsigned long) getpid() * 2654435761UL)
+			% (unsigned long) fork_register_jitter_ms;
+	return startup_register_delay_ms;
+}
+
 static
 void get_allow_blocking(void)
 {
@@ -964,6 +1040,15 @@ int handle_message(struct sock_info *sock_info,
 			ret = -ENOSYS;
 		break;
 	}
+	case LTTNG_UST_TRACEPOINT_LIST_GET_BULK:
+	case LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK:
+		if (ops->cmd)
+			ret = ops->cmd(lum->handle, lum->cmd,
+					(unsigned long) lum->u.list_bulk.max_count,
+					&args, sock_info);
+		else
+			ret = -ENOSYS;
+		break;
 	case LTTNG_UST_CONTEXT:
 		switch (lum->u.context.ctx) {
 		case LTTNG_UST_CONTEXT_APP_CONTEXT:
@@ -1104,7 +1189,7 @@ int handle_message(struct sock_info *sock_info,
 
 	/*
 	 * LTTNG_UST_TRACEPOINT_FIELD_LIST_GET needs to send the field
-	 * after the reply.
+	 * after the reply, and the bulk list commands the entries.
 	 */
 	if (lur.ret_code == LTTNG_UST_OK) {
 		switch (lum->cmd) {
@@ -1120,6 +1205,21 @@ int handle_message(struct sock_info *sock_info,
 				ret = -EINVAL;
 				goto error;
 			}
+			break;
+		case LTTNG_UST_TRACEPOINT_LIST_GET_BULK:
+		case LTTNG_UST_TRACEPOINT_FIELD_LIST_GET_BULK:
+			len = ustcomm_send_unix_sock(sock,
+				args.list_bulk.entries,
+				args.list_bulk.len);
+			if (len < 0) {
+				ret = len;
+				goto error;
+			}
+			if (len != (ssize_t) args.list_bulk.len) {
+				ret = -EINVAL;
+				goto error;
+			}
+			break;
 		}
 	}
 
@@ -1487,6 +1587,17 @@ void *ust_listener_thread(void *arg)
 		ERR("Unable to set UST process name");
 	}
 
+	if (register_delay_ms) {
+		struct timespec delay = {
+			.tv_sec = register_delay_ms / 1000,
+			.tv_nsec = (register_delay_ms % 1000) * 1000000L,
+		};
+
+		(void) nanosleep(&delay, NULL);
+		if (uatomic_xchg(&dl_update_deferred, 0))
+			lttng_ust_dl_update(LTTNG_UST_CALLER_IP());
+	}
+
 	/* Restart trying to connect to the session daemon */
 restart:
 	if (prev_connect_failed) {
@@ -1841,19 +1952,41 @@ void __attribute__((constructor)) lttng_ust_init(void)
 	lttng_ust_init_fd_tracker();
 	lttng_ust_clock_init();
 	lttng_ust_getcpu_init();
-	lttng_ust_statedump_init();
+	get_fork_register_jitter();
+	get_startup_register_delay();
+	register_delay_ms = get_register_delay();
+	/*
+	 * A jittered fork child keeps the base address state of its parent.
+	 * Otherwise, when the registration is delayed, listing the loaded
+	 * objects is left to the listener threads, which a process
+	 * exiting before the delay expires never does.
+	 */
+	if (!fork_jitter_child) {
+		dl_update_deferred = register_delay_ms > 0;
+		lttng_ust_statedump_init(!dl_update_deferred);
+	}
 	lttng_ring_buffer_metadata_client_init();
 	lttng_ring_buffer_client_overwrite_init();
 	lttng_ring_buffer_client_overwrite_rt_init();
 	lttng_ring_buffer_client_discard_init();
 	lttng_ring_buffer_client_discard_rt_init();
 	lttng_perf_counter_init();
+	lttng_context_cache_init();
 	/*
 	 * Invoke ust malloc wrapper init before starting other threads.
 	 */
 	lttng_ust_malloc_wrapper_init();
 
-	timeout_mode = get_constructor_timeout(&constructor_timeout);
+	/*
+	 * A jittered fork child or a process with a startup registration
+	 * delay does not wait for its registration: the application
+	 * proceeds right away.
+	 */
+	if (fork_jitter_child || startup_register_delay_ms)
+		timeout_mode = 0;
+	else
+		timeout_mode = get_constructor_timeout(&constructor_timeout);
+	fork_jitter_child = 0;
 
 	get_allow_blocking();
 
@@ -1992,7 +2125,8 @@ void lttng_ust_cleanup(int exiting)
 	lttng_ring_buffer_client_overwrite_rt_exit();
 	lttng_ring_buffer_client_overwrite_exit();
 	lttng_ring_buffer_metadata_client_exit();
-	lttng_ust_statedump_destroy();
+	if (exiting || !fork_jitter_child)
+		lttng_ust_statedump_destroy();
 	exit_tracepoint();
 	if (!exiting) {
 		/* Reinitialize values for fork */
@@ -2114,6 +2248,7 @@ void ust_before_fork(sigset_t *save_sigset)
 
 	pthread_mutex_lock(&ust_fork_mutex);
 
+	lttng_ust_lock_dl_state();
 	ust_lock_nocheck();
 	urcu_bp_before_fork();
 	lttng_ust_lock_fd_tracker();
@@ -2128,6 +2263,7 @@ static void ust_after_fork_common(sigset_t *restore_sigset)
 	lttng_perf_unlock();
 	lttng_ust_unlock_fd_tracker();
 	ust_unlock();
+	lttng_ust_unlock_dl_state();
 
 	pthread_mutex_unlock(&ust_fork_mutex);
 
@@ -2156,6 +2292,12 @@ void ust_after_fork_parent(sigset_t *restore_sigset)
  *
  * This is meant for forks() that have tracing in the child between the
  * fork and following exec call (if there is any).
+ *
+ * With a fork registration jitter, the child keeps the state which does
+ * not depend on the PID (the base address table of the statedump), and
+ * registers in the background after a delay derived from its PID,
+ * without delaying the return of fork(). Each child still registers
+ * individually: the jitter only spreads the registrations over time.
  */
 void ust_after_fork_child(sigset_t *restore_sigset)
 {
@@ -2164,12 +2306,16 @@ void ust_after_fork_child(sigset_t *restore_sigset)
 	lttng_context_vpid_reset();
 	lttng_context_vtid_reset();
 	lttng_context_procname_reset();
+	lttng_context_procname_after_fork_child();
 	ust_context_ns_reset();
 	ust_context_vuids_reset();
 	ust_context_vgids_reset();
 	DBG("process %d", getpid());
 	/* Release urcu mutexes */
 	urcu_bp_after_fork_child();
+	lttng_ust_fd_tracker_after_fork_child();
+	if (fork_register_jitter_ms >= 0)
+		fork_jitter_child = 1;
 	lttng_ust_cleanup(0);
 	/* Release mutexes and reenable signals */
 	ust_after_fork_common(restore_sigset);
@@ -24,55 +24,136 @@
 #include <lttng/ust-elf.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <urcu/hlist.h>
+#include <urcu/list.h>
 #include <ust-fd.h>
 #include "lttng-tracer-core.h"
-
-#define BUF_LEN	4096
+#include "jhash.h"
 
 #ifndef NT_GNU_BUILD_ID
 # define NT_GNU_BUILD_ID	3
 #endif
 
 /*
- * Retrieve the nth (where n is the `index` argument) phdr (program
- * header) from the given elf instance.
+ * Cache of the ELF metadata of the files loaded by the process, keyed
+ * by the identity (device, inode, size and modification time) of the opened
+ * file, so an object which is loaded again, or whose load is reported
+ * both by the dl instrumentation and the statedump, is parsed only
+ * once.
+ *
+ * The cache holds at most ELF_INFO_CACHE_MAX_ENTRIES entries; the
+ * least recently used one is evicted beyond that. Entries are
+ * reference counted, so an evicted entry stays valid until its last
+ * user releases it with lttng_ust_elf_put_info().
+ */
+#define ELF_INFO_CACHE_HASH_BITS	6
+#define ELF_INFO_CACHE_SIZE		(1 << ELF_INFO_CACHE_HASH_BITS)
+#define ELF_INFO_CACHE_MAX_ENTRIES	256
+
+struct elf_info_cache_node {
+	struct lttng_ust_elf_info info;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	unsigned int refcount;		/* Protected by elf_info_cache_mutex. */
+	struct cds_hlist_node node;
+	struct cds_list_head lru_node;
+};
+
+static struct cds_hlist_head elf_info_cache[ELF_INFO_CACHE_SIZE];
+static CDS_LIST_HEAD(elf_info_cache_lru);
+static unsigned int elf_info_cache_nr_entries;
+static pthread_mutex_t elf_info_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Private part of an lttng_ust_elf instance, kept out of the installed
+ * header so the layout of struct lttng_ust_elf does not change.
+ */
+struct lttng_ust_elf_private {
+	struct lttng_ust_elf pub;
+	/* Size in bytes of the file. */
+	uint64_t len;
+	/* Section names string table, read from the file. */
+	char *section_names;
+};
+
+static inline
+struct lttng_ust_elf_private *elf_priv(struct lttng_ust_elf *elf)
+{
+	return caa_container_of(elf, struct lttng_ust_elf_private, pub);
+}
+
+/*
+ * Read `len` bytes located at `offset` within the ELF file into `buf`.
  *
- * A pointer to the phdr is returned on success, NULL on failure.
+ * The file is read rather than mapped: a file truncated or rewritten
+ * concurrently (e.g. by a package upgrade) makes the read fail, where
+ * accessing a mapping would raise SIGBUS in the application.
+ *
+ * Returns 0 on success, -1 if the range is not entirely contained in
+ * the file or on read error.
  */
 static
-struct lttng_ust_elf_phdr *lttng_ust_elf_get_phdr(struct lttng_ust_elf *elf,
-						uint16_t index)
+int lttng_ust_elf_read(struct lttng_ust_elf *elf, uint64_t offset,
+		void *buf, uint64_t len)
 {
-	struct lttng_ust_elf_phdr *phdr = NULL;
-	off_t offset;
+	uint64_t file_len = elf_priv(elf)->len;
+	char *dst = buf;
 
-	if (!elf) {
-		goto error;
+	if (offset > file_len || len > file_len - offset) {
+		return -1;
 	}
+	while (len) {
+		ssize_t ret;
 
-	if (index >= elf->ehdr->e_phnum) {
-		goto error;
+		ret = pread(elf->fd, dst, len, offset);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			return -1;
+		}
+		dst += ret;
+		offset += ret;
+		len -= ret;
 	}
+	return 0;
+}
+
+/*
+ * Retrieve the nth (where n is the `index` argument) phdr (program
+ * header) from the given elf instance into `phdr`.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static
+int lttng_ust_elf_get_phdr(struct lttng_ust_elf *elf, uint16_t index,
+			struct lttng_ust_elf_phdr *phdr)
+{
+	uint64_t offset;
 
-	phdr = zmalloc(sizeof(struct lttng_ust_elf_phdr));
-	if (!phdr) {
+	if (!elf) {
 		goto error;
 	}
 
-	offset = (off_t) elf->ehdr->e_phoff
-			+ (off_t) index * elf->ehdr->e_phentsize;
-	if (lseek(elf->fd, offset, SEEK_SET) < 0) {
+	if (index >= elf->ehdr->e_phnum) {
 		goto error;
 	}
 
+	offset = elf->ehdr->e_phoff
+			+ (uint64_t) index * elf->ehdr->e_phentsize;
+
 	if (is_elf_32_bit(elf)) {
 		Elf32_Phdr elf_phdr;
 
-		if (lttng_ust_read(elf->fd, &elf_phdr, sizeof(elf_phdr))
-				< sizeof(elf_phdr)) {
+		if (lttng_ust_elf_read(elf, offset, &elf_phdr,
+				sizeof(elf_phdr))) {
 			goto error;
 		}
 		if (!is_elf_native_endian(elf)) {
@@ -82,8 +163,8 @@ struct lttng_ust_elf_phdr *lttng_ust_elf_get_phdr(struct lttng_ust_elf *elf,
 	} else {
 		Elf64_Phdr elf_phdr;
 
-		if (lttng_ust_read(elf->fd, &elf_phdr, sizeof(elf_phdr))
-				< sizeof(elf_phdr)) {
+		if (lttng_ust_elf_read(elf, offset, &elf_phdr,
+				sizeof(elf_phdr))) {
 			goto error;
 		}
 		if (!is_elf_native_endian(elf)) {
@@ -92,25 +173,23 @@ struct lttng_ust_elf_phdr *lttng_ust_elf_get_phdr(struct lttng_ust_elf *elf,
 		copy_phdr(elf_phdr, *phdr);
 	}
 
-	return phdr;
+	return 0;
 
 error:
-	free(phdr);
-	return NULL;
+	return -1;
 }
 
 /*
  * Retrieve the nth (where n is the `index` argument) shdr (section
- * header) from the given elf instance.
+ * header) from the given elf instance into `shdr`.
  *
- * A pointer to the shdr is returned on success, NULL on failure.
+ * Returns 0 on success, -1 on failure.
  */
 static
-struct lttng_ust_elf_shdr *lttng_ust_elf_get_shdr(struct lttng_ust_elf *elf,
-						uint16_t index)
+int lttng_ust_elf_get_shdr(struct lttng_ust_elf *elf, uint16_t index,
+			struct lttng_ust_elf_shdr *shdr)
 {
-	struct lttng_ust_elf_shdr *shdr = NULL;
-	off_t offset;
+	uint64_t offset;
 
 	if (!elf) {
 		goto error;
@@ -120,22 +199,14 @@ struct lttng_ust_elf_shdr *lttng_ust_elf_get_shdr(struct lttng_ust_elf *elf,
 		goto error;
 	}
 
-	shdr = zmalloc(sizeof(struct lttng_ust_elf_shdr));
-	if (!shdr) {
-		goto error;
-	}
-
-	offset = (off_t) elf->ehdr->e_shoff
-			+ (off_t) index * elf->ehdr->e_shentsize;
-	if (lseek(elf->fd, offset, SEEK_SET) < 0) {
-		goto error;
-	}
+	offset = elf->ehdr->e_shoff
+			+ (uint64_t) index * elf->ehdr->e_shentsize;
 
 	if (is_elf_32_bit(elf)) {
 		Elf32_Shdr elf_shdr;
 
-		if (lttng_ust_read(elf->fd, &elf_shdr, sizeof(elf_shdr))
-				< sizeof(elf_shdr)) {
+		if (lttng_ust_elf_read(elf, offset, &elf_shdr,
+				sizeof(elf_shdr))) {
 			goto error;
 		}
 		if (!is_elf_native_endian(elf)) {
@@ -145,8 +216,8 @@ struct lttng_ust_elf_shdr *lttng_ust_elf_get_shdr(struct lttng_ust_elf *elf,
 	} else {
 		Elf64_Shdr elf_shdr;
 
-		if (lttng_ust_read(elf->fd, &elf_shdr, sizeof(elf_shdr))
-				< sizeof(elf_shdr)) {
+		if (lttng_ust_elf_read(elf, offset, &elf_shdr,
+				sizeof(elf_shdr))) {
 			goto error;
 		}
 		if (!is_elf_native_endian(elf)) {
@@ -155,11 +226,10 @@ struct lttng_ust_elf_shdr *lttng_ust_elf_get_shdr(struct lttng_ust_elf *elf,
 		copy_shdr(elf_shdr, *shdr);
 	}
 
-	return shdr;
+	return 0;
 
 error:
-	free(shdr);
-	return NULL;
+	return -1;
 }
 
 /*
@@ -167,13 +237,15 @@ error:
  * sh_name value) in bytes relative to the beginning of the section
  * names string table.
  *
- * If no name is found, NULL is returned.
+ * The returned name points within the string table read by
+ * lttng_ust_elf_create(). If no name is found, or if it is not
+ * terminated within the string table, NULL is returned.
  */
 static
-char *lttng_ust_elf_get_section_name(struct lttng_ust_elf *elf, off_t offset)
+const char *lttng_ust_elf_get_section_name(struct lttng_ust_elf *elf,
+					uint64_t offset)
 {
-	char *name = NULL;
-	size_t len = 0, to_read;	/* len does not include \0 */
+	const char *name;
 
 	if (!elf) {
 		goto error;
@@ -183,111 +255,107 @@ char *lttng_ust_elf_get_section_name(struct lttng_ust_elf *elf, off_t offset)
 		goto error;
 	}
 
-	if (lseek(elf->fd, elf->section_names_offset + offset, SEEK_SET) < 0) {
-		goto error;
-	}
-
-	to_read = elf->section_names_size - offset;
-
-	/* Find first \0 after or at current location, remember len. */
-	for (;;) {
-		char buf[BUF_LEN];
-		ssize_t read_len;
-		size_t i;
-
-		if (!to_read) {
-			goto error;
-		}
-		read_len = lttng_ust_read(elf->fd, buf,
-			min_t(size_t, BUF_LEN, to_read));
-		if (read_len <= 0) {
-			goto error;
-		}
-		for (i = 0; i < read_len; i++) {
-			if (buf[i] == '\0') {
-				len += i;
-				goto end;
-			}
-		}
-		len += read_len;
-		to_read -= read_len;
-	}
-end:
-	name = zmalloc(sizeof(char) * (len + 1));	/* + 1 for \0 */
-	if (!name) {
-		goto error;
-	}
-	if (lseek(elf->fd, elf->section_names_offset + offset,
-		SEEK_SET) < 0) {
-		goto error;
-	}
-	if (lttng_ust_read(elf->fd, name, len + 1) < len + 1) {
+	name = elf_priv(elf)->section_names + offset;
+	if (!memchr(name, '\0', elf->section_names_size - offset)) {
 		goto error;
 	}
 
 	return name;
 
 error:
-	free(name);
 	return NULL;
 }
 
 /*
- * Create an instance of lttng_ust_elf for the ELF file located at
- * `path`.
+ * Open the file located at `path` read-only, and add the file
+ * descriptor to the fd tracker.
  *
- * Return a pointer to the instance on success, NULL on failure.
+ * Return the file descriptor on success, -1 on failure.
  */
-struct lttng_ust_elf *lttng_ust_elf_create(const char *path)
+static
+int lttng_ust_elf_open(const char *path)
 {
-	uint8_t e_ident[EI_NIDENT];
-	struct lttng_ust_elf_shdr *section_names_shdr;
-	struct lttng_ust_elf *elf = NULL;
 	int ret, fd;
 
-	elf = zmalloc(sizeof(struct lttng_ust_elf));
-	if (!elf) {
-		goto error;
-	}
-
-	/* Initialize fd field to -1. 0 is a valid fd number */
-	elf->fd = -1;
-
-	elf->path = strdup(path);
-	if (!elf->path) {
-		goto error;
-	}
-
 	lttng_ust_lock_fd_tracker();
-	fd = open(elf->path, O_RDONLY | O_CLOEXEC);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
 	if (fd < 0) {
 		lttng_ust_unlock_fd_tracker();
-		goto error;
+		return -1;
 	}
 
 	ret = lttng_ust_add_fd_to_tracker(fd);
 	if (ret < 0) {
 		ret = close(fd);
 		if (ret) {
-			PERROR("close on elf->fd");
+			PERROR("close on elf fd");
 		}
-		ret = -1;
 		lttng_ust_unlock_fd_tracker();
-		goto error;
+		return -1;
 	}
-	elf->fd = ret;
 	lttng_ust_unlock_fd_tracker();
+	return ret;
+}
 
-	if (lttng_ust_read(elf->fd, e_ident, EI_NIDENT) < EI_NIDENT) {
+/*
+ * Close a file descriptor returned by lttng_ust_elf_open().
+ */
+static
+void lttng_ust_elf_close(int fd)
+{
+	int ret;
+
+	lttng_ust_lock_fd_tracker();
+	ret = close(fd);
+	if (!ret) {
+		lttng_ust_delete_fd_from_tracker(fd);
+	} else {
+		PERROR("close");
+		abort();
+	}
+	lttng_ust_unlock_fd_tracker();
+}
+
+/*
+ * Create an instance of lttng_ust_elf for the ELF file located at
+ * `path`, opened as `fd` by lttng_ust_elf_open() and of size
+ * `len`. The instance owns `fd`, which is closed on failure. Its
+ * section names string table is read once.
+ *
+ * Return a pointer to the instance on success, NULL on failure.
+ */
+static
+struct lttng_ust_elf *lttng_ust_elf_create_fd(const char *path, int fd,
+		uint64_t len)
+{
+	uint8_t e_ident[EI_NIDENT];
+	struct lttng_ust_elf_shdr section_names_shdr;
+	struct lttng_ust_elf_private *priv;
+	struct lttng_ust_elf *elf = NULL;
+
+	priv = zmalloc(sizeof(struct lttng_ust_elf_private));
+	if (!priv) {
+		lttng_ust_elf_close(fd);
 		goto error;
 	}
-	elf->bitness = e_ident[EI_CLASS];
-	elf->endianness = e_ident[EI_DATA];
+	elf = &priv->pub;
+	elf->fd = fd;
+	priv->len = len;
 
-	if (lseek(elf->fd, 0, SEEK_SET) < 0) {
+	elf->path = strdup(path);
+	if (!elf->path) {
 		goto error;
 	}
 
+	if (lttng_ust_elf_read(elf, 0, e_ident, EI_NIDENT)) {
+		goto error;
+	}
+	if (memcmp(e_ident, ELFMAG, SELFMAG) != 0) {
+		goto error;
+	}
+	elf->bitness = e_ident[EI_CLASS];
+	elf->endianness = e_ident[EI_DATA];
+
 	elf->ehdr = zmalloc(sizeof(struct lttng_ust_elf_ehdr));
 	if (!elf->ehdr) {
 		goto error;
@@ -296,8 +364,7 @@ struct lttng_ust_elf *lttng_ust_elf_create(const char *path)
 	if (is_elf_32_bit(elf)) {
 		Elf32_Ehdr elf_ehdr;
 
-		if (lttng_ust_read(elf->fd, &elf_ehdr, sizeof(elf_ehdr))
-				< sizeof(elf_ehdr)) {
+		if (lttng_ust_elf_read(elf, 0, &elf_ehdr, sizeof(elf_ehdr))) {
 			goto error;
 		}
 		if (!is_elf_native_endian(elf)) {
@@ -307,8 +374,7 @@ struct lttng_ust_elf *lttng_ust_elf_create(const char *path)
 	} else {
 		Elf64_Ehdr elf_ehdr;
 
-		if (lttng_ust_read(elf->fd, &elf_ehdr, sizeof(elf_ehdr))
-				< sizeof(elf_ehdr)) {
+		if (lttng_ust_elf_read(elf, 0, &elf_ehdr, sizeof(elf_ehdr))) {
 			goto error;
 		}
 		if (!is_elf_native_endian(elf)) {
@@ -317,15 +383,26 @@ struct lttng_ust_elf *lttng_ust_elf_create(const char *path)
 		copy_ehdr(elf_ehdr, *(elf->ehdr));
 	}
 
-	section_names_shdr = lttng_ust_elf_get_shdr(elf, elf->ehdr->e_shstrndx);
-	if (!section_names_shdr) {
+	if (lttng_ust_elf_get_shdr(elf, elf->ehdr->e_shstrndx,
+			&section_names_shdr)) {
 		goto error;
 	}
 
-	elf->section_names_offset = section_names_shdr->sh_offset;
-	elf->section_names_size = section_names_shdr->sh_size;
+	/* Bounded by the file size, checked by lttng_ust_elf_read(). */
+	if (section_names_shdr.sh_size > priv->len) {
+		goto error;
+	}
+	priv->section_names = zmalloc(section_names_shdr.sh_size);
+	if (!priv->section_names) {
+		goto error;
+	}
+	if (lttng_ust_elf_read(elf, section_names_shdr.sh_offset,
+			priv->section_names, section_names_shdr.sh_size)) {
+		goto error;
+	}
+	elf->section_names_offset = section_names_shdr.sh_offset;
+	elf->section_names_size = section_names_shdr.sh_size;
 
-	free(section_names_shdr);
 	return elf;
 
 error:
@@ -333,6 +410,29 @@ error:
 	return NULL;
 }
 
+/*
+ * Create an instance of lttng_ust_elf for the ELF file located at
+ * `path`. The file stays open for the lifetime of the instance, and
+ * its section names string table is read once.
+ *
+ * Return a pointer to the instance on success, NULL on failure.
+ */
+struct lttng_ust_elf *lttng_ust_elf_create(const char *path)
+{
+	struct stat st;
+	int fd;
+
+	fd = lttng_ust_elf_open(path);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (fstat(fd, &st)) {
+		lttng_ust_elf_close(fd);
+		return NULL;
+	}
+	return lttng_ust_elf_create_fd(path, fd, st.st_size);
+}
+
 /*
  * Test whether the ELF file is position independent code (PIC)
  */
@@ -350,27 +450,18 @@ uint8_t lttng_ust_elf_is_pic(struct lttng_ust_elf *elf)
  */
 void lttng_ust_elf_destroy(struct lttng_ust_elf *elf)
 {
-	int ret;
-
 	if (!elf) {
 		return;
 	}
 
 	if (elf->fd >= 0) {
-		lttng_ust_lock_fd_tracker();
-		ret = close(elf->fd);
-		if (!ret) {
-			lttng_ust_delete_fd_from_tracker(elf->fd);
-		} else {
-			PERROR("close");
-			abort();
-		}
-		lttng_ust_unlock_fd_tracker();
+		lttng_ust_elf_close(elf->fd);
 	}
 
+	free(elf_priv(elf)->section_names);
 	free(elf->ehdr);
 	free(elf->path);
-	free(elf);
+	free(elf_priv(elf));
 }
 
 /*
@@ -389,10 +480,9 @@ int lttng_ust_elf_get_memsz(struct lttng_ust_elf *elf, uint64_t *memsz)
 	}
 
 	for (i = 0; i < elf->ehdr->e_phnum; ++i) {
-		struct lttng_ust_elf_phdr *phdr;
+		struct lttng_ust_elf_phdr phdr;
 
-		phdr = lttng_ust_elf_get_phdr(elf, i);
-		if (!phdr) {
+		if (lttng_ust_elf_get_phdr(elf, i, &phdr)) {
 			goto error;
 		}
 
@@ -400,15 +490,13 @@ int lttng_ust_elf_get_memsz(struct lttng_ust_elf *elf, uint64_t *memsz)
 		 * Only PT_LOAD segments contribute to memsz. Skip
 		 * other segments.
 		 */
-		if (phdr->p_type != PT_LOAD) {
-			goto next_loop;
+		if (phdr.p_type != PT_LOAD) {
+			continue;
 		}
 
-		low_addr = min_t(uint64_t, low_addr, phdr->p_vaddr);
+		low_addr = min_t(uint64_t, low_addr, phdr.p_vaddr);
 		high_addr = max_t(uint64_t, high_addr,
-				phdr->p_vaddr + phdr->p_memsz);
-	next_loop:
-		free(phdr);
+				phdr.p_vaddr + phdr.p_memsz);
 	}
 
 	if (high_addr < low_addr) {
@@ -437,30 +525,23 @@ error:
 static
 int lttng_ust_elf_get_build_id_from_segment(
 	struct lttng_ust_elf *elf, uint8_t **build_id, size_t *length,
-	off_t offset, off_t segment_end)
+	uint64_t offset, uint64_t segment_end)
 {
 	uint8_t *_build_id = NULL;	/* Silence old gcc warning. */
 	size_t _length = 0;		/* Silence old gcc warning. */
 
 	while (offset < segment_end) {
 		struct lttng_ust_elf_nhdr nhdr;
-		size_t read_len;
 
 		/* Align start of note entry */
 		offset += offset_align(offset, ELF_NOTE_ENTRY_ALIGN);
 		if (offset >= segment_end) {
 			break;
 		}
-		/*
-		 * We seek manually because if the note isn't the
-		 * build id the data following the header will not
-		 * have been read.
-		 */
-		if (lseek(elf->fd, offset, SEEK_SET) < 0) {
+		if (segment_end - offset < sizeof(nhdr)) {
 			goto error;
 		}
-		if (lttng_ust_read(elf->fd, &nhdr, sizeof(nhdr))
-				< sizeof(nhdr)) {
+		if (lttng_ust_elf_read(elf, offset, &nhdr, sizeof(nhdr))) {
 			goto error;
 		}
 
@@ -483,17 +564,17 @@ int lttng_ust_elf_get_build_id_from_segment(
 			continue;
 		}
 
+		if (offset > segment_end
+				|| nhdr.n_descsz > segment_end - offset) {
+			goto error;
+		}
 		_length = nhdr.n_descsz;
 		_build_id = zmalloc(sizeof(uint8_t) * _length);
 		if (!_build_id) {
 			goto error;
 		}
-
-		if (lseek(elf->fd, offset, SEEK_SET) < 0) {
-			goto error;
-		}
-		read_len = sizeof(*_build_id) * _length;
-		if (lttng_ust_read(elf->fd, _build_id, read_len) < read_len) {
+		if (lttng_ust_elf_read(elf, offset, _build_id,
+				sizeof(*_build_id) * _length)) {
 			goto error;
 		}
 
@@ -536,26 +617,23 @@ int lttng_ust_elf_get_build_id(struct lttng_ust_elf *elf, uint8_t **build_id,
 	}
 
 	for (i = 0; i < elf->ehdr->e_phnum; ++i) {
-		off_t offset, segment_end;
-		struct lttng_ust_elf_phdr *phdr;
-		int ret = 0;
+		uint64_t offset, segment_end;
+		struct lttng_ust_elf_phdr phdr;
+		int ret;
 
-		phdr = lttng_ust_elf_get_phdr(elf, i);
-		if (!phdr) {
+		if (lttng_ust_elf_get_phdr(elf, i, &phdr)) {
 			goto error;
 		}
 
 		/* Build ID will be contained in a PT_NOTE segment. */
-		if (phdr->p_type != PT_NOTE) {
-			goto next_loop;
+		if (phdr.p_type != PT_NOTE) {
+			continue;
 		}
 
-		offset = phdr->p_offset;
-		segment_end = offset + phdr->p_filesz;
+		offset = phdr.p_offset;
+		segment_end = offset + phdr.p_filesz;
 		ret = lttng_ust_elf_get_build_id_from_segment(
 			elf, &_build_id, &_length, offset, segment_end);
-	next_loop:
-		free(phdr);
 		if (ret) {
 			goto error;
 		}
@@ -588,13 +666,14 @@ error:
  *
  * Returns 0 on success, -1 if an error occurred.
  */
+static
 int lttng_ust_elf_get_debug_link_from_section(struct lttng_ust_elf *elf,
 					char **filename, uint32_t *crc,
 					struct lttng_ust_elf_shdr *shdr)
 {
 	char *_filename = NULL;		/* Silence old gcc warning. */
 	size_t filename_len;
-	char *section_name = NULL;
+	const char *section_name;
 	uint32_t _crc = 0;		/* Silence old gcc warning. */
 
 	if (!elf || !filename || !crc || !shdr) {
@@ -618,22 +697,23 @@ int lttng_ust_elf_get_debug_link_from_section(struct lttng_ust_elf *elf,
 		goto end;
 	}
 
+	if (shdr->sh_size < ELF_CRC_SIZE || shdr->sh_size > elf_priv(elf)->len) {
+		goto error;
+	}
+
 	/*
 	 * The length of the filename is the sh_size excluding the CRC
-	 * which comes after it in the section.
+	 * which comes after it in the section. Allocate one more byte
+	 * so the filename is terminated even if the section is not.
 	 */
-	_filename = zmalloc(sizeof(char) * (shdr->sh_size - ELF_CRC_SIZE));
-	if (!_filename) {
-		goto error;
-	}
-	if (lseek(elf->fd, shdr->sh_offset, SEEK_SET) < 0) {
-		goto error;
-	}
 	filename_len = sizeof(*_filename) * (shdr->sh_size - ELF_CRC_SIZE);
-	if (lttng_ust_read(elf->fd, _filename, filename_len) < filename_len) {
+	_filename = zmalloc(filename_len + 1);
+	if (!_filename) {
 		goto error;
 	}
-	if (lttng_ust_read(elf->fd, &_crc, sizeof(_crc)) < sizeof(_crc)) {
+	if (lttng_ust_elf_read(elf, shdr->sh_offset, _filename, filename_len)
+			|| lttng_ust_elf_read(elf, shdr->sh_offset + filename_len,
+				&_crc, sizeof(_crc))) {
 		goto error;
 	}
 	if (!is_elf_native_endian(elf)) {
@@ -641,7 +721,6 @@ int lttng_ust_elf_get_debug_link_from_section(struct lttng_ust_elf *elf,
 	}
 
 end:
-	free(section_name);
 	if (_filename) {
 		*filename = _filename;
 		*crc = _crc;
@@ -651,7 +730,6 @@ end:
 
 error:
 	free(_filename);
-	free(section_name);
 	return -1;
 }
 
@@ -678,17 +756,14 @@ int lttng_ust_elf_get_debug_link(struct lttng_ust_elf *elf, char **filename,
 	}
 
 	for (i = 0; i < elf->ehdr->e_shnum; ++i) {
-		struct lttng_ust_elf_shdr *shdr = NULL;
+		struct lttng_ust_elf_shdr shdr;
 
-		shdr = lttng_ust_elf_get_shdr(elf, i);
-		if (!shdr) {
+		if (lttng_ust_elf_get_shdr(elf, i, &shdr)) {
 			goto error;
 		}
 
 		ret = lttng_ust_elf_get_debug_link_from_section(
-			elf, &_filename, &_crc, shdr);
-		free(shdr);
-
+			elf, &_filename, &_crc, &shdr);
 		if (ret) {
 			goto error;
 		}
@@ -711,3 +786,199 @@ error:
 	free(_filename);
 	return -1;
 }
+
+static
+struct cds_hlist_head *get_elf_info_cache_head(const struct stat *st)
+{
+	uint32_t hash;
+
+	hash = jhash(&st->st_ino, sizeof(st->st_ino), (uint32_t) st->st_dev);
+	return &elf_info_cache[hash & (ELF_INFO_CACHE_SIZE - 1)];
+}
+
+static
+struct elf_info_cache_node *elf_info_cache_lookup(const struct stat *st)
+{
+	struct elf_info_cache_node *e;
+
+	cds_hlist_for_each_entry_2(e, get_elf_info_cache_head(st), node) {
+		if (e->dev == st->st_dev && e->ino == st->st_ino
+				&& e->size == st->st_size
+				&& e->mtime.tv_sec == st->st_mtim.tv_sec
+				&& e->mtime.tv_nsec == st->st_mtim.tv_nsec)
+			return e;
+	}
+	return NULL;
+}
+
+static
+void free_elf_info_cache_node(struct elf_info_cache_node *e)
+{
+	free(e->info.build_id);
+	free(e->info.dbg_file);
+	free(e);
+}
+
+/*
+ * Parse the ELF metadata of the already opened `elf`, whose file
+ * identity is `st`. The returned node holds a single reference.
+ */
+static
+struct elf_info_cache_node *alloc_elf_info_cache_node(struct lttng_ust_elf *elf,
+		const struct stat *st)
+{
+	struct elf_info_cache_node *e;
+	int found;
+
+	e = zmalloc(sizeof(*e));
+	if (!e)
+		return NULL;
+	e->dev = st->st_dev;
+	e->ino = st->st_ino;
+	e->size = st->st_size;
+	e->mtime = st->st_mtim;
+	e->refcount = 1;
+
+	if (lttng_ust_elf_get_memsz(elf, &e->info.memsz))
+		goto error;
+	found = 0;
+	if (lttng_ust_elf_get_build_id(elf, &e->info.build_id,
+			&e->info.build_id_len, &found))
+		goto error;
+	e->info.has_build_id = !!found;
+	found = 0;
+	if (lttng_ust_elf_get_debug_link(elf, &e->info.dbg_file,
+			&e->info.crc, &found))
+		goto error;
+	e->info.has_debug_link = !!found;
+	e->info.is_pic = lttng_ust_elf_is_pic(elf);
+	return e;
+
+error:
+	free_elf_info_cache_node(e);
+	return NULL;
+}
+
+/*
+ * Drop a reference on `e`. Returns the node if it must be freed by the
+ * caller once the cache mutex is released. Called with the cache mutex
+ * held.
+ */
+static
+struct elf_info_cache_node *elf_info_cache_node_put(struct elf_info_cache_node *e)
+{
+	if (--e->refcount)
+		return NULL;
+	return e;
+}
+
+/*
+ * Insert `e` in the cache, which takes its own reference, and evict
+ * the least recently used entry if the cache is full. Returns the
+ * evicted node if it must be freed by the caller once the cache mutex
+ * is released. Called with the cache mutex held.
+ */
+static
+struct elf_info_cache_node *elf_info_cache_insert(struct elf_info_cache_node *e,
+		const struct stat *st)
+{
+	struct elf_info_cache_node *victim;
+
+	e->refcount++;
+	cds_hlist_add_head(&e->node, get_elf_info_cache_head(st));
+	cds_list_add(&e->lru_node, &elf_info_cache_lru);
+	if (++elf_info_cache_nr_entries <= ELF_INFO_CACHE_MAX_ENTRIES)
+		return NULL;
+
+	victim = cds_list_entry(elf_info_cache_lru.prev,
+			struct elf_info_cache_node, lru_node);
+	cds_hlist_del(&victim->node);
+	cds_list_del(&victim->lru_node);
+	elf_info_cache_nr_entries--;
+	return elf_info_cache_node_put(victim);
+}
+
+/*
+ * Get the ELF metadata of the file at `path`. The file is opened and
+ * its identity looked up in the cache; it is only parsed on a miss.
+ * The cache is keyed on the identity of the file actually opened, so
+ * a path replaced concurrently cannot be matched with the metadata of
+ * its previous file.
+ *
+ * The returned information must be released with
+ * lttng_ust_elf_put_info().
+ *
+ * Returns NULL if the file cannot be accessed or parsed.
+ */
+const struct lttng_ust_elf_info *lttng_ust_elf_get_info(const char *path)
+{
+	struct elf_info_cache_node *e, *new_e, *free_e = NULL;
+	struct lttng_ust_elf *elf;
+	struct stat st;
+	int fd;
+
+	/*
+	 * Open the file without holding the cache mutex, since opening
+	 * it takes the fd tracker lock.
+	 */
+	fd = lttng_ust_elf_open(path);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st)) {
+		lttng_ust_elf_close(fd);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&elf_info_cache_mutex);
+	e = elf_info_cache_lookup(&st);
+	if (e) {
+		e->refcount++;
+		cds_list_move(&e->lru_node, &elf_info_cache_lru);
+	}
+	pthread_mutex_unlock(&elf_info_cache_mutex);
+	if (e) {
+		lttng_ust_elf_close(fd);
+		return &e->info;
+	}
+
+	elf = lttng_ust_elf_create_fd(path, fd, st.st_size);
+	if (!elf)
+		return NULL;
+	new_e = alloc_elf_info_cache_node(elf, &st);
+	lttng_ust_elf_destroy(elf);
+	if (!new_e)
+		return NULL;
+
+	pthread_mutex_lock(&elf_info_cache_mutex);
+	e = elf_info_cache_lookup(&st);
+	if (e) {
+		/* Lost the race. */
+		e->refcount++;
+		cds_list_move(&e->lru_node, &elf_info_cache_lru);
+		free_e = new_e;
+	} else {
+		free_e = elf_info_cache_insert(new_e, &st);
+		e = new_e;
+	}
+	pthread_mutex_unlock(&elf_info_cache_mutex);
+	if (free_e)
+		free_elf_info_cache_node(free_e);
+	return &e->info;
+}
+
+/*
+ * Release ELF metadata returned by lttng_ust_elf_get_info().
+ */
+void lttng_ust_elf_put_info(const struct lttng_ust_elf_info *info)
+{
+	struct elf_info_cache_node *e;
+
+	if (!info)
+		return;
+	e = caa_container_of(info, struct elf_info_cache_node, info);
+	pthread_mutex_lock(&elf_info_cache_mutex);
+	e = elf_info_cache_node_put(e);
+	pthread_mutex_unlock(&elf_info_cache_mutex);
+	if (e)
+		free_elf_info_cache_node(e);
+}
@@ -23,13 +23,17 @@
 #include <link.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <lttng/ust-elf.h>
+#include <lttng/align.h>
 #include <helper.h>
 #include "lttng-tracer-core.h"
 #include "lttng-ust-statedump.h"
@@ -37,6 +41,10 @@
 #include "getenv.h"
 #include "compat.h"
 
+#ifndef NT_GNU_BUILD_ID
+# define NT_GNU_BUILD_ID	3
+#endif
+
 #define TRACEPOINT_DEFINE
 #include "ust_lib.h"				/* Only define. */
 
@@ -48,6 +56,27 @@ struct dl_iterate_data {
 	int exec_found;
 	bool first;
 	bool cancel;
+	/*
+	 * Hold the ust_lock across the whole listing. Otherwise, it is
+	 * only taken by iter_end() to publish the new table state, and
+	 * the file system accesses are performed without holding it.
+	 */
+	bool hold_ust_lock;
+	/* Entries created by this listing, published by iter_end(). */
+	struct cds_hlist_head new_nodes;
+	/*
+	 * Load and unload counts of the dynamic loader at the time of
+	 * this listing. When they are the same as for the last complete
+	 * listing, the loaded objects are unchanged and the listing is
+	 * stopped early. When only the load count differs, no object was
+	 * unloaded, so an object found in the table at its base address
+	 * is known to still be present.
+	 */
+	unsigned long long adds, subs;
+	bool have_gen;
+	bool unchanged;
+	bool no_unload;
+	bool error;
 };
 
 struct bin_info_data {
@@ -59,6 +88,10 @@ struct bin_info_data {
 	size_t build_id_len;
 	int vdso;
 	uint32_t crc;
+	/* Identity of the backing file, used to memoize its ELF metadata. */
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
 	uint8_t is_pic;
 	uint8_t has_build_id;
 	uint8_t has_debug_link;
@@ -75,6 +108,23 @@ struct lttng_ust_dl_node {
 #define UST_DL_STATE_TABLE_SIZE	(1 << UST_DL_STATE_HASH_BITS)
 struct cds_hlist_head dl_state_table[UST_DL_STATE_TABLE_SIZE];
 
+/*
+ * ust_dl_mutex serializes updates of the dl state table. Modifying the
+ * table requires holding both ust_dl_mutex and the ust_lock, so
+ * holding either of them is enough to walk it.
+ *
+ * ust_dl_mutex nests within the dynamic loader lock, and the ust_lock
+ * nests within ust_dl_mutex.
+ */
+static pthread_mutex_t ust_dl_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Load and unload counts of the dynamic loader when the table was last
+ * completely updated. Protected by ust_dl_mutex.
+ */
+static bool dl_state_gen_valid;
+static unsigned long long dl_state_adds, dl_state_subs;
+
 typedef void (*tracepoint_cb)(struct lttng_session *session, void *priv);
 
 static
@@ -103,6 +153,9 @@ struct lttng_ust_dl_node *alloc_dl_node(const struct bin_info_data *bin_data)
 	e->bin_data.build_id_len = bin_data->build_id_len;
 	e->bin_data.vdso = bin_data->vdso;
 	e->bin_data.crc = bin_data->crc;
+	e->bin_data.dev = bin_data->dev;
+	e->bin_data.ino = bin_data->ino;
+	e->bin_data.mtime = bin_data->mtime;
 	e->bin_data.is_pic = bin_data->is_pic;
 	e->bin_data.has_build_id = bin_data->has_build_id;
 	e->bin_data.has_debug_link = bin_data->has_debug_link;
@@ -153,6 +206,11 @@ int compare_bin_data(const struct bin_info_data *a,
 		return -1;
 	if (a->crc != b->crc)
 		return -1;
+	if (a->dev != b->dev || a->ino != b->ino)
+		return -1;
+	if (a->mtime.tv_sec != b->mtime.tv_sec
+			|| a->mtime.tv_nsec != b->mtime.tv_nsec)
+		return -1;
 	if (a->is_pic != b->is_pic)
 		return -1;
 	if (a->has_build_id != b->has_build_id)
@@ -163,32 +221,85 @@ int compare_bin_data(const struct bin_info_data *a,
 }
 
 static
-struct lttng_ust_dl_node *find_or_create_dl_node(struct bin_info_data *bin_data)
+struct cds_hlist_head *get_dl_state_head(void *base_addr_ptr)
 {
-	struct cds_hlist_head *head;
-	struct lttng_ust_dl_node *e;
 	unsigned int hash;
-	bool found = false;
 
-	hash = jhash(&bin_data->base_addr_ptr,
-		sizeof(bin_data->base_addr_ptr), 0);
-	head = &dl_state_table[hash & (UST_DL_STATE_TABLE_SIZE - 1)];
-	cds_hlist_for_each_entry_2(e, head, node) {
-		if (compare_bin_data(&e->bin_data, bin_data) != 0)
-			continue;
-		found = true;
-		break;
+	hash = jhash(&base_addr_ptr, sizeof(base_addr_ptr), 0);
+	return &dl_state_table[hash & (UST_DL_STATE_TABLE_SIZE - 1)];
+}
+
+/*
+ * Lookup the node matching `bin_data` in the table, or in the entries
+ * created by the current listing. A node that does not exist yet is
+ * created and added to `new_nodes`, for iter_end() to publish it.
+ */
+static
+struct lttng_ust_dl_node *find_or_create_dl_node(struct bin_info_data *bin_data,
+		struct cds_hlist_head *new_nodes)
+{
+	struct lttng_ust_dl_node *e;
+
+	cds_hlist_for_each_entry_2(e, get_dl_state_head(bin_data->base_addr_ptr),
+			node) {
+		if (compare_bin_data(&e->bin_data, bin_data) == 0)
+			return e;
 	}
-	if (!found) {
-		/* Create */
-		e = alloc_dl_node(bin_data);
-		if (!e)
-			return NULL;
-		cds_hlist_add_head(&e->node, head);
+	cds_hlist_for_each_entry_2(e, new_nodes, node) {
+		if (compare_bin_data(&e->bin_data, bin_data) == 0)
+			return e;
 	}
+	/* Create */
+	e = alloc_dl_node(bin_data);
+	if (!e)
+		return NULL;
+	cds_hlist_add_head(&e->node, new_nodes);
 	return e;
 }
 
+/*
+ * Lookup the node describing the object loaded at `base_addr_ptr`.
+ */
+static
+struct lttng_ust_dl_node *find_dl_node_by_base(void *base_addr_ptr)
+{
+	struct lttng_ust_dl_node *e;
+
+	cds_hlist_for_each_entry_2(e, get_dl_state_head(base_addr_ptr), node) {
+		if (e->bin_data.base_addr_ptr == base_addr_ptr)
+			return e;
+	}
+	return NULL;
+}
+
+/*
+ * Lookup the node describing the object loaded at `base_addr_ptr`
+ * whose backing file matches `st` (device, inode and modification
+ * time). Such a node already holds the ELF metadata of the object,
+ * which saves re-opening and parsing the file.
+ */
+static
+struct lttng_ust_dl_node *find_dl_node_by_file(void *base_addr_ptr,
+		const struct stat *st)
+{
+	struct lttng_ust_dl_node *e;
+
+	cds_hlist_for_each_entry_2(e, get_dl_state_head(base_addr_ptr), node) {
+		if (e->bin_data.base_addr_ptr != base_addr_ptr)
+			continue;
+		if (e->bin_data.vdso)
+			continue;
+		if (e->bin_data.dev != st->st_dev
+				|| e->bin_data.ino != st->st_ino)
+			continue;
+		if (e->bin_data.mtime.tv_sec != st->st_mtim.tv_sec
+				|| e->bin_data.mtime.tv_nsec != st->st_mtim.tv_nsec)
+			continue;
+		return e;
+	}
+	return NULL;
+}
+
 static
 void remove_dl_node(struct lttng_ust_dl_node *e)
 {
@@ -196,25 +307,27 @@ void remove_dl_node(struct lttng_ust_dl_node *e)
 }
 
 /*
- * Trace statedump event into all sessions owned by the caller thread
- * for which statedump is pending.
+ * Trace statedump event into all sessions for which a statedump is
+ * running. Called with the ust_lock held.
  */
 static
-void trace_statedump_event(tracepoint_cb tp_cb, void *owner, void *priv)
+void trace_statedump_event(tracepoint_cb tp_cb, void *priv)
 {
 	struct cds_list_head *sessionsp;
 	struct lttng_session *session;
 
 	sessionsp = _lttng_get_sessions();
 	cds_list_for_each_entry(session, sessionsp, node) {
-		if (session->owner != owner)
-			continue;
-		if (!session->statedump_pending)
+		if (!session->statedump_running)
 			continue;
 		tp_cb(session, priv);
 	}
 }
 
+/*
+ * Trace all the events describing a binary into a session, so the
+ * sessions are walked once per binary.
+ */
 static
 void trace_bin_info_cb(struct lttng_session *session, void *priv)
 {
@@ -225,32 +338,24 @@ void trace_bin_info_cb(struct lttng_session *session, void *priv)
 		bin_data->resolved_path, bin_data->memsz,
 		bin_data->is_pic, bin_data->has_build_id,
 		bin_data->has_debug_link);
-}
 
-static
-void trace_build_id_cb(struct lttng_session *session, void *priv)
-{
-	struct bin_info_data *bin_data = (struct bin_info_data *) priv;
-
-	tracepoint(lttng_ust_statedump, build_id,
-		session, bin_data->base_addr_ptr,
-		bin_data->build_id, bin_data->build_id_len);
-}
-
-static
-void trace_debug_link_cb(struct lttng_session *session, void *priv)
-{
-	struct bin_info_data *bin_data = (struct bin_info_data *) priv;
+	if (bin_data->has_build_id) {
+		tracepoint(lttng_ust_statedump, build_id,
+			session, bin_data->base_addr_ptr,
+			bin_data->build_id, bin_data->build_id_len);
+	}
 
-	tracepoint(lttng_ust_statedump, debug_link,
-		session, bin_data->base_addr_ptr,
-		bin_data->dbg_file, bin_data->crc);
+	if (bin_data->has_debug_link) {
+		tracepoint(lttng_ust_statedump, debug_link,
+			session, bin_data->base_addr_ptr,
+			bin_data->dbg_file, bin_data->crc);
+	}
 }
 
 static
 void procname_cb(struct lttng_session *session, void *priv)
 {
-	char *procname = (char *) priv;
+	char *procname = lttng_ust_sockinfo_get_procname(session->owner);
 	tracepoint(lttng_ust_statedump, procname, session, procname);
 }
 
@@ -266,67 +371,149 @@ void trace_end_cb(struct lttng_session *session, void *priv)
 	tracepoint(lttng_ust_statedump, end, session);
 }
 
+/*
+ * Compute the in-memory size of the object from its PT_LOAD program
+ * headers, as mapped by the dynamic loader.
+ */
 static
-int get_elf_info(struct bin_info_data *bin_data)
+int get_memsz_from_phdr(const struct dl_phdr_info *info, uint64_t *memsz)
 {
-	struct lttng_ust_elf *elf;
-	int ret = 0, found;
+	uint64_t low_addr = UINT64_MAX, high_addr = 0;
+	int j;
 
-	elf = lttng_ust_elf_create(bin_data->resolved_path);
-	if (!elf) {
-		ret = -1;
-		goto end;
+	for (j = 0; j < info->dlpi_phnum; j++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[j];
+
+		if (phdr->p_type != PT_LOAD)
+			continue;
+		low_addr = min_t(uint64_t, low_addr, phdr->p_vaddr);
+		high_addr = max_t(uint64_t, high_addr,
+				phdr->p_vaddr + phdr->p_memsz);
+	}
+	if (high_addr < low_addr)
+		return -1;
+	*memsz = high_addr - low_addr;
+	return 0;
+}
+
+/*
+ * Retrieve the build id from the PT_NOTE segments of the object, which
+ * are mapped in memory by the dynamic loader. Notes are in native
+ * endianness since the object is loaded in the current process.
+ *
+ * Returns 0 on success (`found` tells whether a build id was present),
+ * -1 on error.
+ */
+static
+int get_build_id_from_phdr(const struct dl_phdr_info *info,
+		uint8_t **build_id, size_t *length, int *found)
+{
+	int j;
+
+	*found = 0;
+	for (j = 0; j < info->dlpi_phnum; j++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[j];
+		const char *segment;
+		size_t segment_size, offset = 0, align;
+
+		if (phdr->p_type != PT_NOTE)
+			continue;
+
+		segment = (const char *) info->dlpi_addr + phdr->p_vaddr;
+		segment_size = phdr->p_filesz;
+		align = phdr->p_align == 8 ? 8 : ELF_NOTE_ENTRY_ALIGN;
+
+		for (;;) {
+			const ElfW(Nhdr) *nhdr;
+			size_t desc_offset;
+
+			offset += offset_align(offset, align);
+			if (offset >= segment_size
+					|| segment_size - offset < sizeof(*nhdr))
+				break;
+			nhdr = (const ElfW(Nhdr) *) (segment + offset);
+			desc_offset = offset + sizeof(*nhdr);
+			if (nhdr->n_namesz > segment_size - desc_offset)
+				break;
+			desc_offset += nhdr->n_namesz;
+			desc_offset += offset_align(desc_offset, align);
+			if (desc_offset > segment_size
+					|| nhdr->n_descsz > segment_size - desc_offset)
+				break;
+			offset = desc_offset + nhdr->n_descsz;
+
+			if (nhdr->n_type != NT_GNU_BUILD_ID)
+				continue;
+
+			*build_id = zmalloc(nhdr->n_descsz);
+			if (!*build_id)
+				return -1;
+			memcpy(*build_id, segment + desc_offset,
+				nhdr->n_descsz);
+			*length = nhdr->n_descsz;
+			*found = 1;
+			return 0;
+		}
 	}
+	return 0;
+}
 
-	ret = lttng_ust_elf_get_memsz(elf, &bin_data->memsz);
+/*
+ * The memory size and build id are taken from the program headers
+ * mapped by the dynamic loader. Only the debug link, which lives in a
+ * non-allocated section, and the PIC flag require the file, and come
+ * from the ELF metadata cache shared with the dl instrumentation.
+ */
+static
+int get_elf_info(struct bin_info_data *bin_data,
+		const struct dl_phdr_info *info)
+{
+	const struct lttng_ust_elf_info *elf_info;
+	int ret = 0, found;
+
+	ret = get_memsz_from_phdr(info, &bin_data->memsz);
 	if (ret) {
-		goto end;
+		return ret;
 	}
 
 	found = 0;
-	ret = lttng_ust_elf_get_build_id(elf, &bin_data->build_id,
+	ret = get_build_id_from_phdr(info, &bin_data->build_id,
 					&bin_data->build_id_len,
 					&found);
 	if (ret) {
-		goto end;
+		return ret;
 	}
 	bin_data->has_build_id = !!found;
-	found = 0;
-	ret = lttng_ust_elf_get_debug_link(elf, &bin_data->dbg_file,
-					&bin_data->crc,
-					&found);
-	if (ret) {
-		goto end;
-	}
-	bin_data->has_debug_link = !!found;
-
-	bin_data->is_pic = lttng_ust_elf_is_pic(elf);
 
+	elf_info = lttng_ust_elf_get_info(bin_data->resolved_path);
+	if (!elf_info) {
+		return -1;
+	}
+	if (elf_info->has_debug_link) {
+		bin_data->dbg_file = strdup(elf_info->dbg_file);
+		if (!bin_data->dbg_file) {
+			ret = -1;
+			goto end;
+		}
+		bin_data->crc = elf_info->crc;
+	}
+	bin_data->has_debug_link = elf_info->has_debug_link;
+	bin_data->is_pic = elf_info->is_pic;
 end:
-	lttng_ust_elf_destroy(elf);
+	lttng_ust_elf_put_info(elf_info);
 	return ret;
 }
 
 static
-void trace_baddr(struct bin_info_data *bin_data, void *owner)
-{
-	trace_statedump_event(trace_bin_info_cb, owner, bin_data);
-
-	if (bin_data->has_build_id)
-		trace_statedump_event(trace_build_id_cb, owner, bin_data);
-
-	if (bin_data->has_debug_link)
-		trace_statedump_event(trace_debug_link_cb, owner, bin_data);
-}
-
-static
-int extract_baddr(struct bin_info_data *bin_data)
+int extract_baddr(struct bin_info_data *bin_data,
+		const struct dl_phdr_info *info,
+		struct dl_iterate_data *data)
 {
 	int ret = 0;
 	struct lttng_ust_dl_node *e;
 
 	if (!bin_data->vdso) {
-		ret = get_elf_info(bin_data);
+		ret = get_elf_info(bin_data, info);
 		if (ret) {
 			goto end;
 		}
@@ -336,7 +523,7 @@ int extract_baddr(struct bin_info_data *bin_data)
 		bin_data->has_debug_link = 0;
 	}
 
-	e = find_or_create_dl_node(bin_data);
+	e = find_or_create_dl_node(bin_data, &data->new_nodes);
 	if (!e) {
 		ret = -1;
 		goto end;
@@ -350,16 +537,41 @@ end:
 	return ret;
 }
 
+/*
+ * Start a statedump in all sessions for which one is pending. Called
+ * with the ust_lock held.
+ *
+ * Returns true if at least one session takes part in the statedump.
+ */
 static
-void trace_statedump_start(void *owner)
+bool trace_statedump_start(void)
 {
-	trace_statedump_event(trace_start_cb, owner, NULL);
+	struct cds_list_head *sessionsp;
+	struct lttng_session *session;
+	bool running = false;
+
+	sessionsp = _lttng_get_sessions();
+	cds_list_for_each_entry(session, sessionsp, node) {
+		if (!session->statedump_pending)
+			continue;
+		session->statedump_pending = 0;
+		session->statedump_running = 1;
+		running = true;
+	}
+	trace_statedump_event(trace_start_cb, NULL);
+	return running;
 }
 
 static
-void trace_statedump_end(void *owner)
+void trace_statedump_end(void)
 {
-	trace_statedump_event(trace_end_cb, owner, NULL);
+	struct cds_list_head *sessionsp;
+	struct lttng_session *session;
+
+	trace_statedump_event(trace_end_cb, NULL);
+	sessionsp = _lttng_get_sessions();
+	cds_list_for_each_entry(session, sessionsp, node)
+		session->statedump_running = 0;
 }
 
 static
@@ -367,17 +579,23 @@ void iter_begin(struct dl_iterate_data *data)
 {
 	unsigned int i;
 
+	/* ust_dl_mutex nests within dynamic loader lock. */
+	pthread_mutex_lock(&ust_dl_mutex);
+
 	/*
 	 * UST lock nests within dynamic loader lock.
 	 *
-	 * Hold this lock across handling of the module listing to
-	 * protect memory allocation at early process start, due to
-	 * interactions with libc-wrapper lttng malloc instrumentation.
+	 * Unless told otherwise, hold this lock across handling of the
+	 * module listing to protect memory allocation at early process
+	 * start, due to interactions with libc-wrapper lttng malloc
+	 * instrumentation.
 	 */
-	if (ust_lock()) {
+	if (ust_lock())
 		data->cancel = true;
+	if (!data->hold_ust_lock)
+		ust_unlock();
+	if (data->cancel)
 		return;
-	}
 
 	/* Ensure all entries are unmarked. */
 	for (i = 0; i < UST_DL_STATE_TABLE_SIZE; i++) {
@@ -420,10 +638,38 @@ void trace_lib_unload(const struct bin_info_data *bin_data, void *ip)
 static
 void iter_end(struct dl_iterate_data *data, void *ip)
 {
+	struct lttng_ust_dl_node *e, *tmp;
 	unsigned int i;
 
-	if (data->cancel)
+	if (!data->hold_ust_lock && ust_lock())
+		data->cancel = true;
+	if (data->cancel) {
+		cds_hlist_for_each_entry_safe_2(e, tmp, &data->new_nodes, node)
+			free_dl_node(e);
+		for (i = 0; i < UST_DL_STATE_TABLE_SIZE; i++) {
+			cds_hlist_for_each_entry_2(e, &dl_state_table[i], node)
+				e->marked = false;
+		}
+		goto end;
+	}
+
+	/* The table already describes the loaded objects. */
+	if (data->unchanged)
 		goto end;
+
+	if (data->have_gen && !data->error) {
+		dl_state_adds = data->adds;
+		dl_state_subs = data->subs;
+		dl_state_gen_valid = true;
+	}
+
+	/* Publish the entries created by this listing. */
+	cds_hlist_for_each_entry_safe_2(e, tmp, &data->new_nodes, node) {
+		cds_hlist_del(&e->node);
+		cds_hlist_add_head(&e->node,
+			get_dl_state_head(e->bin_data.base_addr_ptr));
+	}
+
 	/*
 	 * Iterate on hash table.
 	 * For each marked, traced, do nothing.
@@ -433,10 +679,9 @@ void iter_end(struct dl_iterate_data *data, void *ip)
 	 */
 	for (i = 0; i < UST_DL_STATE_TABLE_SIZE; i++) {
 		struct cds_hlist_head *head;
-		struct lttng_ust_dl_node *e;
 
 		head = &dl_state_table[i];
-		cds_hlist_for_each_entry_2(e, head, node) {
+		cds_hlist_for_each_entry_safe_2(e, tmp, head, node) {
 			if (e->marked) {
 				if (!e->traced) {
 					trace_lib_load(&e->bin_data, ip);
@@ -453,6 +698,35 @@ void iter_end(struct dl_iterate_data *data, void *ip)
 	}
 end:
 	ust_unlock();
+	pthread_mutex_unlock(&ust_dl_mutex);
+}
+
+/*
+ * Stat the file backing the object described by `bin_data` and, if
+ * the state table already holds an entry for this very file loaded at
+ * the same base address, mark it as present. This skips path
+ * resolution and ELF parsing for objects seen by a previous update.
+ *
+ * Returns true if a cached entry was marked. Otherwise, the file
+ * identity is saved in `bin_data` for the entry to be created.
+ */
+static
+bool mark_cached_dl_node(struct bin_info_data *bin_data, const char *path)
+{
+	struct lttng_ust_dl_node *e;
+	struct stat st;
+
+	if (stat(path, &st))
+		return false;
+	e = find_dl_node_by_file(bin_data->base_addr_ptr, &st);
+	if (e) {
+		e->marked = true;
+		return true;
+	}
+	bin_data->dev = st.st_dev;
+	bin_data->ino = st.st_ino;
+	bin_data->mtime = st.st_mtim;
+	return false;
 }
 
 static
@@ -464,6 +738,20 @@ int extract_bin_info_events(struct dl_phdr_info *info, size_t size, void *_data)
 	if (data->first) {
 		iter_begin(data);
 		data->first = false;
+		if (!data->cancel
+				&& size >= offsetof(struct dl_phdr_info, dlpi_subs)
+					+ sizeof(info->dlpi_subs)) {
+			data->adds = info->dlpi_adds;
+			data->subs = info->dlpi_subs;
+			data->have_gen = true;
+			if (dl_state_gen_valid && data->subs == dl_state_subs) {
+				if (data->adds == dl_state_adds) {
+					data->unchanged = true;
+					return 1;	/* Stop the listing. */
+				}
+				data->no_unload = true;
+			}
+		}
 	}
 
 	if (data->cancel)
@@ -481,6 +769,20 @@ int extract_bin_info_events(struct dl_phdr_info *info, size_t size, void *_data)
 		bin_data.base_addr_ptr = (void *) info->dlpi_addr +
 			info->dlpi_phdr[j].p_vaddr;
 
+		if (data->no_unload) {
+			struct lttng_ust_dl_node *e;
+
+			e = find_dl_node_by_base(bin_data.base_addr_ptr);
+			if (e) {
+				e->marked = true;
+				if (!data->exec_found && !e->bin_data.vdso
+						&& (info->dlpi_name == NULL
+							|| info->dlpi_name[0] == 0))
+					data->exec_found = 1;
+				break;
+			}
+		}
+
 		if ((info->dlpi_name == NULL || info->dlpi_name[0] == 0)) {
 			/*
 			 * Only the first phdr without a dlpi_name
@@ -491,6 +793,10 @@ int extract_bin_info_events(struct dl_phdr_info *info, size_t size, void *_data)
 				ssize_t path_len;
 				data->exec_found = 1;
 
+				if (mark_cached_dl_node(&bin_data,
+						"/proc/self/exe"))
+					break;
+
 				/*
 				 * Use /proc/self/exe to resolve the
 				 * executable's full path.
@@ -514,6 +820,8 @@ int extract_bin_info_events(struct dl_phdr_info *info, size_t size, void *_data)
 			 * the path to the binary really exists. If not,
 			 * treat as vdso and use dlpi_name as 'path'.
 			 */
+			if (mark_cached_dl_node(&bin_data, info->dlpi_name))
+				break;
 			if (!realpath(info->dlpi_name,
 					bin_data.resolved_path)) {
 				snprintf(bin_data.resolved_path,
@@ -525,7 +833,9 @@ int extract_bin_info_events(struct dl_phdr_info *info, size_t size, void *_data)
 			}
 		}
 
-		ret = extract_baddr(&bin_data);
+		ret = extract_baddr(&bin_data, info, data);
+		if (ret)
+			data->error = true;
 		break;
 	}
 end:
@@ -533,14 +843,14 @@ end:
 }
 
 static
-void ust_dl_table_statedump(void *owner)
+void ust_dl_table_statedump(void)
 {
 	unsigned int i;
 
 	if (ust_lock())
 		goto end;
 
-	/* Statedump each traced table entry into session for owner. */
+	/* Statedump each traced table entry into running sessions. */
 	for (i = 0; i < UST_DL_STATE_TABLE_SIZE; i++) {
 		struct cds_hlist_head *head;
 		struct lttng_ust_dl_node *e;
@@ -548,7 +858,8 @@ void ust_dl_table_statedump(void *owner)
 		head = &dl_state_table[i];
 		cds_hlist_for_each_entry_2(e, head, node) {
 			if (e->traced)
-				trace_baddr(&e->bin_data, owner);
+				trace_statedump_event(trace_bin_info_cb,
+					&e->bin_data);
 		}
 	}
 
@@ -556,7 +867,8 @@ end:
 	ust_unlock();
 }
 
-void lttng_ust_dl_update(void *ip)
+static
+void ust_dl_update(void *ip, bool hold_ust_lock)
 {
 	struct dl_iterate_data data;
 
@@ -572,6 +884,12 @@ void lttng_ust_dl_update(void *ip)
 	data.exec_found = 0;
 	data.first = true;
 	data.cancel = false;
+	data.hold_ust_lock = hold_ust_lock;
+	CDS_INIT_HLIST_HEAD(&data.new_nodes);
+	data.have_gen = false;
+	data.unchanged = false;
+	data.no_unload = false;
+	data.error = false;
 	/*
 	 * Iterate through the list of currently loaded shared objects and
 	 * generate tables entries for loadable segments using
@@ -586,28 +904,67 @@ void lttng_ust_dl_update(void *ip)
 	iter_end(&data, ip);
 }
 
+void lttng_ust_dl_update(void *ip)
+{
+	ust_dl_update(ip, true);
+}
+
+/*
+ * Taken across fork so the child does not inherit ust_dl_mutex held by
+ * another thread.
+ */
+void lttng_ust_lock_dl_state(void)
+{
+	pthread_mutex_lock(&ust_dl_mutex);
+}
+
+void lttng_ust_unlock_dl_state(void)
+{
+	pthread_mutex_unlock(&ust_dl_mutex);
+}
+
 /*
  * Generate a statedump of base addresses of all shared objects loaded
  * by the traced application, as well as for the application's
  * executable itself.
+ *
+ * The table is refreshed without holding the ust_lock across the file
+ * system accesses, so the listener threads can keep handling commands
+ * meanwhile.
  */
 static
-int do_baddr_statedump(void *owner)
+int do_baddr_statedump(void)
 {
 	if (lttng_getenv("LTTNG_UST_WITHOUT_BADDR_STATEDUMP"))
 		return 0;
-	lttng_ust_dl_update(LTTNG_UST_CALLER_IP());
-	ust_dl_table_statedump(owner);
+	ust_dl_update(LTTNG_UST_CALLER_IP(), false);
+	ust_dl_table_statedump();
 	return 0;
 }
 
 static
-int do_procname_statedump(void *owner)
+int do_procname_statedump(void)
 {
 	if (lttng_getenv("LTTNG_UST_WITHOUT_PROCNAME_STATEDUMP"))
 		return 0;
 
-	trace_statedump_event(procname_cb, owner, lttng_ust_sockinfo_get_procname(owner));
+	if (ust_lock())
+		goto end;
+	trace_statedump_event(procname_cb, NULL);
+	lttng_context_procname_statedump();
+end:
+	ust_unlock();
+	return 0;
+}
+
+static
+int do_tracef_statedump(void)
+{
+	if (ust_lock())
+		goto end;
+	lttng_ust_tracef_statedump();
+end:
+	ust_unlock();
 	return 0;
 }
 
@@ -619,32 +976,49 @@ int do_procname_statedump(void *owner)
  * interleaved. The vpid context should be used to identify which
  * events belong to which process.
  *
+ * All sessions with a pending statedump take part in it, whichever
+ * listener thread owns them, so the library snapshot is gathered once
+ * and emitted into all of them. Sessions which become pending after
+ * the start events are left for the next statedump. Statedumps are
+ * serialized by the caller (ust_fork_mutex).
+ *
  * Grab the ust_lock outside of the RCU read-side lock because we
  * perform synchronize_rcu with the ust_lock held, which can trigger
  * deadlocks otherwise.
  */
 int do_lttng_ust_statedump(void *owner)
 {
+	bool running;
+
 	ust_lock_nocheck();
-	trace_statedump_start(owner);
+	running = trace_statedump_start();
 	ust_unlock();
 
-	do_procname_statedump(owner);
-	do_baddr_statedump(owner);
+	if (!running)
+		return 0;
+
+	do_procname_statedump();
+	do_tracef_statedump();
+	do_baddr_statedump();
 
 	ust_lock_nocheck();
-	trace_statedump_end(owner);
+	trace_statedump_end();
 	ust_unlock();
 
 	return 0;
 }
 
-void lttng_ust_statedump_init(void)
+/*
+ * When `dl_update` is false, the table of loaded objects is populated by
+ * the first lttng_ust_dl_update() call instead.
+ */
+void lttng_ust_statedump_init(bool dl_update)
 {
 	__tracepoints__init();
 	__tracepoints__ptrs_init();
 	__lttng_events_init__lttng_ust_statedump();
-	lttng_ust_dl_update(LTTNG_UST_CALLER_IP());
+	if (dl_update)
+		lttng_ust_dl_update(LTTNG_UST_CALLER_IP());
 }
 
 static
@@ -661,6 +1035,7 @@ void ust_dl_state_destroy(void)
 			free_dl_node(e);
 		CDS_INIT_HLIST_HEAD(head);
 	}
+	dl_state_gen_valid = false;
 }
 
 void lttng_ust_statedump_destroy(void)
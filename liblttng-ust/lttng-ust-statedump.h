@@ -20,11 +20,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#include <stdbool.h>
 #include <lttng/ust-events.h>
 
-void lttng_ust_statedump_init(void);
+void lttng_ust_statedump_init(bool dl_update);
 void lttng_ust_statedump_destroy(void);
 
 int do_lttng_ust_statedump(void *owner);
 
+void lttng_ust_lock_dl_state(void);
+void lttng_ust_unlock_dl_state(void);
+
 #endif /* LTTNG_UST_STATEDUMP_H */
@@ -27,8 +27,9 @@
  * Zero is used in the kernel as an error code, it's the value we will return
  * when we fail to read the proper inode number.
  *
- * One is used internally to identify an uninitialized cache entry, it should
- * never be returned.
+ * One was used internally to identify an uninitialized cache entry, it should
+ * never be returned. The context caches now track validity with a generation
+ * counter instead.
  */
 
 enum ns_ino_state {
@@ -23,26 +23,434 @@
 #define _GNU_SOURCE
 #define _LGPL_SOURCE
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wchar.h>
+#include <stddef.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
 #include <helper.h>
+#include <ust_snprintf.h>
+#include "lttng-tracer-core.h"
 
 #define TRACEPOINT_CREATE_PROBES
 #define TRACEPOINT_DEFINE
 #include "lttng-ust-tracef-provider.h"
 
-void _lttng_ust_tracef(const char *fmt, ...)
+/*
+ * Binary mode. The format string of each tracef_binary() call site is
+ * parsed once, into the list of the sizes of its arguments (arg_types),
+ * and registered in a table under a format ID. The lttng_ust_tracef:format
+ * event maps the ID to the format string and arg_types, and each
+ * lttng_ust_tracef:binary event records the ID and the raw arguments,
+ * leaving the formatting to the trace reader. The statedump emits the
+ * whole table.
+ *
+ * arg_types holds one character per argument:
+ *   '1' to '8': integer of that size, including %p and '*' widths,
+ *   'f': double, including long doubles, which are recorded as doubles,
+ *   's': string, recorded with its terminating '\0'.
+ * long_doubles has the bit of each argument passed as a long double.
+ *
+ * Formats using positional arguments, %n, %m or wide strings are
+ * recorded as text, as are calls whose arguments don't fit in
+ * TRACEF_BINARY_BUF_LEN bytes.
+ */
+#define TRACEF_BINARY_MAX_FORMATS	4096
+#define TRACEF_BINARY_MAX_ARGS		32
+#define TRACEF_BINARY_BUF_LEN		512
+/* Format ID of call sites recorded as text. */
+#define TRACEF_BINARY_ID_TEXT		((unsigned int) -1)
+
+struct tracef_format {
+	char *fmt;
+	char arg_types[TRACEF_BINARY_MAX_ARGS + 1];
+	uint32_t long_doubles;
+};
+
+static struct tracef_format *tracef_formats[TRACEF_BINARY_MAX_FORMATS];
+static unsigned long tracef_next_id;
+
+/* Messages formatted on the stack, including the final \0. */
+#define TRACEF_BUF_LEN			512
+
+/*
+ * Format @fmt into @buf, or into a heap buffer if the message does not
+ * fit. Returns the message, to free() if it is not @buf, or NULL on
+ * error. @len does not include the final \0. Messages formatted in
+ * @buf by ust_safe_vsnprintf() don't allocate and are async-signal-safe.
+ */
+char *lttng_ust_tracef_vformat(char *buf, size_t buf_len, const char *fmt,
+		va_list ap, int *len)
 {
-	va_list ap;
+	bool libc = !ust_safe_format_is_libc_compatible(fmt);
+	va_list ap_copy;
 	char *msg;
+	int ret;
+
+	va_copy(ap_copy, ap);
+	if (libc)
+		ret = vsnprintf(buf, buf_len, fmt, ap_copy);
+	else
+		ret = ust_safe_vsnprintf(buf, buf_len, fmt, ap_copy);
+	va_end(ap_copy);
+	if (ret < 0)
+		return NULL;
+	if (ret < buf_len) {
+		*len = ret;
+		return buf;
+	}
+	msg = malloc(ret + 1);
+	if (!msg)
+		return NULL;
+	if (libc)
+		ret = vsnprintf(msg, ret + 1, fmt, ap);
+	else
+		ret = ust_safe_vsnprintf(msg, ret + 1, fmt, ap);
+	if (ret < 0) {
+		free(msg);
+		return NULL;
+	}
+	*len = ret;
+	return msg;
+}
+
+static
+void vtracef_text(const char *fmt, va_list ap, void *ip)
+{
+	char buf[TRACEF_BUF_LEN], *msg;
 	int len;
 
+	msg = lttng_ust_tracef_vformat(buf, sizeof(buf), fmt, ap, &len);
+	if (!msg)
+		return;
+	__tracepoint_cb_lttng_ust_tracef___event(msg, len, ip);
+	if (msg != buf)
+		free(msg);
+}
+
+void _lttng_ust_tracef(const char *fmt, ...)
+{
+	va_list ap;
+
 	va_start(ap, fmt);
-	len = vasprintf(&msg, fmt, ap);
-	/* len does not include the final \0 */
-	if (len < 0)
+	vtracef_text(fmt, ap, LTTNG_UST_CALLER_IP());
+	va_end(ap);
+}
+
+static
+char int_arg_type(size_t size)
+{
+	return '0' + size;
+}
+
+/*
+ * Parse @fmt into @arg_types and @long_doubles. Returns 0 on success,
+ * -1 if the format cannot be recorded in binary mode.
+ */
+static
+int parse_format(const char *fmt, char *arg_types, uint32_t *long_doubles)
+{
+	unsigned int nr_args = 0;
+	const char *p = fmt;
+
+	*long_doubles = 0;
+	while ((p = strchr(p, '%'))) {
+		char type;
+		size_t size = sizeof(int);
+
+		p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+		/* Flags. */
+		while (*p && strchr("-+ #0'I", *p))
+			p++;
+		/* Width. */
+		if (*p == '*') {
+			if (nr_args == TRACEF_BINARY_MAX_ARGS)
+				return -1;
+			arg_types[nr_args++] = int_arg_type(sizeof(int));
+			p++;
+		} else {
+			while (*p >= '0' && *p <= '9')
+				p++;
+			if (*p == '$')
+				return -1;
+		}
+		/* Precision. */
+		if (*p == '.') {
+			p++;
+			if (*p == '*') {
+				if (nr_args == TRACEF_BINARY_MAX_ARGS)
+					return -1;
+				arg_types[nr_args++] = int_arg_type(sizeof(int));
+				p++;
+			} else {
+				while (*p >= '0' && *p <= '9')
+					p++;
+			}
+		}
+		/* Length modifier. */
+		switch (*p) {
+		case 'h':
+			p++;
+			if (*p == 'h')
+				p++;
+			break;
+		case 'l':
+			p++;
+			if (*p == 'l') {
+				size = sizeof(long long);
+				p++;
+			} else {
+				size = sizeof(long);
+			}
+			break;
+		case 'q':
+		case 'L':
+			size = sizeof(long long);
+			p++;
+			break;
+		case 'j':
+			size = sizeof(intmax_t);
+			p++;
+			break;
+		case 'z':
+		case 'Z':
+			size = sizeof(size_t);
+			p++;
+			break;
+		case 't':
+			size = sizeof(ptrdiff_t);
+			p++;
+			break;
+		}
+		/* Conversion. */
+		switch (*p) {
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			type = int_arg_type(size);
+			break;
+		case 'c':
+			type = int_arg_type(size == sizeof(long) ?
+					sizeof(wint_t) : sizeof(int));
+			break;
+		case 'p':
+			type = int_arg_type(sizeof(void *));
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			if (p[-1] == 'L') {
+				if (nr_args == TRACEF_BINARY_MAX_ARGS)
+					return -1;
+				*long_doubles |= 1U << nr_args;
+			}
+			type = 'f';
+			break;
+		case 's':
+			if (p[-1] == 'l')
+				return -1;
+			type = 's';
+			break;
+		default:
+			/* %n, %m, %C, %S, or invalid. */
+			return -1;
+		}
+		p++;
+		if (nr_args == TRACEF_BINARY_MAX_ARGS)
+			return -1;
+		arg_types[nr_args++] = type;
+	}
+	arg_types[nr_args] = '\0';
+	return 0;
+}
+
+/*
+ * Register the format of @callsite and return its ID. Two threads
+ * racing on the first use of a call site may both register its format:
+ * only the ID published in the call site is used.
+ */
+static
+unsigned int register_callsite(struct lttng_ust_tracef_callsite *callsite,
+		void *ip)
+{
+	struct tracef_format *format;
+	unsigned int id, old_id;
+
+	format = zmalloc(sizeof(*format));
+	if (!format)
+		goto text;
+	if (parse_format(callsite->fmt, format->arg_types,
+			&format->long_doubles))
+		goto text_free;
+	id = uatomic_add_return(&tracef_next_id, 1);
+	if (id >= TRACEF_BINARY_MAX_FORMATS)
+		goto text_free;
+	format->fmt = strdup(callsite->fmt);
+	if (!format->fmt)
+		goto text_free;
+	/* Publish the format before its ID. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(tracef_formats[id], format);
+	old_id = uatomic_cmpxchg(&callsite->id, 0, id);
+	if (old_id)
+		return old_id;
+	__tracepoint_cb_lttng_ust_tracef___format(id, format->fmt,
+		format->arg_types, ip);
+	return id;
+
+text_free:
+	free(format);
+text:
+	old_id = uatomic_cmpxchg(&callsite->id, 0, TRACEF_BINARY_ID_TEXT);
+	return old_id ? old_id : TRACEF_BINARY_ID_TEXT;
+}
+
+/*
+ * Serialize the arguments described by @arg_types and @long_doubles
+ * into @buf. Returns the length, or -1 if they don't fit.
+ */
+static
+int serialize_args(const char *arg_types, uint32_t long_doubles,
+		char *buf, size_t buf_len, va_list ap)
+{
+	size_t len = 0;
+	unsigned int i;
+
+	for (i = 0; arg_types[i]; i++) {
+		switch (arg_types[i]) {
+		case 's':
+		{
+			const char *str = va_arg(ap, const char *);
+			size_t str_len;
+
+			if (!str)
+				str = "(null)";
+			str_len = strlen(str) + 1;
+			if (str_len > buf_len - len)
+				return -1;
+			memcpy(&buf[len], str, str_len);
+			len += str_len;
+			break;
+		}
+		case 'f':
+		{
+			double d;
+
+			if (long_doubles & (1U << i))
+				d = va_arg(ap, long double);
+			else
+				d = va_arg(ap, double);
+			if (sizeof(d) > buf_len - len)
+				return -1;
+			memcpy(&buf[len], &d, sizeof(d));
+			len += sizeof(d);
+			break;
+		}
+		default:
+		{
+			size_t size = arg_types[i] - '0';
+			union {
+				int8_t i8;
+				int16_t i16;
+				int32_t i32;
+				int64_t i64;
+			} v;
+
+			if (size > buf_len - len)
+				return -1;
+			/*
+			 * Narrow to the recorded size before copying, so
+			 * the low-order bytes are recorded whatever the
+			 * byte order.
+			 */
+			switch (size) {
+			case sizeof(int8_t):
+				v.i8 = (int8_t) va_arg(ap, int);
+				break;
+			case sizeof(int16_t):
+				v.i16 = (int16_t) va_arg(ap, int);
+				break;
+			case sizeof(int32_t):
+				v.i32 = (int32_t) va_arg(ap, int);
+				break;
+			case sizeof(int64_t):
+				v.i64 = (int64_t) va_arg(ap, long long);
+				break;
+			default:
+				return -1;
+			}
+			memcpy(&buf[len], &v, size);
+			len += size;
+			break;
+		}
+		}
+	}
+	return len;
+}
+
+void _lttng_ust_tracef_binary(struct lttng_ust_tracef_callsite *callsite, ...)
+{
+	void *ip = LTTNG_UST_CALLER_IP();
+	struct tracef_format *format;
+	char buf[TRACEF_BINARY_BUF_LEN];
+	unsigned int id;
+	va_list ap, ap_text;
+	int len;
+
+	id = CMM_LOAD_SHARED(callsite->id);
+	if (caa_unlikely(!id))
+		id = register_callsite(callsite, ip);
+	va_start(ap, callsite);
+	if (caa_unlikely(id == TRACEF_BINARY_ID_TEXT)) {
+		vtracef_text(callsite->fmt, ap, ip);
 		goto end;
-	__tracepoint_cb_lttng_ust_tracef___event(msg, len,
-		LTTNG_UST_CALLER_IP());
-	free(msg);
+	}
+	cmm_smp_rmb();
+	format = CMM_LOAD_SHARED(tracef_formats[id]);
+	va_copy(ap_text, ap);
+	len = serialize_args(format->arg_types, format->long_doubles,
+			buf, sizeof(buf), ap);
+	if (len < 0)
+		vtracef_text(callsite->fmt, ap_text, ip);
+	else
+		__tracepoint_cb_lttng_ust_tracef___binary(id, buf, len, ip);
+	va_end(ap_text);
 end:
 	va_end(ap);
 }
+
+/*
+ * Emit the format events of all the registered formats. Called by the
+ * statedump, with ust lock held.
+ */
+void lttng_ust_tracef_statedump(void)
+{
+	unsigned long nr, id;
+
+	nr = min_t(unsigned long, CMM_LOAD_SHARED(tracef_next_id),
+			TRACEF_BINARY_MAX_FORMATS - 1);
+	for (id = 1; id <= nr; id++) {
+		struct tracef_format *format;
+
+		format = CMM_LOAD_SHARED(tracef_formats[id]);
+		if (!format)
+			continue;
+		cmm_smp_rmb();
+		__tracepoint_cb_lttng_ust_tracef___format(id, format->fmt,
+			format->arg_types, LTTNG_UST_CALLER_IP());
+	}
+}
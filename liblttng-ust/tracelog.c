@@ -24,31 +24,35 @@
 #define _LGPL_SOURCE
 #include <stdio.h>
 #include <helper.h>
+#include "lttng-tracer-core.h"
 
 #define TRACEPOINT_CREATE_PROBES
 #define TRACEPOINT_DEFINE
 #include "lttng-ust-tracelog-provider.h"
 
+/* Messages formatted on the stack, including the final \0. */
+#define TRACELOG_BUF_LEN	512
+
 #define TRACELOG_CB(level) \
 	void _lttng_ust_tracelog_##level(const char *file, \
 			int line, const char *func, \
 			const char *fmt, ...) \
 	{ \
+		char buf[TRACELOG_BUF_LEN], *msg; \
 		va_list ap; \
-		char *msg; \
 		int len; \
 		\
 		va_start(ap, fmt); \
-		len = vasprintf(&msg, fmt, ap); \
-		/* len does not include the final \0 */ \
-		if (len < 0) \
-			goto end; \
+		msg = lttng_ust_tracef_vformat(buf, sizeof(buf), fmt, ap, \
+			&len); \
+		va_end(ap); \
+		if (!msg) \
+			return; \
 		__tracepoint_cb_lttng_ust_tracelog___##level(file, \
 			line, func, msg, len, \
 			LTTNG_UST_CALLER_IP()); \
-		free(msg); \
-	end: \
-		va_end(ap); \
+		if (msg != buf) \
+			free(msg); \
 	}
 
 TRACELOG_CB(TRACE_EMERG)
@@ -19,6 +19,44 @@
 from __future__ import unicode_literals
 import logging
 import ctypes
+import struct
+import threading
+import time
+import os
+
+
+def _get_env_int(name, default):
+    try:
+        val = int(os.getenv(name, default))
+    except (TypeError, ValueError):
+        val = default
+
+    return val
+
+
+# number of records buffered per thread before firing them at once
+_BATCH_SIZE = max(_get_env_int('LTTNG_UST_PYTHON_BATCH_SIZE', 1), 1)
+
+# maximum time (s) a record stays buffered before being fired
+_BATCH_MAX_LATENCY = max(_get_env_int('LTTNG_UST_PYTHON_BATCH_MAX_LATENCY_MS',
+                                      100), 1) / 1000.0
+
+_clock = getattr(time, 'monotonic', time.time)
+
+_RECORD_INTS = struct.Struct('=III')
+
+
+def _to_cstr(s):
+    # like ctypes, stop at the first null byte
+    return s.encode().split(b'\0', 1)[0]
+
+
+class _Batch(object):
+    def __init__(self):
+        self.thread = threading.current_thread()
+        self.data = []
+        self.count = 0
+        self.first_time = 0
 
 
 class _Handler(logging.Handler):
@@ -30,12 +68,126 @@ class _Handler(logging.Handler):
 
         # will raise if library is not found: caller should catch
         self.agent_lib = ctypes.cdll.LoadLibrary(_Handler._LIB_NAME)
+        self._tracepoint_enabled = self.agent_lib.py_tracepoint_enabled
+        self._tracepoint_batch = self.agent_lib.py_tracepoint_batch
+        self._tracepoint_batch.argtypes = [ctypes.c_char_p, ctypes.c_size_t,
+                                           ctypes.c_uint]
+
+        # per-thread batches, also kept in a list to flush them all;
+        # emit() and flush() are called with the handler lock held
+        self._batch_size = _BATCH_SIZE
+        self._thread_batch = threading.local()
+        self._batches = []
+        self._timer = None
 
     def emit(self, record):
-        self.agent_lib.py_tracepoint(self.format(record).encode(),
-                                     record.getMessage().encode(),
-                                     record.name.encode(),
-                                     record.funcName.encode(),
-                                     record.lineno, record.levelno,
-                                     record.thread,
-                                     record.threadName.encode())
+        # skip formatting and encoding unless a session enables the event
+        if not self._tracepoint_enabled():
+            return
+
+        if self._batch_size == 1:
+            self.agent_lib.py_tracepoint(self.format(record).encode(),
+                                         record.getMessage().encode(),
+                                         record.name.encode(),
+                                         record.funcName.encode(),
+                                         record.lineno, record.levelno,
+                                         record.thread,
+                                         record.threadName.encode())
+            return
+
+        batch = getattr(self._thread_batch, 'batch', None)
+
+        if batch is None:
+            # new thread: also forget the batches of terminated threads
+            self._prune_batches()
+            batch = _Batch()
+            self._thread_batch.batch = batch
+            self._batches.append(batch)
+
+        ints = _RECORD_INTS.pack(record.lineno & 0xffffffff,
+                                 record.levelno & 0xffffffff,
+                                 (record.thread or 0) & 0xffffffff)
+        batch.data.append(ints + b'\0'.join([_to_cstr(self.format(record)),
+                                             _to_cstr(record.getMessage()),
+                                             _to_cstr(record.name),
+                                             _to_cstr(record.funcName),
+                                             _to_cstr(record.threadName or '')]) + b'\0')
+        now = _clock()
+
+        if batch.count == 0:
+            batch.first_time = now
+
+        batch.count += 1
+
+        if (batch.count >= self._batch_size or
+                now - batch.first_time >= _BATCH_MAX_LATENCY):
+            self._fire_batch(batch)
+        elif self._timer is None:
+            self._arm_timer(_BATCH_MAX_LATENCY)
+
+    def _arm_timer(self, delay):
+        # fires the batches of threads which stopped logging
+        self._timer = threading.Timer(delay, self._on_timer)
+        self._timer.daemon = True
+        self._timer.start()
+
+    def _on_timer(self):
+        self.acquire()
+
+        try:
+            self._timer = None
+            now = _clock()
+            next_delay = None
+
+            for batch in self._batches:
+                if batch.count == 0:
+                    continue
+
+                age = now - batch.first_time
+
+                if age >= _BATCH_MAX_LATENCY:
+                    self._fire_batch(batch)
+                else:
+                    delay = _BATCH_MAX_LATENCY - age
+
+                    if next_delay is None or delay < next_delay:
+                        next_delay = delay
+
+            self._prune_batches()
+
+            if next_delay is not None:
+                self._arm_timer(next_delay)
+        finally:
+            self.release()
+
+    def _prune_batches(self):
+        # fire and forget the batches of terminated threads
+        alive = []
+
+        for batch in self._batches:
+            if batch.thread.is_alive():
+                alive.append(batch)
+            else:
+                self._fire_batch(batch)
+
+        self._batches = alive
+
+    def _fire_batch(self, batch):
+        if batch.count == 0:
+            return
+
+        data = b''.join(batch.data)
+        self._tracepoint_batch(data, len(data), batch.count)
+        batch.data = []
+        batch.count = 0
+
+    def flush(self):
+        self.acquire()
+
+        try:
+            for batch in self._batches:
+                self._fire_batch(batch)
+
+            self._prune_batches()
+        finally:
+            self.release()
@@ -76,3 +76,39 @@ int ust_safe_snprintf(char *str, size_t n, const char *fmt, ...)
 
 	return ret;
 }
+
+/*
+ * Return 1 if every conversion of @fmt is formatted by
+ * ust_safe_vsnprintf() exactly like the C library does, 0 otherwise.
+ * Only the flags, length modifiers and conversions below qualify:
+ * floating point, %p, %n, wide characters, positional arguments,
+ * grouping, the BSD %D, %O and %U conversions, zero-padded strings and
+ * alternate form octal don't.
+ */
+int ust_safe_format_is_libc_compatible(const char *fmt)
+{
+	const char *p = fmt;
+	int alt, zeropad;
+
+	while ((p = strchr(p, '%'))) {
+		p++;
+		alt = zeropad = 0;
+		for (; *p && strchr("-+ #0", *p); p++) {
+			if (*p == '#')
+				alt = 1;
+			else if (*p == '0')
+				zeropad = 1;
+		}
+		while (*p && strchr("0123456789.*hljqzt", *p))
+			p++;
+		if (!*p || !strchr("diouxXcs%", *p))
+			return 0;
+		if ((*p == 'c' || *p == 's') && (p[-1] == 'l' || zeropad))
+			return 0;
+		/* "%#.0o" prints "0" for a zero value with the C library. */
+		if (*p == 'o' && alt)
+			return 0;
+		p++;
+	}
+	return 1;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2026  EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#include <ust-fd.h>
+#include "tap.h"
+
+#define NUM_TESTS			10
+
+/* Real fds, below the initial size of the tracker bitmap. */
+#define RANGE_FIRST_FD			100
+#define RANGE_NR_FDS			10
+#define RANGE_TRACKED_FD_1		103
+#define RANGE_TRACKED_FD_2		106
+
+/*
+ * Fd numbers which are only added to the tracker, beyond its initial
+ * bitmap size, and never opened: close callbacks only record the call.
+ */
+#define GROW_FD				3000
+#define RACE_FD				2500
+#define RACE_GROW_FD			8000
+#define RACE_ITERATIONS			20000
+#define RACE_CLOSERS			4
+
+static int close_cb_calls;
+
+static int race_fd_tracked;
+static int race_done;
+static int race_violations;
+static int race_closed;
+static int race_rejected;
+
+static
+int record_close(int fd __attribute__((unused)))
+{
+	close_cb_calls++;
+	return 0;
+}
+
+static
+int track_fd(int fd)
+{
+	int ret;
+
+	lttng_ust_lock_fd_tracker();
+	ret = lttng_ust_add_fd_to_tracker(fd);
+	lttng_ust_unlock_fd_tracker();
+	return ret;
+}
+
+static
+void untrack_fd(int fd)
+{
+	lttng_ust_lock_fd_tracker();
+	lttng_ust_delete_fd_from_tracker(fd);
+	lttng_ust_unlock_fd_tracker();
+}
+
+static
+int fd_is_open(int fd)
+{
+	return fcntl(fd, F_GETFD) >= 0;
+}
+
+static
+void test_close_range(void)
+{
+	int devnull, i, ret, closed = 1;
+
+	devnull = open("/dev/null", O_RDONLY);
+	for (i = RANGE_FIRST_FD; i < RANGE_FIRST_FD + RANGE_NR_FDS; i++)
+		(void) dup2(devnull, i);
+	close(devnull);
+	track_fd(RANGE_TRACKED_FD_1);
+	track_fd(RANGE_TRACKED_FD_2);
+
+	ret = lttng_ust_safe_close_range_fd(RANGE_FIRST_FD,
+			RANGE_FIRST_FD + RANGE_NR_FDS - 1, 0);
+	if (ret && errno == ENOSYS) {
+		skip(2, "close_range() is not available");
+		goto end;
+	}
+	ok(ret == 0, "close_range() across tracked fds succeeds");
+	for (i = RANGE_FIRST_FD; i < RANGE_FIRST_FD + RANGE_NR_FDS; i++) {
+		if (i == RANGE_TRACKED_FD_1 || i == RANGE_TRACKED_FD_2)
+			continue;
+		if (fd_is_open(i))
+			closed = 0;
+	}
+	ok(closed && fd_is_open(RANGE_TRACKED_FD_1)
+			&& fd_is_open(RANGE_TRACKED_FD_2),
+		"close_range() only closes the untracked fds of the range");
+end:
+	untrack_fd(RANGE_TRACKED_FD_1);
+	untrack_fd(RANGE_TRACKED_FD_2);
+	for (i = RANGE_FIRST_FD; i < RANGE_FIRST_FD + RANGE_NR_FDS; i++)
+		(void) close(i);
+}
+
+static
+void test_bitmap_grow(void)
+{
+	int devnull, ret;
+
+	devnull = open("/dev/null", O_RDONLY);
+	(void) dup2(devnull, RANGE_FIRST_FD);
+	close(devnull);
+	track_fd(RANGE_FIRST_FD);
+
+	ok(track_fd(GROW_FD) == GROW_FD,
+		"Track an fd beyond the initial bitmap size");
+
+	close_cb_calls = 0;
+	errno = 0;
+	ret = lttng_ust_safe_close_fd(GROW_FD, record_close);
+	ok(ret == -1 && errno == EBADF && !close_cb_calls,
+		"Tracked fd beyond the initial bitmap size is not closed");
+	errno = 0;
+	ret = lttng_ust_safe_close_fd(RANGE_FIRST_FD, record_close);
+	ok(ret == -1 && errno == EBADF && !close_cb_calls
+			&& fd_is_open(RANGE_FIRST_FD),
+		"Fd tracked before the bitmap grew is still tracked");
+	ret = lttng_ust_safe_close_fd(GROW_FD + 1, record_close);
+	ok(ret == 0 && close_cb_calls == 1,
+		"Untracked fd beyond the initial bitmap size is closed");
+
+	untrack_fd(GROW_FD);
+	close_cb_calls = 0;
+	ret = lttng_ust_safe_close_fd(GROW_FD, record_close);
+	ok(ret == 0 && close_cb_calls == 1,
+		"Untracked fd is closed again");
+
+	untrack_fd(RANGE_FIRST_FD);
+	(void) close(RANGE_FIRST_FD);
+}
+
+/*
+ * Called by the application closers with the fd check in progress, so
+ * the fd must not be tracked.
+ */
+static
+int race_close(int fd __attribute__((unused)))
+{
+	if (CMM_LOAD_SHARED(race_fd_tracked))
+		uatomic_inc(&race_violations);
+	return 0;
+}
+
+static
+void *race_closer(void *arg __attribute__((unused)))
+{
+	while (!CMM_LOAD_SHARED(race_done)) {
+		if (lttng_ust_safe_close_fd(RACE_FD, race_close))
+			uatomic_inc(&race_rejected);
+		else
+			uatomic_inc(&race_closed);
+	}
+	return NULL;
+}
+
+static
+void test_concurrent_close(void)
+{
+	pthread_t closers[RACE_CLOSERS];
+	int i, nr_closers = 0, tracked_ok = 1;
+
+	for (i = 0; i < RACE_CLOSERS; i++) {
+		if (!pthread_create(&closers[i], NULL, race_closer, NULL))
+			nr_closers++;
+	}
+	for (i = 0; i < RACE_ITERATIONS; i++) {
+		lttng_ust_lock_fd_tracker();
+		if (lttng_ust_add_fd_to_tracker(RACE_FD) != RACE_FD)
+			tracked_ok = 0;
+		CMM_STORE_SHARED(race_fd_tracked, 1);
+		/* Replace the bitmap while the closers check it. */
+		if (i == RACE_ITERATIONS / 2
+				&& lttng_ust_add_fd_to_tracker(RACE_GROW_FD) != RACE_GROW_FD)
+			tracked_ok = 0;
+		lttng_ust_unlock_fd_tracker();
+
+		lttng_ust_lock_fd_tracker();
+		CMM_STORE_SHARED(race_fd_tracked, 0);
+		lttng_ust_delete_fd_from_tracker(RACE_FD);
+		lttng_ust_unlock_fd_tracker();
+	}
+	CMM_STORE_SHARED(race_done, 1);
+	for (i = 0; i < nr_closers; i++)
+		pthread_join(closers[i], NULL);
+	untrack_fd(RACE_GROW_FD);
+
+	ok(nr_closers == RACE_CLOSERS && tracked_ok,
+		"Update the tracker while %d threads close its fd",
+		RACE_CLOSERS);
+	ok(!uatomic_read(&race_violations),
+		"No close of the fd while it is tracked");
+	ok(uatomic_read(&race_closed) + uatomic_read(&race_rejected) > 0,
+		"Concurrent closes completed (%d closed, %d rejected)",
+		uatomic_read(&race_closed), uatomic_read(&race_rejected));
+}
+
+int main()
+{
+	plan_tests(NUM_TESTS);
+
+	test_close_range();
+	test_bitmap_grow();
+	test_concurrent_close();
+
+	return exit_status();
+}
@@ -16,19 +16,50 @@
  */
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include "ust_snprintf.h"
 
 #include "tap.h"
 
+/*
+ * Formats accepted by ust_safe_format_is_libc_compatible() must be
+ * formatted by ust_safe_vsnprintf() exactly like vsnprintf().
+ */
+static
+void check_libc_format(const char *fmt, ...)
+{
+	char ust_buf[100], libc_buf[100];
+	va_list ap;
+
+	va_start(ap, fmt);
+	ust_safe_vsnprintf(ust_buf, sizeof(ust_buf), fmt, ap);
+	va_end(ap);
+	va_start(ap, fmt);
+	vsnprintf(libc_buf, sizeof(libc_buf), fmt, ap);
+	va_end(ap);
+	ok(ust_safe_format_is_libc_compatible(fmt)
+			&& strcmp(ust_buf, libc_buf) == 0,
+		"Format \"%s\" matches the C library: \"%s\"", fmt, ust_buf);
+}
+
+static const char *non_libc_formats[] = {
+	"%f", "%e", "%g", "%a", "%Lf", "%p", "%n", "%m", "%lc", "%ls",
+	"%C", "%S", "%D", "%O", "%U", "%Id", "%Zd", "%'d", "%Ld",
+	"%1$d", "%*1$d", "%", "%5", "%05s", "%03c", "%#o", "%#.0o",
+};
+
 int main()
 {
 	char buf[100];
+	size_t i;
 	char *expected;
 	char test_fmt_str[] = "header %d, %s, %03d, '%3$*d'";
 	char escaped_test_fmt_str[] = "header %%d, %%s, %%03d, '%%3$*d'";
 
-	plan_tests(1);
+	plan_tests(1 + 22 + sizeof(non_libc_formats) / sizeof(non_libc_formats[0]));
 
 	expected = "header 9999, hello, 005, '    9'";
 	ust_safe_snprintf(buf, 99, test_fmt_str, 9999, "hello", 5, 9);
@@ -38,5 +69,33 @@ int main()
 	sprintf(test_desc, test_desc_fmt_str, escaped_test_fmt_str);
 	ok(strcmp(buf, expected) == 0, test_desc);
 
+	check_libc_format("plain text, 100%% literal");
+	check_libc_format("%d %i %+d % d %-5d| %05d %.3d %.0d", -42, 7, 7, 7, 7, -7, 7, 0);
+	check_libc_format("%u %o %x %#x %#X %#x", 42u, 8u, 255u, 255u, 255u, 0u);
+	check_libc_format("%+u % u %+x", 1u, 2u, 3u);
+	check_libc_format("%*d|%-*d|%.*d|%*.*d", 6, 1, 6, 2, 4, 3, -6, 2, 4);
+	check_libc_format("%hhd %hhu %hd %hu", -1, 511, 70000, 70000);
+	check_libc_format("%ld %lu %lx", -1L, (unsigned long) -1, 0xdeadbeefUL);
+	check_libc_format("%lld %llu %qd", INT64_MIN, UINT64_MAX, 12345LL);
+	check_libc_format("%jd %ju", (intmax_t) -5, (uintmax_t) 5);
+	check_libc_format("%zd %zu %zx", (ssize_t) -3, (size_t) 3, (size_t) 255);
+	check_libc_format("%td %tx", (ptrdiff_t) -9, (ptrdiff_t) 9);
+	check_libc_format("%c%c%5c|%-5c|", 'a', 'b', 'c', 'd');
+	check_libc_format("%s|%10s|%-10s|%.2s|%*.*s", "abc", "abc", "abc", "abc", 6, 1, "abc");
+	check_libc_format("%s", (char *) NULL);
+	check_libc_format("%#s|%+s|% c", "ab", "cd", 'e');
+	check_libc_format("%#-8x|%#010x|%-#010X", 16u, 16u, 16u);
+	check_libc_format("%08.3d|%-08d|%+08d|% 08d", 5, 5, 5, 5);
+	check_libc_format("%+ d|% +d", 5, 5);
+	check_libc_format("%.0u|%.0x|%.0o|%#.0x", 0u, 0u, 0u, 0u);
+	check_libc_format("%x %X %o", 0xffffffffu, 0xabcdefu, 0777u);
+	check_libc_format("%d %d", 2147483647, (int) -2147483647 - 1);
+	check_libc_format("%%%d%%%s%%", 1, "x");
+
+	for (i = 0; i < sizeof(non_libc_formats) / sizeof(non_libc_formats[0]); i++)
+		ok(!ust_safe_format_is_libc_compatible(non_libc_formats[i]),
+			"Format \"%s\" is left to the C library",
+			non_libc_formats[i]);
+
 	return 0;
 }
@@ -270,6 +270,56 @@ struct lttng_ust_context_provider myprovider = {
 	.get_value = test_get_value,
 };
 
+/*
+ * Provider with a static type: contexts added while it is registered
+ * are recorded as a plain int64 integer, without the dynamic type tag.
+ * The get_size and record callbacks only serve contexts added before
+ * its registration.
+ */
+static int64_t typed_value;
+
+static
+size_t test_typed_get_size(struct lttng_ctx_field *field, size_t offset)
+{
+	size_t size = 0;
+
+	size += lib_ring_buffer_align(offset, lttng_alignof(char));
+	size += sizeof(char);		/* tag */
+	size += lib_ring_buffer_align(offset + size, lttng_alignof(int64_t));
+	size += sizeof(int64_t);
+	return size;
+}
+
+static
+void test_typed_record(struct lttng_ctx_field *field,
+		 struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		 struct lttng_channel *chan)
+{
+	char sel_char = (char) LTTNG_UST_DYNAMIC_TYPE_S64;
+	int64_t v = typed_value;
+
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(char));
+	chan->ops->event_write(ctx, &sel_char, sizeof(sel_char));
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(v));
+	chan->ops->event_write(ctx, &v, sizeof(v));
+}
+
+static
+void test_typed_get_value(struct lttng_ctx_field *field,
+		struct lttng_ctx_value *value)
+{
+	value->sel = LTTNG_UST_DYNAMIC_TYPE_S64;
+	value->u.s64 = typed_value;
+}
+
+struct lttng_ust_context_provider mytypedprovider = {
+	.name = "$app.mytypedprovider",
+	.get_size = test_typed_get_size,
+	.record = test_typed_record,
+	.get_value = test_typed_get_value,
+	.static_type = LTTNG_UST_DYNAMIC_TYPE_S64,
+};
+
 void inthandler(int sig)
 {
 	printf("in SIGUSR1 handler\n");
@@ -322,6 +372,8 @@ int main(int argc, char **argv)
 
 	if (lttng_ust_context_provider_register(&myprovider))
 		abort();
+	if (lttng_ust_context_provider_register_typed(&mytypedprovider))
+		abort();
 
 	fprintf(stderr, "Hello, World!\n");
 
@@ -330,11 +382,13 @@ int main(int argc, char **argv)
 	fprintf(stderr, "Tracing... ");
 	for (i = 0; i < 1000000; i++) {
 		netint = htonl(i);
+		typed_value = i;
 		tracepoint(ust_tests_hello, tptest, i, netint, values,
 			   text, strlen(text), dbl, flt, mybool);
 		test_inc_count();
 		//usleep(100000);
 	}
+	lttng_ust_context_provider_unregister(&mytypedprovider);
 	lttng_ust_context_provider_unregister(&myprovider);
 	fprintf(stderr, " done.\n");
 	return 0;
@@ -27,7 +27,9 @@
 #define NUM_ARCH 4
 #define NUM_TESTS_PER_ARCH 11
 #define NUM_TESTS_PIC 3
-#define NUM_TESTS (NUM_ARCH * NUM_TESTS_PER_ARCH) + NUM_TESTS_PIC + 1
+#define NUM_TESTS_INVALID 2
+#define NUM_TESTS (NUM_ARCH * NUM_TESTS_PER_ARCH) + NUM_TESTS_PIC + \
+	NUM_TESTS_INVALID + 1
 
 /*
  * Expected memsz were computed using libelf, build ID and debug link
@@ -145,6 +147,23 @@ void test_pic(const char *test_dir)
 	lttng_ust_elf_destroy(elf);
 }
 
+static
+void test_invalid(const char *test_dir)
+{
+	char path[PATH_MAX];
+	struct lttng_ust_elf *elf = NULL;
+
+	snprintf(path, PATH_MAX, "%s/data/main.c", test_dir);
+	elf = lttng_ust_elf_create(path);
+	ok(elf == NULL, "lttng_ust_elf_create rejects non-ELF file");
+	lttng_ust_elf_destroy(elf);
+
+	snprintf(path, PATH_MAX, "%s/data/nonexistent.elf", test_dir);
+	elf = lttng_ust_elf_create(path);
+	ok(elf == NULL, "lttng_ust_elf_create rejects missing file");
+	lttng_ust_elf_destroy(elf);
+}
+
 int main(int argc, char **argv)
 {
 	const char *test_dir;
@@ -164,6 +183,7 @@ int main(int argc, char **argv)
 	test_elf(test_dir, "aarch64_be", AARCH64_BE_MEMSZ, aarch64_be_build_id,
 		AARCH64_BE_CRC);
 	test_pic(test_dir);
+	test_invalid(test_dir);
 
 	return EXIT_SUCCESS;
 }